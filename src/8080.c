@@ -1,33 +1,23 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include "8080.h"
+#include "bus_8080.h"
 #include "disassembler_8080.h"
 
-// clang-format off
-unsigned char cycles8080[] = {
-	4, 10, 7, 5, 5, 5, 7, 4, 4, 10, 7, 5, 5, 5, 7, 4, //0x00..0x0f
-	4, 10, 7, 5, 5, 5, 7, 4, 4, 10, 7, 5, 5, 5, 7, 4, //0x10..0x1f
-	4, 10, 16, 5, 5, 5, 7, 4, 4, 10, 16, 5, 5, 5, 7, 4, //etc
-	4, 10, 13, 5, 10, 10, 10, 4, 4, 10, 13, 5, 5, 5, 7, 4,
-
-	5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5, //0x40..0x4f
-	5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
-	5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
-	7, 7, 7, 7, 7, 7, 7, 7, 5, 5, 5, 5, 5, 5, 7, 5,
-
-	4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4, //0x80..8x4f
-	4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
-	4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
-	4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
-
-	11, 10, 10, 10, 17, 11, 7, 11, 11, 10, 10, 10, 10, 17, 7, 11, //0xc0..0xcf
-	11, 10, 10, 10, 17, 11, 7, 11, 11, 10, 10, 10, 10, 17, 7, 11,
-	11, 10, 10, 18, 17, 11, 7, 11, 11, 5, 10, 5, 17, 17, 7, 11,
-	11, 10, 10, 4, 17, 11, 7, 11, 11, 5, 10, 4, 17, 17, 7, 11,
-};
-// clang-format on
+// The opcode table and the per opcode columns the hot paths index.
+#define OPCODE_8080(op, mnemonic, operands, length, cycles, taken, reads, writes, class) \
+    [op] = {mnemonic, operands, length, cycles, taken, FLAGS_8080_##reads,               \
+            FLAGS_8080_##writes, OP_8080_##class},
+#define LENGTH_8080(op, mnemonic, operands, length, ...) [op] = length,
+#define CYCLES_8080(op, mnemonic, operands, length, cycles, ...) [op] = cycles,
+#define TAKEN_8080(op, mnemonic, operands, length, cycles, taken, ...) [op] = taken,
+const Opcode8080 opcodes8080[256] = {OPCODES_8080(OPCODE_8080)};
+const uint8_t lengths8080[256] = {OPCODES_8080(LENGTH_8080)};
+const uint8_t cycles8080[256] = {OPCODES_8080(CYCLES_8080)};
+const uint8_t taken_cycles8080[256] = {OPCODES_8080(TAKEN_8080)};
 
 static bool carry(int bit_number, uint8_t a, uint8_t b, bool cy)
 {
@@ -50,22 +40,15 @@ static int parity(int x, int size)
     return (0 == (p & 0x1));
 }
 
-static void flags_zsp(State8080 *state, uint8_t value)
-{
-    state->cc.z = (value == 0);
-    state->cc.s = value >> 7;
-    state->cc.p = parity(value, 8);
-}
-
 static void write_mem(State8080 *state, uint16_t address, uint8_t value)
 {
-    state->write_byte(state, address, value);
+    write_8080(state, address, value);
 }
 
 static uint8_t read_from_m(State8080 *state)
 {
     uint16_t offset = (state->h << 8) | state->l;
-    return state->memory[offset];
+    return read_8080(state, offset);
 }
 
 static void write_to_m(State8080 *state, uint8_t value)
@@ -107,6 +90,365 @@ static void set_hl(State8080 *state, uint16_t value)
     state->l = value & 0xff;
 }
 
+#ifdef LAZY_FLAGS
+// Lazy condition codes: ALU helpers only record the kind of operation and
+// its operands in `state->lazy`, and each flag is derived from that record
+// when an instruction actually reads it. `state->cc` holds the flags of
+// anything that wasn't recorded (LAZY_NONE), and the carry of INR and DCR,
+// which leave it untouched.
+enum
+{
+    LAZY_NONE = 0,
+    LAZY_ADD,
+    LAZY_SUB,
+    LAZY_INR,
+    LAZY_DCR,
+    LAZY_AND,
+    LAZY_LOGIC, // ORA and XRA
+};
+
+static void record_flags(State8080 *state, uint8_t op, uint8_t result,
+                         uint8_t lhs, uint8_t rhs, bool cin)
+{
+    state->lazy.op = op;
+    state->lazy.result = result;
+    state->lazy.lhs = lhs;
+    state->lazy.rhs = rhs;
+    state->lazy.cin = cin;
+}
+
+static bool flag_s(State8080 *state)
+{
+    return state->lazy.op == LAZY_NONE ? state->cc.s : state->lazy.result >> 7;
+}
+
+static bool flag_z(State8080 *state)
+{
+    return state->lazy.op == LAZY_NONE ? state->cc.z : state->lazy.result == 0;
+}
+
+static bool flag_p(State8080 *state)
+{
+    return state->lazy.op == LAZY_NONE ? state->cc.p : parity(state->lazy.result, 8);
+}
+
+static bool flag_cy(State8080 *state)
+{
+    LazyFlags *lazy = &state->lazy;
+    switch (lazy->op)
+    {
+    case LAZY_ADD:
+        return carry(8, lazy->lhs, lazy->rhs, lazy->cin);
+    case LAZY_SUB:
+        return !carry(8, lazy->lhs, lazy->rhs, lazy->cin);
+    case LAZY_AND:
+    case LAZY_LOGIC:
+        return 0;
+    default:
+        return state->cc.cy;
+    }
+}
+
+static bool flag_ac(State8080 *state)
+{
+    LazyFlags *lazy = &state->lazy;
+    switch (lazy->op)
+    {
+    case LAZY_ADD:
+    case LAZY_SUB:
+        return carry(4, lazy->lhs, lazy->rhs, lazy->cin);
+    case LAZY_INR:
+        return (lazy->result & 0xf) == 0;
+    case LAZY_DCR:
+        return !((lazy->result & 0xf) == 0xf);
+    case LAZY_AND:
+        return ((lazy->lhs | lazy->rhs) & 0x08) != 0;
+    case LAZY_LOGIC:
+        return 0;
+    default:
+        return state->cc.ac;
+    }
+}
+
+static void materialize_flags(State8080 *state)
+{
+    if (state->lazy.op != LAZY_NONE)
+    {
+        state->cc.s = flag_s(state);
+        state->cc.z = flag_z(state);
+        state->cc.ac = flag_ac(state);
+        state->cc.p = flag_p(state);
+        state->cc.cy = flag_cy(state);
+        state->lazy.op = LAZY_NONE;
+    }
+}
+
+static void set_cy(State8080 *state, bool value)
+{
+    // INR and DCR records already keep the carry in `cc`.
+    if (state->lazy.op != LAZY_INR && state->lazy.op != LAZY_DCR)
+    {
+        materialize_flags(state);
+    }
+    state->cc.cy = value;
+}
+
+static void set_psw(State8080 *state, uint8_t psw)
+{
+    state->lazy.op = LAZY_NONE;
+    state->cc.s = (psw >> 7) & 1;
+    state->cc.z = (psw >> 6) & 1;
+    state->cc.ac = (psw >> 4) & 1;
+    state->cc.p = (psw >> 2) & 1;
+    state->cc.cy = (psw >> 0) & 1;
+}
+
+static void add(State8080 *state, uint8_t *reg, uint8_t value, bool cy)
+{
+    uint8_t result = *reg + value + cy;
+    record_flags(state, LAZY_ADD, result, *reg, value, cy);
+    *reg = result;
+}
+
+static void substract(State8080 *state, uint8_t *const reg, uint8_t val, bool cy)
+{
+    uint8_t result = *reg + (uint8_t)~val + !cy;
+    record_flags(state, LAZY_SUB, result, *reg, ~val, !cy);
+    *reg = result;
+}
+
+static int inr(State8080 *state, uint8_t value)
+{
+    uint8_t result = value + 1;
+    state->cc.cy = flag_cy(state);
+    record_flags(state, LAZY_INR, result, 0, 0, 0);
+    return result;
+}
+
+static int dcr(State8080 *state, uint8_t value)
+{
+    uint8_t result = value - 1;
+    state->cc.cy = flag_cy(state);
+    record_flags(state, LAZY_DCR, result, 0, 0, 0);
+    return result;
+}
+
+static void cmp(State8080 *state, uint8_t value)
+{
+    // Same flags as SUB, without storing the result.
+    uint8_t result = state->a + (uint8_t)~value + 1;
+    record_flags(state, LAZY_SUB, result, state->a, ~value, 1);
+}
+
+static void ana(State8080 *state, uint8_t value)
+{
+    uint8_t result = state->a & value;
+    record_flags(state, LAZY_AND, result, state->a, value, 0);
+    state->a = result;
+}
+
+static void xra(State8080 *state, uint8_t value)
+{
+    state->a ^= value;
+    record_flags(state, LAZY_LOGIC, state->a, 0, 0, 0);
+}
+
+static void ora(State8080 *state, uint8_t value)
+{
+    state->a |= value;
+    record_flags(state, LAZY_LOGIC, state->a, 0, 0, 0);
+}
+#elif defined(FLAG_TABLES)
+// Table driven condition codes: the flags live packed in `state->psw`, in the
+// layout PUSH PSW stores them, and the ALU helpers fetch the result together
+// with its flags from tables filled once by init_flag_tables.
+#define FLAG_S 0x80
+#define FLAG_Z 0x40
+#define FLAG_AC 0x10
+#define FLAG_P 0x04
+#define FLAG_CY 0x01
+
+static uint8_t zsp_table[256];
+// Indexed by [carry/borrow in][lhs][rhs], result in the low byte and the
+// packed flags in the high byte.
+static uint16_t add_table[2][256][256];
+static uint16_t sub_table[2][256][256];
+
+static void init_flag_tables(void)
+{
+    static bool initialized = false;
+    if (initialized)
+    {
+        return;
+    }
+
+    for (int value = 0; value < 256; value++)
+    {
+        zsp_table[value] = (value & FLAG_S) |
+                           (value == 0 ? FLAG_Z : 0) |
+                           (parity(value, 8) ? FLAG_P : 0);
+    }
+
+    for (int cin = 0; cin < 2; cin++)
+    {
+        for (int lhs = 0; lhs < 256; lhs++)
+        {
+            for (int rhs = 0; rhs < 256; rhs++)
+            {
+                uint8_t sum = lhs + rhs + cin;
+                uint8_t flags = zsp_table[sum];
+                flags |= carry(4, lhs, rhs, cin) ? FLAG_AC : 0;
+                flags |= carry(8, lhs, rhs, cin) ? FLAG_CY : 0;
+                add_table[cin][lhs][rhs] = (flags << 8) | sum;
+
+                // Subtraction adds the complement, and the carry out is
+                // inverted into a borrow.
+                uint8_t difference = lhs + (uint8_t)~rhs + !cin;
+                flags = zsp_table[difference];
+                flags |= carry(4, lhs, ~rhs, !cin) ? FLAG_AC : 0;
+                flags |= carry(8, lhs, ~rhs, !cin) ? 0 : FLAG_CY;
+                sub_table[cin][lhs][rhs] = (flags << 8) | difference;
+            }
+        }
+    }
+    initialized = true;
+}
+
+static bool flag_s(State8080 *state)
+{
+    return state->psw & FLAG_S;
+}
+
+static bool flag_z(State8080 *state)
+{
+    return state->psw & FLAG_Z;
+}
+
+static bool flag_p(State8080 *state)
+{
+    return state->psw & FLAG_P;
+}
+
+static bool flag_cy(State8080 *state)
+{
+    return state->psw & FLAG_CY;
+}
+
+static bool flag_ac(State8080 *state)
+{
+    return state->psw & FLAG_AC;
+}
+
+static void set_cy(State8080 *state, bool value)
+{
+    state->psw = (state->psw & ~FLAG_CY) | value;
+}
+
+static void set_psw(State8080 *state, uint8_t psw)
+{
+    state->psw = psw & (FLAG_S | FLAG_Z | FLAG_AC | FLAG_P | FLAG_CY);
+}
+
+static void add(State8080 *state, uint8_t *reg, uint8_t value, bool cy)
+{
+    uint16_t entry = add_table[cy][*reg][value];
+    *reg = entry & 0xff;
+    state->psw = entry >> 8;
+}
+
+static void substract(State8080 *state, uint8_t *const reg, uint8_t val, bool cy)
+{
+    uint16_t entry = sub_table[cy][*reg][val];
+    *reg = entry & 0xff;
+    state->psw = entry >> 8;
+}
+
+static int inr(State8080 *state, uint8_t value)
+{
+    uint8_t result = value + 1;
+    state->psw = (state->psw & FLAG_CY) | zsp_table[result] |
+                 ((result & 0xf) == 0 ? FLAG_AC : 0);
+    return result;
+}
+
+static int dcr(State8080 *state, uint8_t value)
+{
+    uint8_t result = value - 1;
+    state->psw = (state->psw & FLAG_CY) | zsp_table[result] |
+                 ((result & 0xf) == 0xf ? 0 : FLAG_AC);
+    return result;
+}
+
+static void cmp(State8080 *state, uint8_t value)
+{
+    state->psw = sub_table[0][state->a][value] >> 8;
+}
+
+static void ana(State8080 *state, uint8_t value)
+{
+    uint8_t result = state->a & value;
+    state->psw = zsp_table[result] | (((state->a | value) & 0x08) ? FLAG_AC : 0);
+    state->a = result;
+}
+
+static void xra(State8080 *state, uint8_t value)
+{
+    state->a ^= value;
+    state->psw = zsp_table[state->a];
+}
+
+static void ora(State8080 *state, uint8_t value)
+{
+    state->a |= value;
+    state->psw = zsp_table[state->a];
+}
+#else
+static void flags_zsp(State8080 *state, uint8_t value)
+{
+    state->cc.z = (value == 0);
+    state->cc.s = value >> 7;
+    state->cc.p = parity(value, 8);
+}
+
+static bool flag_s(State8080 *state)
+{
+    return state->cc.s;
+}
+
+static bool flag_z(State8080 *state)
+{
+    return state->cc.z;
+}
+
+static bool flag_p(State8080 *state)
+{
+    return state->cc.p;
+}
+
+static bool flag_cy(State8080 *state)
+{
+    return state->cc.cy;
+}
+
+static bool flag_ac(State8080 *state)
+{
+    return state->cc.ac;
+}
+
+static void set_cy(State8080 *state, bool value)
+{
+    state->cc.cy = value;
+}
+
+static void set_psw(State8080 *state, uint8_t psw)
+{
+    state->cc.s = (psw >> 7) & 1;
+    state->cc.z = (psw >> 6) & 1;
+    state->cc.ac = (psw >> 4) & 1;
+    state->cc.p = (psw >> 2) & 1;
+    state->cc.cy = (psw >> 0) & 1;
+}
+
 static void add(State8080 *state, uint8_t *reg, uint8_t value, bool cy)
 {
     uint8_t result = *reg + value + cy;
@@ -146,12 +488,6 @@ static void cmp(State8080 *state, uint8_t value)
     flags_zsp(state, result & 0xff);
 }
 
-static void dad(State8080 *state, uint16_t value)
-{
-    state->cc.cy = ((get_hl(state) + value) >> 16) & 1;
-    set_hl(state, get_hl(state) + value);
-}
-
 static void ana(State8080 *state, uint8_t value)
 {
     uint8_t result = state->a & value;
@@ -177,6 +513,33 @@ static void ora(State8080 *state, uint8_t value)
     flags_zsp(state, state->a);
 }
 
+#endif
+
+#ifdef FLAG_TABLES
+static uint8_t get_psw(State8080 *state)
+{
+    return state->psw | (1 << 1); // bit 1 is always 1
+}
+#else
+static uint8_t get_psw(State8080 *state)
+{
+    uint8_t psw = 0;
+    psw |= flag_s(state) << 7;
+    psw |= flag_z(state) << 6;
+    psw |= flag_ac(state) << 4;
+    psw |= flag_p(state) << 2;
+    psw |= 1 << 1; // bit 1 is always 1
+    psw |= flag_cy(state) << 0;
+    return psw;
+}
+#endif
+
+static void dad(State8080 *state, uint16_t value)
+{
+    set_cy(state, ((get_hl(state) + value) >> 16) & 1);
+    set_hl(state, get_hl(state) + value);
+}
+
 static void push(State8080 *state, uint8_t high, uint8_t low)
 {
     write_mem(state, state->sp - 1, high);
@@ -186,7 +549,7 @@ static void push(State8080 *state, uint8_t high, uint8_t low)
 
 static void ret(State8080 *state)
 {
-    state->pc = state->memory[state->sp] | (state->memory[state->sp + 1] << 8);
+    state->pc = read_8080(state, state->sp) | (read_8080(state, state->sp + 1) << 8);
     state->sp += 2;
 }
 
@@ -196,7 +559,7 @@ static void call(State8080 *state, uint16_t ret, uint16_t address)
     state->pc = address;
 }
 
-static void cond_call(State8080 *state, uint16_t address, bool condition)
+static bool cond_call(State8080 *state, uint16_t address, bool condition)
 {
     if (condition)
     {
@@ -206,6 +569,7 @@ static void cond_call(State8080 *state, uint16_t address, bool condition)
     {
         state->pc += 2;
     }
+    return condition;
 }
 
 static void cond_jump(State8080 *state, uint16_t address, bool condition)
@@ -222,14 +586,37 @@ static void cond_jump(State8080 *state, uint16_t address, bool condition)
 
 static void pop(State8080 *state, uint8_t *high, uint8_t *low)
 {
-    *high = state->memory[state->sp + 1];
-    *low = state->memory[state->sp];
+    *high = read_8080(state, state->sp + 1);
+    *low = read_8080(state, state->sp);
     state->sp += 2;
 }
 
-void generate_interrupt(State8080 *state, int interrupt_num)
+bool generate_interrupt(State8080 *state, int interrupt_num)
 {
+    if (!state->int_enable)
+    {
+        return false;
+    }
+    // Taking an interrupt disables them until the handler runs EI.
+    state->int_enable = 0;
     call(state, state->pc, interrupt_num * 8);
+    return true;
+}
+
+void request_interrupt_8080(State8080 *state, int interrupt_num)
+{
+    state->held_interrupt = 0xc7 | (interrupt_num << 3);
+    take_held_interrupt_8080(state);
+}
+
+uint8_t get_psw_8080(State8080 *state)
+{
+    return get_psw(state);
+}
+
+void set_psw_8080(State8080 *state, uint8_t psw)
+{
+    set_psw(state, psw);
 }
 
 static void unimplemented_instruction(State8080 *state)
@@ -240,991 +627,1053 @@ static void unimplemented_instruction(State8080 *state)
     exit(1);
 }
 
-State8080 *init_8080(void)
+#ifdef FLAG_LIVENESS
+#ifndef DECODE_CACHE
+#error "FLAG_LIVENESS needs DECODE_CACHE"
+#endif
+// Flag liveness: an ALU, INR or DCR instruction whose flags the following
+// straight line code overwrites before reading them decodes to a variant
+// that leaves the flags alone, 0x100 | opcode. Only code analyze_8080_flags
+// ran over is looked at, and only up to LIVENESS_WINDOW bytes ahead.
+#define LIVENESS_WINDOW 16
+
+static bool has_flagless_variant(uint8_t op)
 {
-    State8080 *state = calloc(1, sizeof(State8080));
-    state->memory = malloc(0x10000); // 16K
-    return state;
+    return (op >= 0x80 && op < 0xc0) || (op >= 0xc0 && (op & 0x07) == 0x06) ||
+           (op < 0x40 && (op & 0x06) == 0x04);
 }
 
-void emulate_8080_op(State8080 *state)
+// Instructions the scan stops at: control transfers, HLT and undocumented
+// opcodes, port accesses (callbacks see the registers), stores (which may
+// change the code ahead) and EI, after which a held interrupt sees the
+// flags.
+static bool ends_scan(uint8_t op)
 {
-    unsigned char *opcode = &state->memory[state->pc];
-
-    state->pc += 1;
+    OpClass8080 op_class = opcodes8080[op].op_class;
+    return op == 0xfb ||
+           (op_class != OP_8080_MISC && op_class != OP_8080_LOAD && op_class != OP_8080_ALU);
+}
 
-    switch (*opcode)
-    {
-    case 0x00: // NOP
-        break;
-    case 0x01: // LXI B, Word
-        state->c = opcode[1];
-        state->b = opcode[2];
-        state->pc += 2;
-        break;
-    case 0x02: // STAX B
+// One more than the cycles between the instruction at `address` and the
+// one that overwrites the last of its flags, or 0 when they may be read
+// first.
+static uint8_t dead_flags_span(const State8080 *state, uint16_t address)
+{
+    uint8_t op = state->memory[address];
+    if (!has_flagless_variant(op))
     {
-        write_mem(state, get_bc(state), state->a);
-        break;
+        return 0;
     }
-    case 0x03: // INX B
+    uint8_t live = opcodes8080[op].flags_written;
+    uint32_t span = 0;
+    uint16_t pc = address + lengths8080[op];
+    while ((uint16_t)(pc - address) <= LIVENESS_WINDOW)
     {
-        set_bc(state, get_bc(state) + 1);
-        break;
+        op = state->memory[pc];
+        if (ends_scan(op) || (opcodes8080[op].flags_read & live) != 0)
+        {
+            return 0;
+        }
+        live &= ~opcodes8080[op].flags_written;
+        if (live == 0)
+        {
+            return span + 1;
+        }
+        span += cycles8080[op];
+        pc += lengths8080[op];
     }
-    case 0x04: // INR B
-        state->b = inr(state, state->b);
-        break;
-    case 0x05: // DCR B
-        state->b = dcr(state, state->b);
-        break;
-    case 0x06: // MVI B, D8
-        state->b = opcode[1];
-        state->pc++;
-        break;
-    case 0x07: // RLC
+    return 0;
+}
+#endif
+
+#ifdef DECODE_CACHE
+static DecodedOp8080 *decode(State8080 *state, uint16_t address)
+{
+    DecodedOp8080 *entry = &state->decoded[address];
+    entry->op = state->memory[address];
+    entry->imm = state->memory[(uint16_t)(address + 1)] |
+                 (state->memory[(uint16_t)(address + 2)] << 8);
+    entry->length = lengths8080[entry->op];
+    entry->cycles = cycles8080[entry->op];
+#ifdef FLAG_LIVENESS
+    entry->span = 0;
+    if (address >= state->analyzed_start && address < state->analyzed_end)
     {
-        uint8_t bit_seven = state->a >> 7;
-        state->a = (state->a << 1) | bit_seven;
-        state->cc.cy = bit_seven;
-        break;
+        entry->span = dead_flags_span(state, address);
+        entry->op |= entry->span != 0 ? 0x100 : 0;
     }
-    case 0x08: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0x09: // DAD B
+#endif
+    return entry;
+}
+#endif
+
+void invalidate_8080_decoded(State8080 *state, uint16_t address)
+{
+#ifdef DECODE_CACHE
+    // Any instruction starting up to two bytes before may cover `address`.
+    state->decoded[address].length = 0;
+    state->decoded[(uint16_t)(address - 1)].length = 0;
+    state->decoded[(uint16_t)(address - 2)].length = 0;
+#ifdef FLAG_LIVENESS
+    // So may the flag liveness of any instruction a window before.
+    if (address >= state->analyzed_start && address < state->analyzed_end + LIVENESS_WINDOW + 2)
     {
-        dad(state, get_bc(state));
-        break;
+        for (int back = 3; back <= LIVENESS_WINDOW + 2; back++)
+        {
+            state->decoded[(uint16_t)(address - back)].length = 0;
+        }
     }
-    case 0x0a: // LDA B
+#endif
+#else
+    (void)state;
+    (void)address;
+#endif
+}
+
+void invalidate_8080_written(State8080 *state, uint16_t address)
+{
+#ifdef DECODE_CACHE
+    const MemoryMap8080 *map = state->map;
+    uint8_t page = address >> 8;
+    uint32_t host = code_offset_8080(state, &page_8080(state, map->write[page])[address & 0xff]);
+    if (host < 0x10000)
     {
-        state->a = state->memory[get_bc(state)];
-        break;
+        invalidate_8080_decoded(state, host);
     }
-    case 0x0b: // DCX B
+    uint8_t mirror = page;
+    do
     {
-        set_bc(state, get_bc(state) - 1);
-        break;
+        invalidate_8080_decoded(state, (mirror << 8) | (address & 0xff));
+        mirror = map->mirror[mirror];
+    } while (mirror != page);
+#else
+    (void)state;
+    (void)address;
+#endif
+}
+
+void invalidate_8080_range(State8080 *state, uint16_t address, uint32_t size)
+{
+#ifdef DECODE_CACHE
+    // What invalidate_8080_decoded drops for each byte, a whole liveness
+    // window before the range whether it was analyzed or not.
+#ifdef FLAG_LIVENESS
+    uint32_t before = LIVENESS_WINDOW + 2;
+#else
+    uint32_t before = 2;
+#endif
+    for (uint32_t offset = 0; offset < before + size; offset++)
+    {
+        state->decoded[(uint16_t)(address - before + offset)].length = 0;
     }
-    case 0x0c: // INR C
-        state->c = inr(state, state->c);
-        break;
-    case 0x0d: // DCR C
-        state->c = dcr(state, state->c);
-        break;
-    case 0x0e: // MVI C, D8
-        state->c = opcode[1];
-        state->pc++;
-        break;
-    case 0x0f: // RRC
+#else
+    (void)state;
+    (void)address;
+    (void)size;
+#endif
+}
+
+void analyze_8080_flags(State8080 *state, uint16_t address, uint32_t size)
+{
+#ifdef FLAG_LIVENESS
+    state->analyzed_start = address;
+    state->analyzed_end = address + size;
+    for (uint32_t offset = 0; offset < size; offset++)
     {
-        uint8_t bit_zero = state->a & 0x1;
-        state->a = (state->a >> 1) | (bit_zero << 7);
-        state->cc.cy = bit_zero;
-        break;
+        decode(state, address + offset);
     }
-    case 0x10: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0x11: // LXI D, Word
-        state->e = opcode[1];
-        state->d = opcode[2];
-        state->pc += 2;
-        break;
-    case 0x12: // STAX D
-        write_mem(state, get_de(state), state->a);
-        break;
-    case 0x13: // INX D
-        set_de(state, get_de(state) + 1);
-        break;
-    case 0x14: // INR D
-        state->d = inr(state, state->d);
-        break;
-    case 0x15: // DCR D
-        state->d = dcr(state, state->d);
-        break;
-    case 0x16: // MVI D, D8
-        state->d = opcode[1];
-        state->pc++;
-        break;
-    case 0x17: // RAL
+#else
+    (void)state;
+    (void)address;
+    (void)size;
+#endif
+}
+
+#ifdef PROFILE_PAIRS
+uint64_t opcode_pairs_8080[256][256];
+
+void report_opcode_pairs_8080(int count)
+{
+    uint64_t total = 0;
+    for (int pair = 0; pair < 0x10000; pair++)
     {
-        uint8_t bit_seven = state->a >> 7;
-        state->a = (state->a << 1) | state->cc.cy;
-        state->cc.cy = bit_seven;
-        break;
+        total += opcode_pairs_8080[pair >> 8][pair & 0xff];
     }
-    case 0x18: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0x19: // DAD D
-        dad(state, get_de(state));
-        break;
-    case 0x1a: // LDA D
-        state->a = state->memory[get_de(state)];
-        break;
-    case 0x1b: // DCX D
-        set_de(state, get_de(state) - 1);
-        break;
-    case 0x1c: // INR E
-        state->e = inr(state, state->e);
-        break;
-    case 0x1d: // DCR E
-        state->e = dcr(state, state->e);
-        break;
-    case 0x1e: // MVI E, Byte
-        state->e = opcode[1];
-        state->pc++;
-        break;
-    case 0x1f: // RAR
+    // Selection by repeated scans, the table is only read once per run.
+    static bool reported[256][256];
+    memset(reported, 0, sizeof(reported));
+    printf("opcode pairs (%llu):\n", (unsigned long long)total);
+    for (int i = 0; i < count; i++)
     {
-        uint8_t bit_zero = state->a & 0x1;
-        state->a = (state->a >> 1) | ((state->cc.cy & 1) << 7);
-        state->cc.cy = bit_zero;
-        break;
+        int best = -1;
+        for (int pair = 0; pair < 0x10000; pair++)
+        {
+            int first = pair >> 8, second = pair & 0xff;
+            if (!reported[first][second] &&
+                (best < 0 || opcode_pairs_8080[first][second] > opcode_pairs_8080[best >> 8][best & 0xff]))
+            {
+                best = pair;
+            }
+        }
+        uint64_t hits = opcode_pairs_8080[best >> 8][best & 0xff];
+        if (hits == 0)
+        {
+            break;
+        }
+        reported[best >> 8][best & 0xff] = true;
+        printf("  %02x %02x  %12llu  %5.2f%%\n", best >> 8, best & 0xff, (unsigned long long)hits,
+               100.0 * hits / total);
     }
-    case 0x20: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0x21: // LXI H, Word
-        state->l = opcode[1];
-        state->h = opcode[2];
-        state->pc += 2;
-        break;
-    case 0x22: // ShlD Address
+}
+#endif
+
+#ifdef SUPERINSTRUCTIONS
+// Superinstructions: the hottest sequences of the invaders ROM, read off
+// the PROFILE_PAIRS histogram, run from their first opcode's handler in a
+// single dispatch. They only fuse when the slice wouldn't end part way
+// through and none of their stores lands on their own code, so the same
+// instructions retire with the same cycles as one at a time.
+
+// Whether a sequence of `total` cycles ending with a `last` cycles
+// instruction runs to the end with `left` cycles left in the slice.
+static bool fits(uint32_t left, uint32_t total, uint32_t last)
+{
+    return total - last < left;
+}
+
+// Whether the `size` bytes of a sequence at `address` stay clear of a
+// store to `target`.
+static bool clear_of(uint16_t address, uint16_t size, uint16_t target)
+{
+    return address <= 0x10000 - size && (uint16_t)(target - address) >= size;
+}
+
+// LDAX D; MOV M,A; INX H; INX D; DCR B; JNZ, the block copy loop body.
+static bool copy_loop(State8080 *state, uint32_t left)
+{
+    static const uint8_t code[] = {0x1a, 0x77, 0x23, 0x13, 0x05, 0xc2};
+    uint16_t address = state->pc - 1;
+    if (!fits(left, 39, 10) || !clear_of(address, 8, get_hl(state)) ||
+        memcmp(&state->memory[address], code, sizeof(code)) != 0)
     {
-        uint16_t offset = (opcode[2] << 8) | opcode[1];
-        write_mem(state, offset, state->l);
-        write_mem(state, offset + 1, state->h);
-        state->pc += 2;
-        break;
+        return false;
     }
-    case 0x23: // INX H
-        set_hl(state, get_hl(state) + 1);
-        break;
-    case 0x24: // INR H
-        state->h = inr(state, state->h);
-        break;
-    case 0x25: // DCR H
-        state->h = dcr(state, state->h);
-        break;
-    case 0x26: // MVI H, D8
-        state->h = opcode[1];
-        state->pc++;
-        break;
-    case 0x27: // DAA
+    state->a = read_8080(state, get_de(state));
+    write_to_m(state, state->a);
+    set_hl(state, get_hl(state) + 1);
+    set_de(state, get_de(state) + 1);
+    state->b = dcr(state, state->b);
+    uint16_t target = state->memory[address + 6] | (state->memory[address + 7] << 8);
+    state->pc = flag_z(state) ? address + 8 : target;
+    state->cycle_count += 39 - 7;
+    state->fused_dispatches += 5;
+    return true;
+}
+
+// MVI M,d8; INX H; MOV A,H; CPI d8; JNZ, the screen fill loop body.
+static bool fill_loop(State8080 *state, uint32_t left)
+{
+    uint16_t address = state->pc - 1;
+    if (!fits(left, 37, 10) || !clear_of(address, 9, get_hl(state)))
+    {
+        return false;
+    }
+    const uint8_t *bytes = &state->memory[address];
+    if (bytes[2] != 0x23 || bytes[3] != 0x7c || bytes[4] != 0xfe || bytes[6] != 0xc2)
     {
-        bool cy = state->cc.cy;
-        uint8_t correction = 0;
+        return false;
+    }
+    write_to_m(state, bytes[1]);
+    set_hl(state, get_hl(state) + 1);
+    state->a = state->h;
+    cmp(state, bytes[5]);
+    state->pc = flag_z(state) ? address + 9 : bytes[7] | (bytes[8] << 8);
+    state->cycle_count += 37 - 10;
+    state->fused_dispatches += 4;
+    return true;
+}
 
-        uint8_t lsb = state->a & 0x0F;
-        uint8_t msb = state->a >> 4;
+// INX H; MOV A,H; CPI d8; JNZ, the end of loops that step HL through
+// memory a byte at a time up to a page, the top three pairs recorded.
+static bool hl_loop_end(State8080 *state, uint32_t left)
+{
+    uint16_t address = state->pc - 1;
+    if (!fits(left, 27, 10) || address > 0x10000 - 7)
+    {
+        return false;
+    }
+    const uint8_t *bytes = &state->memory[address];
+    if (bytes[1] != 0x7c || bytes[2] != 0xfe || bytes[4] != 0xc2)
+    {
+        return false;
+    }
+    set_hl(state, get_hl(state) + 1);
+    state->a = state->h;
+    cmp(state, bytes[3]);
+    state->pc = flag_z(state) ? address + 7 : bytes[5] | (bytes[6] << 8);
+    state->cycle_count += 27 - 5;
+    state->fused_dispatches += 3;
+    return true;
+}
+#endif
 
-        if (state->cc.ac || lsb > 9)
-        {
-            correction += 0x06;
-        }
+#ifdef LOOP_IDIOMS
+// Loop idioms: fill and copy loops recognised by their shape, whatever
+// their address, and run as memset/memmove. The body stores through one
+// register pair, optionally after LDAX or MOV A,M through another, steps
+// the pairs by one, then tests for the end with DCR r, MOV A,r and CPI,
+// or MOV A,hi and ORA lo of a pair, before branching back with JNZ.
+//
+// Once a pass branched back, the passes that would branch back again and
+// fit in the slice run at once, and the interpreter runs the rest. Every
+// pass reloads A and recomputes the flags before using them, so the
+// registers and flags end up as if they all ran one at a time.
 
-        if (state->cc.cy || msb > 9 || (msb >= 9 && lsb > 9))
-        {
-            correction += 0x60;
-            cy = 1;
-        }
+enum
+{
+    EXIT_DCR,  // DCR counter
+    EXIT_PAIR, // MOV A,hi / ORA lo of the pair `counter`
+    EXIT_CPI,  // MOV A,counter / CPI compare
+};
 
-        add(state, &state->a, correction, 0);
-        state->cc.cy = cy;
-        break;
+typedef struct LoopIdiom
+{
+    int load, store; // register pairs (0 BC, 1 DE, 2 HL) loaded and stored through, -1 for none
+    int value;       // register stored, -1 for `imm`
+    uint8_t imm;
+    int step[3]; // per pass increment of each pair
+    int exit, counter;
+    uint8_t compare;
+    uint32_t period;
+} LoopIdiom;
+
+// Opcodes a fill or copy loop can start with, to pass over other loops
+// quickly.
+static const bool idiom_entry[256] = {
+    [0x02] = true, [0x0a] = true, [0x12] = true, [0x1a] = true, [0x36] = true,
+    [0x70] = true, [0x71] = true, [0x72] = true, [0x73] = true, [0x74] = true,
+    [0x75] = true, [0x77] = true, [0x7e] = true,
+};
+
+// Registers by their 3 bit code in opcodes, M (6) excluded.
+static uint8_t *reg8(State8080 *state, int code)
+{
+    uint8_t *regs[8] = {&state->b, &state->c, &state->d, &state->e,
+                        &state->h, &state->l, NULL,      &state->a};
+    return regs[code];
+}
+
+static uint16_t get_pair(State8080 *state, int pair)
+{
+    return (*reg8(state, pair * 2) << 8) | *reg8(state, pair * 2 + 1);
+}
+
+static void set_pair(State8080 *state, int pair, uint16_t value)
+{
+    *reg8(state, pair * 2) = value >> 8;
+    *reg8(state, pair * 2 + 1) = value & 0xff;
+}
+
+// Whether register `code` belongs to a pair the body steps.
+static bool stepped(const LoopIdiom *loop, int code)
+{
+    return code != 7 && loop->step[code / 2] != 0;
+}
+
+static bool parse_idiom(const State8080 *state, uint16_t target, uint16_t branch, LoopIdiom *loop)
+{
+    const uint8_t *memory = state->memory;
+    uint16_t pc = target;
+    *loop = (LoopIdiom){.load = -1, .store = -1, .value = -1};
+    if (branch - target > 16 || memory[branch] != 0xc2)
+    {
+        return false;
     }
-    case 0x28: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0x29: // DAD H
-        dad(state, get_hl(state));
-        break;
-    case 0x2a: // LhlD Address
+
+    uint8_t op = memory[pc];
+    if (op == 0x0a || op == 0x1a || op == 0x7e) // LDAX B, LDAX D, MOV A,M
     {
-        uint16_t offset = (opcode[2] << 8) | opcode[1];
-        state->l = state->memory[offset];
-        state->h = state->memory[offset + 1];
-        state->pc += 2;
-        break;
+        loop->load = op == 0x7e ? 2 : op >> 4;
+        loop->period += cycles8080[op];
+        op = memory[++pc];
     }
-    case 0x2b: // DCX H
-        set_hl(state, get_hl(state) - 1);
-        break;
-    case 0x2c: // INR L
-        state->l = inr(state, state->l);
-        break;
-    case 0x2d: // DCR L
-        state->l = dcr(state, state->l);
-        break;
-    case 0x2e: // MVI L, D8
-        state->l = opcode[1];
-        state->pc++;
-        break;
-    case 0x2f: // CMA
-        state->a = ~state->a;
-        break;
-    case 0x30: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0x31: // LXI SP, Word
-        state->sp = (opcode[2] << 8) | opcode[1];
-        state->pc += 2;
-        break;
-    case 0x32: // STAX Address
+    if (op == 0x02 || op == 0x12) // STAX B, STAX D
     {
-        uint16_t offset = (opcode[2] << 8) | opcode[1];
-        write_mem(state, offset, state->a);
-        state->pc += 2;
-        break;
+        loop->store = op >> 4;
+        loop->value = 7;
     }
-    case 0x33: // INX SP
-        state->sp++;
-        break;
-    case 0x34: // INR M
+    else if (op == 0x36) // MVI M
     {
-        uint8_t result = inr(state, read_from_m(state));
-        write_to_m(state, result);
-        break;
+        loop->store = 2;
+        loop->imm = memory[(uint16_t)(pc + 1)];
     }
-    case 0x35: // DCR M
+    else if (op >= 0x70 && op <= 0x77 && op != 0x76) // MOV M,r
     {
-        uint8_t result = dcr(state, read_from_m(state));
-        write_to_m(state, result);
-        break;
+        loop->store = 2;
+        loop->value = op & 7;
     }
-    case 0x36: // MVI M, D8
-        write_to_m(state, opcode[1]);
-        state->pc++;
-        break;
-    case 0x37: // STC
-        state->cc.cy = 1;
-        break;
-    case 0x38: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0x39: // DAD SP
-        dad(state, state->sp);
-        break;
-    case 0x3a: // LDA Address
+    else
     {
-        uint16_t offset = (opcode[2] << 8) | opcode[1];
-        state->a = state->memory[offset];
-        state->pc += 2;
-        break;
+        return false;
     }
-    case 0x3b: // DCX SP
-        state->sp--;
-        break;
-    case 0x3c: // INR A
-        state->a = inr(state, state->a);
-        break;
-    case 0x3d: // DCR A
-        state->a = dcr(state, state->a);
-        break;
-    case 0x3e: // MVI A,D8
-        state->a = opcode[1];
-        state->pc++;
-        break;
-    case 0x3f: // CMC
-        state->cc.cy = !state->cc.cy;
-        break;
-    case 0x40: // MOV B, B
-        break;
-    case 0x41: // MOV B, C
-        state->b = state->c;
-        break;
-    case 0x42: // MOV B, D
-        state->b = state->d;
-        break;
-    case 0x43: // MOV B, E
-        state->b = state->e;
-        break;
-    case 0x44: // MOV B, H
-        state->b = state->h;
-        break;
-    case 0x45: // MOV B, L
-        state->b = state->l;
-        break;
-    case 0x46: // MOV B, M
-        state->b = read_from_m(state);
-        break;
-    case 0x47: // MOV B, A
-        state->b = state->a;
-        break;
-    case 0x48: // MOV C, B
-        state->c = state->b;
-        break;
-    case 0x49: // MOV, C, C
-        break;
-    case 0x4a: // MOV C, D
-        state->c = state->d;
-        break;
-    case 0x4b: // MOV C, E
-        state->c = state->e;
-        break;
-    case 0x4c: // MOV C, H
-        state->c = state->h;
-        break;
-    case 0x4d: // MOV C, L
-        state->c = state->l;
-        break;
-    case 0x4e: // MOV C, M
-        state->c = read_from_m(state);
-        break;
-    case 0x4f: // MOV C, A
-        state->c = state->a;
-        break;
-    case 0x50: // MOV D, B
-        state->d = state->b;
-        break;
-    case 0x51: // MOV D, C
-        state->d = state->c;
-        break;
-    case 0x52: // MOV D, D
-        break;
-    case 0x53: // MOV D, E
-        state->d = state->e;
-        break;
-    case 0x54: // MOV D, H
-        state->d = state->h;
-        break;
-    case 0x55: // MOV D, L
-        state->d = state->l;
-        break;
-    case 0x56: // MOV D, M
-        state->d = read_from_m(state);
-        break;
-    case 0x57: // MOV D, A
-        state->d = state->a;
-        break;
-    case 0x58: // MOV E, B
-        state->e = state->b;
-        break;
-    case 0x59: // MOV E, C
-        state->e = state->c;
-        break;
-    case 0x5a: // MOV E, D
-        state->e = state->d;
-        break;
-    case 0x5b: // MOV E, E
-        break;
-    case 0x5c: // MOV E, H
-        state->e = state->h;
-        break;
-    case 0x5d: // MOV E, L
-        state->e = state->l;
-        break;
-    case 0x5e: // MOV E, M
-        state->e = read_from_m(state);
-        break;
-    case 0x5f: // MOV E, A
-        state->e = state->a;
-        break;
-    case 0x60: // MOV H, B
-        state->h = state->b;
-        break;
-    case 0x61: // MOV H, C
-        state->h = state->c;
-        break;
-    case 0x62: // MOV H, D
-        state->h = state->d;
-        break;
-    case 0x63: // MOV H, E
-        state->h = state->e;
-        break;
-    case 0x64: // MOV H, H
-        break;
-    case 0x65: // MOV H, L
-        state->h = state->l;
-        break;
-    case 0x66: // MOV H, M
-        state->h = read_from_m(state);
-        break;
-    case 0x67: // MOV  H, A
-        state->h = state->a;
-        break;
-    case 0x68: // MOV L, B
-        state->l = state->b;
-        break;
-    case 0x69: // MOV L, C
-        state->l = state->c;
-        break;
-    case 0x6a: // MOV L, D
-        state->l = state->d;
-        break;
-    case 0x6b: // MOV L, E
-        state->l = state->e;
-        break;
-    case 0x6c: // MOV L, H
-        state->l = state->h;
-        break;
-    case 0x6d: // MOV L, L
-        break;
-    case 0x6e: // MOV L, M
-        state->l = read_from_m(state);
-        break;
-    case 0x6f: // MOV L, A
-        state->l = state->a;
-        break;
-    case 0x70: // MOV M, B
-        write_to_m(state, state->b);
-        break;
-    case 0x71: // MOV M, C
-        write_to_m(state, state->c);
-        break;
-    case 0x72: // MOV M, D
-        write_to_m(state, state->d);
-        break;
-    case 0x73: // MOV M, E
-        write_to_m(state, state->e);
-        break;
-    case 0x74: // MOV M, H
-        write_to_m(state, state->h);
-        break;
-    case 0x75: // MOV M, L
-        write_to_m(state, state->l);
-        break;
-    case 0x76: // hlT
-        unimplemented_instruction(state);
-        break;
-    case 0x77: // MOV M, A
-        write_to_m(state, state->a);
-        break;
-    case 0x78: // MOV A, B
-        state->a = state->b;
-        break;
-    case 0x79: // MOV A, C
-        state->a = state->c;
-        break;
-    case 0x7a: // MOV A, D
-        state->a = state->d;
-        break;
-    case 0x7b: // MOV A, E
-        state->a = state->e;
-        break;
-    case 0x7c: // MOV A, H
-        state->a = state->h;
-        break;
-    case 0x7d: // MOV A, L
-        state->a = state->l;
-        break;
-    case 0x7e: // MOV A, M
-        state->a = read_from_m(state);
-        break;
-    case 0x7f: // MOV A, A
-        break;
-    case 0x80: // ADD B
-        add(state, &state->a, state->b, 0);
-        break;
-    case 0x81: // ADD C
-        add(state, &state->a, state->c, 0);
-        break;
-    case 0x82: // ADD D
-        add(state, &state->a, state->d, 0);
-        break;
-    case 0x83: // ADD E
-        add(state, &state->a, state->e, 0);
-        break;
-    case 0x84: // ADD H
-        add(state, &state->a, state->h, 0);
-        break;
-    case 0x85: // ADD L
-        add(state, &state->a, state->l, 0);
-        break;
-    case 0x86: // ADD M
-        add(state, &state->a, read_from_m(state), 0);
-        break;
-    case 0x87: // ADD A
-        add(state, &state->a, state->a, 0);
-        break;
-    case 0x88: // ADC B
-        add(state, &state->a, state->b, state->cc.cy);
-        break;
-    case 0x89: // ADC C
-        add(state, &state->a, state->c, state->cc.cy);
-        break;
-    case 0x8a: // ADC D
-        add(state, &state->a, state->d, state->cc.cy);
-        break;
-    case 0x8b: // ADC E
-        add(state, &state->a, state->e, state->cc.cy);
-        break;
-    case 0x8c: // ADC H
-        add(state, &state->a, state->h, state->cc.cy);
-        break;
-    case 0x8d: // ADC L
-        add(state, &state->a, state->l, state->cc.cy);
-        break;
-    case 0x8e: // ADC M
-        add(state, &state->a, read_from_m(state), state->cc.cy);
-        break;
-    case 0x8f: // ADC A
-        add(state, &state->a, state->a, state->cc.cy);
-        break;
-    case 0x90: // SUB B
-        substract(state, &state->a, state->b, 0);
-        break;
-    case 0x91: // SUB C
-        substract(state, &state->a, state->c, 0);
-        break;
-    case 0x92: // SUB D
-        substract(state, &state->a, state->d, 0);
-        break;
-    case 0x93: // SUB E
-        substract(state, &state->a, state->e, 0);
-        break;
-    case 0x94: // SUB H
-        substract(state, &state->a, state->h, 0);
-        break;
-    case 0x95: // SUB L
-        substract(state, &state->a, state->l, 0);
-        break;
-    case 0x96: // SUB M
-        substract(state, &state->a, read_from_m(state), 0);
-        break;
-    case 0x97: // SUB A
-        substract(state, &state->a, state->a, 0);
-        break;
-    case 0x98: // SBB B
-        substract(state, &state->a, state->b, state->cc.cy);
-        break;
-    case 0x99: // SBB C
-        substract(state, &state->a, state->c, state->cc.cy);
-        break;
-    case 0x9a: // SBB D
-        substract(state, &state->a, state->d, state->cc.cy);
-        break;
-    case 0x9b: // SBB E
-        substract(state, &state->a, state->e, state->cc.cy);
-        break;
-    case 0x9c: // SBB H
-        substract(state, &state->a, state->h, state->cc.cy);
-        break;
-    case 0x9d: // SBB L
-        substract(state, &state->a, state->l, state->cc.cy);
-        break;
-    case 0x9e: // SBB M
-        substract(state, &state->a, read_from_m(state), state->cc.cy);
-        break;
-    case 0x9f: // SBB A
-        substract(state, &state->a, state->a, state->cc.cy);
-        break;
-    case 0xa0: // ANA B
-        ana(state, state->b);
-        break;
-    case 0xa1: // ANA C
-        ana(state, state->c);
-        break;
-    case 0xa2: // ANA D
-        ana(state, state->d);
-        break;
-    case 0xa3: // ANA E
-        ana(state, state->e);
-        break;
-    case 0xa4: // ANA H
-        ana(state, state->h);
-        break;
-    case 0xa5: // ANA L
-        ana(state, state->l);
-        break;
-    case 0xa6: // ANA M
-        ana(state, read_from_m(state));
-        break;
-    case 0xa7: // ANA A
-        ana(state, state->a);
-        break;
-    case 0xa8: // XRA B
-        xra(state, state->b);
-        break;
-    case 0xa9: // XRA C
-        xra(state, state->c);
-        break;
-    case 0xaa: // XRA D
-        xra(state, state->d);
-        break;
-    case 0xab: // XRA E
-        xra(state, state->e);
-        break;
-    case 0xac: // XRA H
-        xra(state, state->h);
-        break;
-    case 0xad: // XRA L
-        xra(state, state->l);
-        break;
-    case 0xae: // XRA M
-        xra(state, read_from_m(state));
-        break;
-    case 0xaf: // XRA A
-        xra(state, state->a);
-        break;
-    case 0xb0: // ORA B
-        ora(state, state->b);
-        break;
-    case 0xb1: // ORA C
-        ora(state, state->c);
-        break;
-    case 0xb2: // ORA D
-        ora(state, state->d);
-        break;
-    case 0xb3: // ORA E
-        ora(state, state->e);
-        break;
-    case 0xb4: // ORA H
-        ora(state, state->h);
-        break;
-    case 0xb5: // ORA L
-        ora(state, state->l);
-        break;
-    case 0xb6: // ORA M
-        ora(state, read_from_m(state));
-        break;
-    case 0xb7: // ORA A
-        ora(state, state->a);
-        break;
-    case 0xb8: // CMP B
-        cmp(state, state->b);
-        break;
-    case 0xb9: // CMP C
-        cmp(state, state->c);
-        break;
-    case 0xba: // CMP D
-        cmp(state, state->d);
-        break;
-    case 0xbb: // CMP E
-        cmp(state, state->e);
-        break;
-    case 0xbc: // CMP H
-        cmp(state, state->h);
-        break;
-    case 0xbd: // CMP L
-        cmp(state, state->l);
-        break;
-    case 0xbe: // CMP M
-        cmp(state, read_from_m(state));
-        break;
-    case 0xbf: // CMP A
-        cmp(state, state->a);
-        break;
-    case 0xc0: // RNZ
-        if (state->cc.z == 0)
+    loop->period += cycles8080[op];
+    pc += lengths8080[op];
+
+    // INX and DCX, once per pair.
+    for (op = memory[pc]; (op & 0xc7) == 0x03 && op < 0x30; op = memory[++pc])
+    {
+        int pair = op >> 4;
+        if (loop->step[pair] != 0)
         {
-            ret(state);
+            return false;
         }
-        break;
-    case 0xc1: // POP B
-        pop(state, &state->b, &state->c);
-        break;
-    case 0xc2: // JNZ Address
+        loop->step[pair] = op & 0x08 ? -1 : 1;
+        loop->period += cycles8080[op];
+    }
+
+    uint8_t next = memory[(uint16_t)(pc + 1)];
+    if ((op & 0xc7) == 0x05 && op != 0x35 && op != 0x3d) // DCR r, not M or A
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.z == 0);
-        break;
+        loop->exit = EXIT_DCR;
+        loop->counter = (op >> 3) & 7;
+        loop->period += cycles8080[op];
+        pc++;
     }
-    case 0xc3: // JMP Address
+    else if (op >= 0x78 && op <= 0x7d && next == 0xfe) // MOV A,r; CPI
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        state->pc = address;
-        break;
+        loop->exit = EXIT_CPI;
+        loop->counter = op & 7;
+        loop->compare = memory[(uint16_t)(pc + 2)];
+        loop->period += cycles8080[op] + cycles8080[next];
+        pc += 3;
     }
-    case 0xc4: // CNZ Address
+    else if (op >= 0x78 && op <= 0x7d && next >= 0xb0 && next <= 0xb5 &&
+             (op & 7) / 2 == (next & 7) / 2 && op - 0x78 != next - 0xb0) // MOV A,hi; ORA lo
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.z == 0);
-        break;
+        loop->exit = EXIT_PAIR;
+        loop->counter = (op & 7) / 2;
+        loop->period += cycles8080[op] + cycles8080[next];
+        pc += 2;
     }
-    case 0xc5: // push B
-        push(state, state->b, state->c);
-        break;
-    case 0xc6: // ADI Byte
-        add(state, &state->a, opcode[1], 0);
-        state->pc++;
-        break;
-    case 0xc7: // RST 0
-        call(state, state->pc, 0x0000);
-        break;
-    case 0xc8: // RZ
-        if (state->cc.z)
-        {
-            ret(state);
-        }
-        break;
-    case 0xc9: // RET
-        ret(state);
-        break;
-    case 0xca: // JZ Address
+    else
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.z);
-        break;
+        return false;
     }
-    case 0xcb: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0xcc: // CZ Address
+    if (pc != branch)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.z);
-        break;
+        return false;
     }
-    case 0xcd: // call Address
+    loop->period += cycles8080[0xc2];
+
+    // Every pass has to store somewhere new, and anything else it reads
+    // has to stay put or be reloaded before use.
+    if (loop->step[loop->store] == 0)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        call(state, state->pc + 2, address);
-        break;
+        return false;
     }
-    case 0xce: // ACI Byte
-        add(state, &state->a, opcode[1], state->cc.cy);
-        state->pc++;
-        break;
-    case 0xcf: // RST 1
-        call(state, state->pc, 0x0008);
-        break;
-    case 0xd0: // RNC
-        if (state->cc.cy == 0)
-        {
-            ret(state);
-        }
-        break;
-    case 0xd1: // POP D
-        pop(state, &state->d, &state->e);
-        break;
-    case 0xd2: // JNC Address
+    if (loop->load >= 0 && (loop->step[loop->load] == 0 || loop->load == loop->store ||
+                            loop->value != 7))
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.cy == 0);
-        break;
+        return false;
     }
-    case 0xd3: // OUT Byte
-        state->port_output(state->user_data, opcode[1], state->a);
-        state->pc++;
-        break;
-    case 0xd4: // CNC Address
+    if (loop->load < 0 && loop->value == 7 && loop->exit != EXIT_DCR)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.cy == 0);
-        break;
+        return false; // MOV A in the exit test changes what gets stored
     }
-    case 0xd5: // push D
-        push(state, state->d, state->e);
-        break;
-    case 0xd6: // SUI Byte
-        substract(state, &state->a, opcode[1], 0);
-        state->pc++;
-        break;
-    case 0xd7: // RST 2
-        call(state, state->pc, 0x0010);
-        break;
-    case 0xd8: // RC
-        if (state->cc.cy)
+    if (loop->value >= 0 && loop->value != 7 && stepped(loop, loop->value))
+    {
+        return false;
+    }
+    if (loop->exit == EXIT_DCR && (stepped(loop, loop->counter) || loop->counter == loop->value))
+    {
+        return false;
+    }
+    if (loop->exit == EXIT_PAIR && loop->step[loop->counter] == 0)
+    {
+        return false;
+    }
+    return true;
+}
+
+// Whether pass `k` from now branches back.
+static bool idiom_continues(State8080 *state, const LoopIdiom *loop, uint32_t k)
+{
+    switch (loop->exit)
+    {
+    case EXIT_DCR:
+        return (uint8_t)(*reg8(state, loop->counter) - k) != 0;
+    case EXIT_PAIR:
+        return (uint16_t)(get_pair(state, loop->counter) + k * loop->step[loop->counter]) != 0;
+    default:
+    {
+        int code = loop->counter;
+        if (!stepped(loop, code))
         {
-            ret(state);
+            return *reg8(state, code) != loop->compare;
         }
-        break;
-    case 0xd9: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0xda: // JC Address
+        uint16_t pair = get_pair(state, code / 2) + k * loop->step[code / 2];
+        uint8_t value = code & 1 ? pair & 0xff : pair >> 8;
+        return value != loop->compare;
+    }
+    }
+}
+
+// Runs the stores of passes [first, first + count) one by one and returns
+// how many ran, stopping short of a store into the loop itself.
+static uint32_t idiom_stores(State8080 *state, const LoopIdiom *loop, uint32_t first,
+                             uint32_t count, uint16_t target, uint16_t end)
+{
+    uint16_t store = get_pair(state, loop->store);
+    uint16_t load = loop->load >= 0 ? get_pair(state, loop->load) : 0;
+    uint8_t value = loop->value >= 0 ? *reg8(state, loop->value) : loop->imm;
+    for (uint32_t i = first; i < first + count; i++)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.cy);
-        break;
+        uint16_t address = store + i * loop->step[loop->store];
+        uint8_t *page = page_8080(state, state->map->write[address >> 8]);
+        uint32_t host = page != NULL ? code_offset_8080(state, &page[address & 0xff]) : address;
+        if (host >= target && host < end)
+        {
+            return i - first;
+        }
+        if (loop->load >= 0)
+        {
+            value = read_8080(state, load + i * loop->step[loop->load]);
+        }
+        write_8080(state, address, value);
     }
-    case 0xdb: // IN Byte
-        state->a = state->port_input(state->user_data, opcode[1]);
-        state->pc++;
-        break;
-    case 0xdc: // CC Address
+    return count;
+}
+
+// Runs the stores of the first `count` passes, a page at a time with
+// memset or memmove where the stores land in plain memory in ascending
+// order, and returns how many ran.
+static uint32_t run_idiom_stores(State8080 *state, const LoopIdiom *loop, uint32_t count,
+                                 uint16_t target, uint16_t end)
+{
+    if (loop->step[loop->store] != 1 || (loop->load >= 0 && loop->step[loop->load] != 1))
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.cy);
-        break;
+        return idiom_stores(state, loop, 0, count, target, end);
     }
-    case 0xdd: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0xde: // SBI Byte
-        substract(state, &state->a, opcode[1], state->cc.cy);
-        state->pc++;
-        break;
-    case 0xdf: // RST 3
-        call(state, state->pc, 0x0018);
-        break;
-    case 0xe0: // RPO
-        if (state->cc.p == 0)
+    uint16_t store = get_pair(state, loop->store);
+    uint16_t load = loop->load >= 0 ? get_pair(state, loop->load) : 0;
+    uint32_t done = 0;
+    while (done < count)
+    {
+        uint16_t to = store + done, from = load + done;
+        uint32_t size = count - done;
+        size = size < 0x100u - (to & 0xff) ? size : 0x100u - (to & 0xff);
+        if (loop->load >= 0)
         {
-            ret(state);
+            size = size < 0x100u - (from & 0xff) ? size : 0x100u - (from & 0xff);
         }
-        break;
-    case 0xe1: // POP H
-        pop(state, &state->h, &state->l);
-        break;
-    case 0xe2: // JPO Address
+        uint8_t *page = page_8080(state, state->map->write[to >> 8]);
+        uint8_t *dst = page != NULL ? &page[to & 0xff] : NULL;
+        const uint8_t *src = NULL;
+        if (loop->load >= 0)
+        {
+            src = &page_8080(state, state->map->read[from >> 8])[from & 0xff];
+        }
+        uint32_t host = dst != NULL ? code_offset_8080(state, dst) : 0x10000;
+        // Handlers, stores into the loop and a copy onto the bytes just
+        // ahead of its source (which repeats them) go one at a time.
+        if (dst == NULL || (host < end && host + size > target) ||
+            (src != NULL && dst > src && dst < src + size))
+        {
+            uint32_t stored = idiom_stores(state, loop, done, size, target, end);
+            done += stored;
+            if (stored < size)
+            {
+                break;
+            }
+            continue;
+        }
+        if (src != NULL)
+        {
+            memmove(dst, src, size);
+        }
+        else
+        {
+            memset(dst, loop->value >= 0 ? *reg8(state, loop->value) : loop->imm, size);
+        }
+#ifdef DECODE_CACHE
+        for (uint32_t i = 0; i < size; i++)
+        {
+            invalidate_8080_written(state, to + i);
+        }
+#endif
+        done += size;
+    }
+    return done;
+}
+
+// Called on a branch back from `branch` to `target` that `left` cycles of
+// the slice remain after. Runs the passes of a fill or copy loop that
+// branch back and fit in the slice, adds their cycles to cycle_count.
+// Returns false when the loop isn't one.
+static bool run_loop_idiom(State8080 *state, uint16_t target, uint16_t branch, uint32_t left)
+{
+    LoopIdiom loop;
+    if (!parse_idiom(state, target, branch, &loop))
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.p == 0);
-        break;
+        return false;
     }
-    case 0xe3: // XThl
+    uint32_t limit = (left - 1) / loop.period;
+    uint32_t passes = 0;
+    while (passes < limit && idiom_continues(state, &loop, passes + 1))
     {
-        uint8_t l = state->l;
-        uint8_t h = state->h;
-        state->l = state->memory[state->sp];
-        state->h = state->memory[state->sp + 1];
-        write_mem(state, state->sp, l);
-        write_mem(state, state->sp + 1, h);
-        break;
+        passes++;
     }
-    case 0xe4: // CPO Address
+    passes = run_idiom_stores(state, &loop, passes, target, branch + 3);
+    if (passes == 0)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.p == 0);
-        break;
+        return true;
     }
-    case 0xe5: // push H
-        push(state, state->h, state->l);
-        break;
-    case 0xe6: // ANI Byte
-        ana(state, opcode[1]);
-        state->pc++;
-        break;
-    case 0xe7: // RST 4
-        call(state, state->pc, 0x0020);
-        break;
-    case 0xe8: // RPE
-        if (state->cc.p)
-        {
-            ret(state);
-        }
-        break;
-    case 0xe9: // PChl
-        state->pc = get_hl(state);
-        break;
-    case 0xea: // JPE Address
+    if (loop.load >= 0)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.p);
-        break;
+        state->a = read_8080(state, get_pair(state, loop.load) + (passes - 1) * loop.step[loop.load]);
     }
-    case 0xeb: // XCHG
+    for (int pair = 0; pair < 3; pair++)
     {
-        uint16_t de = get_de(state);
-        set_de(state, get_hl(state));
-        set_hl(state, de);
-        break;
+        set_pair(state, pair, get_pair(state, pair) + passes * loop.step[pair]);
     }
-    case 0xec: // CPE Address
+    // The last pass's exit test leaves A and the flags.
+    switch (loop.exit)
+    {
+    case EXIT_DCR:
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.p);
+        uint8_t *counter = reg8(state, loop.counter);
+        *counter = dcr(state, *counter - (passes - 1));
         break;
     }
-    case 0xed: // Unused
-        unimplemented_instruction(state);
+    case EXIT_PAIR:
+        state->a = *reg8(state, loop.counter * 2);
+        ora(state, *reg8(state, loop.counter * 2 + 1));
         break;
-    case 0xee: // XRI Byte
-        xra(state, opcode[1]);
-        state->pc++;
+    default:
+        state->a = *reg8(state, loop.counter);
+        cmp(state, loop.compare);
         break;
-    case 0xef: // RST 5
-        call(state, state->pc, 0x0028);
-        break;
-    case 0xf0: // RP
-        if (state->cc.s == 0)
+    }
+    state->cycle_count += passes * loop.period;
+    state->idiom_passes += passes;
+    return true;
+}
+#endif
+
+// Idle loops: a backward branch whose body only loads A from memory or
+// other registers and tests it, like the ROM's wait for the interrupt
+// handlers to count a delay down. Each pass computes the same thing from
+// the same memory, so once it went round one whole pass it spins until an
+// interrupt changes RAM, at the end of the slice.
+
+// Opcodes an idle loop can start with, to pass over other loops quickly.
+static const bool idle_entry[256] = {
+    [0x00] = true, [0x0a] = true, [0x1a] = true, [0x3a] = true, [0x3e] = true,
+    [0x78] = true, [0x79] = true, [0x7a] = true, [0x7b] = true, [0x7c] = true,
+    [0x7d] = true, [0x7e] = true, [0x7f] = true, [0xaf] = true, [0xc3] = true,
+};
+
+// The last idle loop seen going round, to tell a whole pass from one that
+// was entered part way through.
+typedef struct IdleWatch
+{
+    uint32_t target; // 0x10000 for none
+    uint32_t since;  // cycle_count when it branched back
+} IdleWatch;
+
+// Cycles of one pass of the loop from `target` to the branch at `branch`,
+// or 0 when the body does more than load and test A.
+static uint32_t idle_period(const State8080 *state, uint16_t target, uint16_t branch)
+{
+    bool a_set = false, flags_set = false;
+    uint32_t cycles = 0;
+    uint16_t pc = target;
+    if (branch - target > 32)
+    {
+        return 0;
+    }
+    while (pc < branch)
+    {
+        uint8_t op = state->memory[pc];
+        if (op == 0x0a || op == 0x1a || op == 0x3a || op == 0x3e || op == 0xaf ||
+            (op >= 0x78 && op <= 0x7e))
         {
-            ret(state);
+            // LDAX, LDA, MVI A, XRA A, MOV A,r and MOV A,M
+            a_set = true;
         }
-        break;
-    case 0xf1: // POP PSW
-    {
-        uint8_t a = state->memory[state->sp + 1];
-        uint8_t psw = state->memory[state->sp];
-        state->sp += 2;
-        state->a = a;
-
-        state->cc.s = (psw >> 7) & 1;
-        state->cc.z = (psw >> 6) & 1;
-        state->cc.ac = (psw >> 4) & 1;
-        state->cc.p = (psw >> 2) & 1;
-        state->cc.cy = (psw >> 0) & 1;
-        break;
+        else if ((op >= 0xa0 && op <= 0xbf) || op == 0xe6 || op == 0xee || op == 0xf6 || op == 0xfe)
+        {
+            // ANA, XRA, ORA, CMP and their immediate forms
+            if (!a_set)
+            {
+                return 0;
+            }
+        }
+        else if (op != 0x00 && op != 0x7f)
+        {
+            return 0;
+        }
+        if (op >= 0xa0)
+        {
+            flags_set = true;
+        }
+        cycles += cycles8080[op];
+        pc += lengths8080[op];
     }
-    case 0xf2: // JP Address
+    uint8_t op = state->memory[branch];
+    if (pc != branch || (op != 0xc3 && !flags_set))
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.s == 0);
-        break;
+        return 0;
     }
-    case 0xf3: // DI
-        state->int_enable = 0;
-        break;
-    case 0xf4: // CP Address
+    return cycles + cycles8080[op];
+}
+
+// Called on a branch back from `branch` to `target` that `left` cycles of
+// the slice remain after. On the second whole pass of an idle loop in a
+// row, adds as many passes as the slice has room for to cycle_count, and
+// leaves the last one to run so the slice ends on the same instruction.
+static void skip_idle_loop(State8080 *state, IdleWatch *watch, uint16_t target, uint16_t branch,
+                           uint32_t left)
+{
+    uint32_t period = idle_period(state, target, branch);
+    if (period == 0)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.s == 0);
-        break;
+        return;
     }
-    case 0xf5: // push PSW
-    {
-        uint8_t psw = 0;
-        psw |= state->cc.s << 7;
-        psw |= state->cc.z << 6;
-        psw |= state->cc.ac << 4;
-        psw |= state->cc.p << 2;
-        psw |= 1 << 1; // bit 1 is always 1
-        psw |= state->cc.cy << 0;
-        write_mem(state, state->sp - 1, state->a);
-        write_mem(state, state->sp - 2, psw);
-        state->sp -= 2;
-        break;
+    if (watch->target != target || state->cycle_count - watch->since != period)
+    {
+        watch->target = target;
+        watch->since = state->cycle_count;
+        return;
     }
-    case 0xf6: // ORI Byte
-        ora(state, opcode[1]);
-        state->pc++;
-        break;
-    case 0xf7: // RST 6
-        call(state, state->pc, 0x0030);
-        break;
-    case 0xf8: // RM
-        if (state->cc.s)
+    uint32_t skipped = (left - 1) / period * period;
+    state->cycle_count += skipped;
+    state->idle_cycles += skipped;
+    watch->since = state->cycle_count;
+}
+
+State8080 *init_8080_on(uint8_t *memory)
+{
+#ifdef FLAG_TABLES
+    init_flag_tables();
+#endif
+    State8080 *state = calloc(1, sizeof(State8080));
+    state->memory = memory;
+    state->map = malloc(sizeof(MemoryMap8080));
+    // Read only, each page is its own ring of mirrors.
+    for (int page = 0; page < 256; page++)
+    {
+        state->map->read[page] = &memory[page << 8];
+        state->map->write[page] = NULL;
+        state->map->write_handler[page] = NULL;
+        state->map->mirror[page] = page;
+    }
+#ifdef DECODE_CACHE
+    state->decoded = calloc(0x10000, sizeof(DecodedOp8080));
+#endif
+    return state;
+}
+
+State8080 *init_8080(void)
+{
+    return init_8080_on(malloc(0x10000)); // 64K, the whole address space
+}
+
+void free_8080(State8080 *state)
+{
+    free(state->memory);
+    free(state->map);
+#ifdef DECODE_CACHE
+    free(state->decoded);
+#endif
+    free(state);
+}
+
+// Takes `page` out of its ring of mirrors, leaving it on its own.
+static void unlink_mirror(MemoryMap8080 *map, int page)
+{
+    int before = page;
+    while (map->mirror[before] != page)
+    {
+        before = map->mirror[before];
+    }
+    map->mirror[before] = map->mirror[page];
+    map->mirror[page] = page;
+}
+
+// Moves `page` from its ring of mirrors to the ring of the pages with its
+// new `write` pointer.
+static void relink_mirror(MemoryMap8080 *map, int page)
+{
+    unlink_mirror(map, page);
+    if (map->write[page] == NULL)
+    {
+        return;
+    }
+    for (int other = 0; other < 256; other++)
+    {
+        if (other != page && map->write[other] == map->write[page])
         {
-            ret(state);
+            map->mirror[page] = map->mirror[other];
+            map->mirror[other] = page;
+            return;
         }
-        break;
-    case 0xf9: // SPhl
-        state->sp = get_hl(state);
-        break;
-    case 0xfa: // JM Address
+    }
+}
+
+void map_8080_memory(State8080 *state, uint16_t address, uint32_t size, uint8_t *read,
+                     uint8_t *write, void (*write_handler)(void *, uint16_t, uint8_t))
+{
+    for (uint32_t offset = 0; offset < size; offset += 0x100)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_jump(state, address, state->cc.s);
-        break;
+        int page = (address + offset) >> 8;
+        state->map->read[page] = read + offset;
+        state->map->write[page] = write != NULL ? write + offset : NULL;
+        state->map->write_handler[page] = write_handler;
+        relink_mirror(state->map, page);
     }
-    case 0xfb: // EI
-        state->int_enable = 1;
-        break;
-    case 0xfc: // CM Address
+}
+
+void map_8080_mirrored(State8080 *state, uint16_t address, uint32_t size, uint32_t stride,
+                       uint8_t *read, uint8_t *write,
+                       void (*write_handler)(void *, uint16_t, uint8_t))
+{
+    MemoryMap8080 *map = state->map;
+    for (uint32_t offset = 0; offset < size; offset += 0x100)
     {
-        uint16_t address = (opcode[2] << 8) | opcode[1];
-        cond_call(state, address, state->cc.s);
-        break;
+        int first = (address + offset) >> 8;
+        int last = first;
+        for (uint32_t at = address + offset; at < 0x10000; at += stride)
+        {
+            int page = at >> 8;
+            unlink_mirror(map, page);
+            map->read[page] = read + offset;
+            map->write[page] = write != NULL ? write + offset : NULL;
+            map->write_handler[page] = write_handler;
+            // Stores through the mirrors land in the same byte.
+            if (write != NULL && page != first)
+            {
+                map->mirror[page] = map->mirror[last];
+                map->mirror[last] = page;
+            }
+            last = page;
+        }
     }
-    case 0xfd: // Unused
-        unimplemented_instruction(state);
-        break;
-    case 0xfe: // CPI Byte
+}
+
+void write_8080_handler(State8080 *state, uint16_t address, uint8_t value)
+{
+    void (*handler)(void *, uint16_t, uint8_t) = state->map->write_handler[address >> 8];
+    if (handler == NULL)
     {
-        cmp(state, opcode[1]);
-        state->pc++;
-        break;
+        bus_write_8080(state, address, value);
+        return;
     }
-    case 0xff: // RST 7
-        call(state, state->pc, 0x0038);
-        break;
+    handler(state->user_data, address, value);
+}
+
+#ifdef THREADED_DISPATCH
+// Direct threading: every handler ends with its own copy of the fetch and
+// indirect jump, so the host branch predictor learns each opcode's likely
+// successor instead of sharing a single switch jump. This relies on the
+// labels-as-values extension available in GCC and Clang.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#define OP(code) op_##code
+#define NEXT                                            \
+    do                                                  \
+    {                                                   \
+        state->cycle_count += CYCLES;                   \
+        if (state->cycle_count - start >= cycle_budget) \
+        {                                               \
+            goto done;                                  \
+        }                                               \
+        FETCH;                                          \
+        goto *dispatch_table[op];                       \
+    } while (0)
+#else
+#define OP(code) case code
+#define NEXT break
+#endif
+
+// Before IN and OUT, so port handlers that look at the registers see them.
+#if BUS_SEES_REGISTERS
+#define BUS_SYNC SAVE_REGS
+#else
+#define BUS_SYNC ((void)0)
+#endif
+
+// After a taken CALL, hands the routine it reached to its HLE hook, if the
+// CALL itself leaves some of the slice. The hook sees the registers and
+// cycle count as they are after the CALL, NEXT then counts the CALL.
+// A conditional CALL or RET that branches costs more than CYCLES.
+#define TAKEN(code) (state->cycle_count += taken_cycles8080[code] - cycles8080[code])
+
+#define RUN_HOOK                                                     \
+    do                                                               \
+    {                                                                \
+        uint32_t used = state->cycle_count - start + CYCLES;         \
+        if (!INSTRUMENTED && state->hooks != NULL && state->hooks[state->pc] != NULL && \
+            used < cycle_budget)                                     \
+        {                                                            \
+            state->cycle_count += CYCLES;                            \
+            SAVE_REGS;                                               \
+            state->hooks[state->pc](cpu, cycle_budget - used);       \
+            LOAD_REGS;                                               \
+            state->cycle_count -= CYCLES;                            \
+        }                                                            \
+    } while (0)
+
+// After a branch to `target`, looks for an idle loop if it went back and
+// the branch itself leaves some of the slice.
+#define SKIP_IDLE(target)                                                        \
+    do                                                                           \
+    {                                                                            \
+        uint32_t used = state->cycle_count - start + CYCLES;                     \
+        if (!INSTRUMENTED && state->skip_idle && state->pc == (target) &&        \
+            (target) <= OP_ADDRESS &&                                            \
+            used < cycle_budget && idle_entry[state->memory[target]])            \
+        {                                                                        \
+            skip_idle_loop(state, &idle, target, OP_ADDRESS, cycle_budget - used); \
+        }                                                                        \
+    } while (0)
+
+#ifdef LOOP_IDIOMS
+// After JNZ to `target`, looks for a fill or copy loop if it went back and
+// the branch itself leaves some of the slice. The last loop that wasn't one
+// isn't looked at again in the slice.
+#define RUN_IDIOM(target)                                                        \
+    do                                                                           \
+    {                                                                            \
+        uint32_t used = state->cycle_count - start + CYCLES;                     \
+        if (!INSTRUMENTED && state->pc == (target) && (target) < OP_ADDRESS &&   \
+            used < cycle_budget &&                                               \
+            (target) != not_idiom && idiom_entry[state->memory[target]] &&       \
+            !run_loop_idiom(state, target, OP_ADDRESS, cycle_budget - used))     \
+        {                                                                        \
+            not_idiom = target;                                                  \
+        }                                                                        \
+    } while (0)
+#else
+#define RUN_IDIOM(target) ((void)0)
+#endif
+
+#ifdef FLAG_LIVENESS
+// Opens a flag-less variant: unless the instructions up to the one that
+// overwrites the flags all retire within the slice, which is when the
+// flags can be seen, runs the normal handler instead.
+#define FLAGS_DEAD                                                                      \
+    if (INSTRUMENTED ||                                                                 \
+        state->cycle_count - start + entry->cycles + entry->span - 1 >= cycle_budget)   \
+    {                                                                                   \
+        op &= 0xff;                                                                     \
+        goto dispatch;                                                                  \
+    }
+#endif
+
+#ifdef PROFILE_PAIRS
+#define COUNT_PAIR (opcode_pairs_8080[previous_op][(uint8_t)op]++, previous_op = op)
+#else
+#define COUNT_PAIR ((void)0)
+#endif
+
+// The instrumented core shows the probe each instruction before it runs,
+// a false return ends the slice there.
+#define PROBE                                                                   \
+    do                                                                          \
+    {                                                                           \
+        if (INSTRUMENTED)                                                       \
+        {                                                                       \
+            SAVE_REGS;                                                          \
+            if (!state->probe(cpu, state->probe_data))                          \
+            {                                                                   \
+                goto done;                                                      \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+#ifdef DECODE_CACHE
+// Instructions are decoded once into `state->decoded`, keyed by their
+// address, and run from there until a store invalidates them.
+#define FETCH                                     \
+    do                                            \
+    {                                             \
+        PROBE;                                    \
+        entry = &state->decoded[state->pc];       \
+        if (entry->length == 0)                   \
+        {                                         \
+            entry = decode(state, state->pc);     \
+        }                                         \
+        op = entry->op;                           \
+        COUNT_PAIR;                               \
+        state->pc += 1;                           \
+    } while (0)
+#define IMM8 ((uint8_t)entry->imm)
+#define IMM16 (entry->imm)
+#define CYCLES (entry->cycles)
+#define OP_ADDRESS ((uint16_t)(entry - state->decoded))
+#else
+#define FETCH                               \
+    do                                      \
+    {                                       \
+        PROBE;                              \
+        opcode = &state->memory[state->pc]; \
+        op = *opcode;                       \
+        COUNT_PAIR;                         \
+        state->pc += 1;                     \
+    } while (0)
+#define IMM8 (opcode[1])
+#define IMM16 ((opcode[2] << 8) | opcode[1])
+#define CYCLES (cycles8080[op])
+#define OP_ADDRESS ((uint16_t)(opcode - state->memory))
+#endif
+
+#define RUN_8080 run_8080_plain
+#define INSTRUMENTED 0
+#define IN_PLACE 0
+#include "8080_run.h"
+#undef RUN_8080
+#undef INSTRUMENTED
+#undef IN_PLACE
+
+#define RUN_8080 run_8080_instrumented
+#define INSTRUMENTED 1
+#define IN_PLACE 0
+#include "8080_run.h"
+#undef RUN_8080
+#undef INSTRUMENTED
+#undef IN_PLACE
+
+#define RUN_8080 run_8080_step
+#define INSTRUMENTED 0
+#define IN_PLACE 1
+#include "8080_run.h"
+#undef RUN_8080
+#undef INSTRUMENTED
+#undef IN_PLACE
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+
+uint32_t emulate_8080_run(State8080 *cpu, uint32_t cycle_budget)
+{
+    // The core is picked per slice, so attaching or removing a probe takes
+    // effect at the next one.
+    if (cpu->probe != NULL)
+    {
+        return run_8080_instrumented(cpu, cycle_budget);
     }
+    return run_8080_plain(cpu, cycle_budget);
+}
 
-    state->cycle_count += cycles8080[*opcode];
-    return;
+void emulate_8080_op(State8080 *state)
+{
+    if (state->probe != NULL)
+    {
+        run_8080_instrumented(state, 1);
+        return;
+    }
+    run_8080_step(state, 1);
 }
@@ -1,12 +1,78 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "opcodes_8080.h"
 
 typedef struct ConditionCodes
 {
     bool s, z, ac, p, cy;
 } ConditionCodes;
 
+#ifdef LAZY_FLAGS
+typedef struct LazyFlags
+{
+    uint8_t op; // kind of the last flag setting operation, see 8080.c
+    uint8_t result;
+    uint8_t lhs, rhs;
+    bool cin;
+} LazyFlags;
+#endif
+
+#ifdef DECODE_CACHE
+// One pre-decoded instruction, `length` 0 marks an entry to decode again.
+typedef struct DecodedOp8080
+{
+    uint16_t imm; // the two bytes following the opcode
+#ifdef FLAG_LIVENESS
+    uint16_t op;  // 0x100 | opcode for the variant that leaves the flags alone
+    uint8_t span; // 1 + cycles until the flags are overwritten, for that variant
+#else
+    uint8_t op;
+#endif
+    uint8_t length;
+    uint8_t cycles;
+} DecodedOp8080;
+#endif
+
+// The address space as 256 pages of 256 bytes. Reads come from `read`, a
+// page with a `write` pointer is stored to directly, any other store goes
+// to the page's `write_handler`, or `State8080.write_byte` when it has
+// none (ROM, memory mapped I/O). Pages point into `State8080.memory`, which
+// instructions are fetched from, so several pages may share the same bytes
+// (mirroring) but code always runs from its own address. A pointer made by
+// own_8080 is an offset into the CPU's `own` memory instead, so CPUs that
+// each have theirs at the same addresses can share one map.
+typedef struct MemoryMap8080
+{
+    uint8_t *read[256];
+    uint8_t *write[256];
+    void (*write_handler[256])(void *, uint16_t, uint8_t);
+    // The next page with the same `write` pointer: a ring of the mirrors
+    // of each page, kept by map_8080_memory. A page without any, or
+    // without a `write` pointer, is a ring of its own.
+    uint8_t mirror[256];
+} MemoryMap8080;
+
+struct State8080;
+
+// High level emulation hook, run when a CALL reaches the guest routine it
+// replaces, with the return address pushed. It does as much of the routine
+// as the interpreter would retire in `left` cycles, adds those to
+// `cycle_count` and leaves `pc` where the guest code carries on: the
+// return address once done, or the entry to decline.
+typedef void (*Hook8080)(struct State8080 *state, uint32_t left);
+
+// Instrumentation for tracing, profiling, breakpoints and watchpoints. With
+// a probe set, emulate_8080_run runs a second copy of the interpreter that
+// calls it before each instruction, with the CPU as it is then, and runs
+// every instruction on its own: no HLE hooks, idle skipping, loop idioms,
+// superinstructions or flag-less variants. It may look at but not change
+// the CPU. Returning false ends the slice before the instruction, the
+// probe must let it through the next time for the CPU to get anywhere.
+// Set or clear it between slices.
+typedef bool (*Probe8080)(struct State8080 *state, void *data);
+
 typedef struct State8080
 {
     uint8_t a;
@@ -19,16 +85,162 @@ typedef struct State8080
     uint16_t sp;
     uint16_t pc;
     uint8_t *memory;
+    MemoryMap8080 *map;
+    uint8_t *own; // what own_8080 pointers in the map are offsets into
+#ifdef DECODE_CACHE
+    DecodedOp8080 *decoded; // indexed by address
+#endif
+#ifdef FLAG_LIVENESS
+    uint32_t analyzed_start, analyzed_end; // range analyze_8080_flags ran over
+#endif
+#ifdef FLAG_TABLES
+    uint8_t psw; // packed S Z - AC - P - CY, as stored by PUSH PSW
+#else
     struct ConditionCodes cc;
+#endif
+#ifdef LAZY_FLAGS
+    LazyFlags lazy;
+#endif
     uint8_t int_enable;
+    // The RST opcode of an interrupt requested while interrupts were
+    // disabled, held until EI, 0 for none. See request_interrupt_8080.
+    uint8_t held_interrupt;
+    Hook8080 *hooks; // indexed by address, NULL without HLE; interpreter only
+    Probe8080 probe; // NULL runs the plain core; interpreter only
+    void *probe_data;
 
     uint32_t cycle_count;
+    bool skip_idle;       // fast forward idle loops to the end of the slice, interpreter only
+    uint64_t idle_cycles; // cycles skipped that way
+#ifdef SUPERINSTRUCTIONS
+    uint64_t fused_dispatches; // dispatches saved by superinstructions
+#endif
+#ifdef LOOP_IDIOMS
+    uint64_t idiom_passes; // fill and copy loop passes run as memset/memmove
+#endif
+    // All callbacks receive `user_data` as their first argument.
     void *user_data;
     void (*write_byte)(void *, uint16_t, uint8_t);
     uint8_t (*port_input)(void *, uint8_t);
     void (*port_output)(void *, uint8_t, uint8_t);
 } State8080;
 
+// Columns of the opcode table (opcodes_8080.h), by opcode.
+extern const Opcode8080 opcodes8080[];
+extern const uint8_t lengths8080[]; // instruction size in bytes
+extern const uint8_t cycles8080[];
+extern const uint8_t taken_cycles8080[]; // a conditional CALL or RET that branches
+#ifdef PROFILE_PAIRS
+// How often each opcode ran right after another, [previous][next].
+extern uint64_t opcode_pairs_8080[256][256];
+#endif
+
 State8080 *init_8080(void);
+// A CPU on `memory`, 64K the caller provides, which it fetches code from.
+// Set `memory` to NULL before free_8080 when it belongs to someone else.
+State8080 *init_8080_on(uint8_t *memory);
+// Frees the CPU with its memory and map, either of which may be set to
+// NULL when it belongs to someone else.
+void free_8080(State8080 *state);
+// Runs one instruction, two for an EI that lets a held interrupt in.
 void emulate_8080_op(State8080 *state);
-void generate_interrupt(State8080 *state, int interrupt_num);
+// Runs instructions until at least `cycle_budget` cycles have been consumed
+// and returns the number of cycles actually used. The last instruction may
+// overshoot the budget.
+uint32_t emulate_8080_run(State8080 *state, uint32_t cycle_budget);
+// Runs RST `interrupt_num` if the CPU has interrupts enabled and disables
+// them, as the 8080 does. Returns false, changing nothing, otherwise.
+bool generate_interrupt(State8080 *state, int interrupt_num);
+// Requests RST `interrupt_num` between slices. It runs right away when
+// the CPU has interrupts enabled, else it is held, replacing one already
+// held, until EI. Interrupts only come on after the instruction that
+// follows EI: the cores end the slice there, or run that one instruction
+// on the interpreter, which then takes it.
+void request_interrupt_8080(State8080 *state, int interrupt_num);
+// Takes the held interrupt once EI let it in. Called by the cores as they
+// stop running guest code.
+static inline void take_held_interrupt_8080(State8080 *state)
+{
+    if (state->held_interrupt != 0 && state->int_enable)
+    {
+        generate_interrupt(state, (state->held_interrupt >> 3) & 7);
+        state->held_interrupt = 0;
+    }
+}
+// Memory callbacks call this after storing to an address that may hold
+// code, so a decoded copy of it isn't used any more. A no-op unless the
+// core is built with DECODE_CACHE.
+void invalidate_8080_decoded(State8080 *state, uint16_t address);
+// write_8080 calls this after storing to `address` through its page's
+// `write` pointer: the byte changed at every mirror of the page and at the
+// offset of `memory` it landed at. A no-op unless the core is built with
+// DECODE_CACHE.
+void invalidate_8080_written(State8080 *state, uint16_t address);
+// The offset of `byte` in `memory`, or 0x10000 when it lies elsewhere, in
+// memory the map reads and writes that code is never fetched from.
+static inline uint32_t code_offset_8080(const State8080 *state, const uint8_t *byte)
+{
+    uintptr_t offset = (uintptr_t)byte - (uintptr_t)state->memory;
+    return offset < 0x10000 ? (uint32_t)offset : 0x10000;
+}
+// The same for `size` bytes from `address` on, after copying them in
+// behind the core's back.
+void invalidate_8080_range(State8080 *state, uint16_t address, uint32_t size);
+// Pre-decodes `size` bytes of code from `address` on, typically the ROM
+// once loaded, marking the instructions whose flags are overwritten before
+// being read so they run without computing them. Stores into the range go
+// through invalidate_8080_decoded. A no-op unless the core is built with
+// FLAG_LIVENESS.
+void analyze_8080_flags(State8080 *state, uint16_t address, uint32_t size);
+#ifdef PROFILE_PAIRS
+// Prints the `count` most frequent opcode pairs.
+void report_opcode_pairs_8080(int count);
+#endif
+// The flags packed the way PUSH PSW stores them, whatever the flag mode.
+uint8_t get_psw_8080(State8080 *state);
+void set_psw_8080(State8080 *state, uint8_t psw);
+// A pointer for the map to `offset`, a multiple of 256, in the CPU's `own`
+// memory. The low bit tells it from a real one, which page_8080 undoes.
+static inline uint8_t *own_8080(uint32_t offset)
+{
+    return (uint8_t *)(uintptr_t)(offset | 1);
+}
+// The bytes `page`, a pointer from the map, stands for on this CPU.
+static inline uint8_t *page_8080(const State8080 *state, const uint8_t *page)
+{
+    uintptr_t bits = (uintptr_t)page;
+    uintptr_t own = bits & 1;
+    return (uint8_t *)((bits ^ own) + ((uintptr_t)state->own & (0 - own)));
+}
+// Maps `size` bytes from `address` on, both a multiple of 256, to `read`
+// and `write`. A NULL `write` sends stores to `write_handler` instead.
+// init_8080 maps all of `memory` for reading, with stores going to
+// `write_byte`.
+void map_8080_memory(State8080 *state, uint16_t address, uint32_t size, uint8_t *read,
+                     uint8_t *write, void (*write_handler)(void *, uint16_t, uint8_t));
+// The same at `address` and again every `stride` bytes up to the top of the
+// address space, as a board decodes mirrored memory, without looking for
+// other pages with the same `write` pointer: none may have it.
+void map_8080_mirrored(State8080 *state, uint16_t address, uint32_t size, uint32_t stride,
+                       uint8_t *read, uint8_t *write,
+                       void (*write_handler)(void *, uint16_t, uint8_t));
+void write_8080_handler(State8080 *state, uint16_t address, uint8_t value);
+
+static inline uint8_t read_8080(const State8080 *state, uint16_t address)
+{
+    return page_8080(state, state->map->read[address >> 8])[address & 0xff];
+}
+
+static inline void write_8080(State8080 *state, uint16_t address, uint8_t value)
+{
+    uint8_t *page = page_8080(state, state->map->write[address >> 8]);
+    if (page == NULL)
+    {
+        write_8080_handler(state, address, value);
+        return;
+    }
+    page[address & 0xff] = value;
+#ifdef DECODE_CACHE
+    invalidate_8080_written(state, address);
+#endif
+}
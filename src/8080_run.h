@@ -0,0 +1,1531 @@
+// The interpreter's run loop, included three times by 8080.c: as
+// run_8080_plain, with INSTRUMENTED as run_8080_instrumented and with
+// IN_PLACE as run_8080_step. Everything it uses is defined there.
+
+// Write the private copy of the registers back to the caller's State8080
+// and load it again from there, nothing to do in place.
+#if IN_PLACE
+#define SAVE_REGS ((void)0)
+#define LOAD_REGS ((void)0)
+#else
+#define SAVE_REGS (*cpu = regs)
+#define LOAD_REGS (regs = *cpu)
+#endif
+
+static uint32_t RUN_8080(State8080 *cpu, uint32_t cycle_budget)
+{
+#if IN_PLACE
+    // Single steps run on the caller's registers: copying them in and out
+    // costs more than the instruction.
+    State8080 *const state = cpu;
+#else
+    // Work on a private copy of the registers so the compiler can keep them
+    // in host registers for the whole slice. `&regs` must never escape (the
+    // memory callback gets `user_data`), and the copy is written back before
+    // any port callback that can look at (but not change) the registers.
+    State8080 regs = *cpu;
+    State8080 *const state = &regs;
+#endif
+    uint32_t start = state->cycle_count;
+#ifdef DECODE_CACHE
+    DecodedOp8080 *entry;
+#else
+    unsigned char *opcode;
+#endif
+#ifdef FLAG_LIVENESS
+    uint16_t op;
+#else
+    uint8_t op;
+#endif
+#ifdef PROFILE_PAIRS
+    uint8_t previous_op = 0;
+#endif
+    IdleWatch idle = {0x10000, 0};
+#ifdef LOOP_IDIOMS
+    uint32_t not_idiom = 0x10000;
+#endif
+
+#ifdef THREADED_DISPATCH
+    // clang-format off
+    static void *const dispatch_table[] = {
+        &&op_0x00, &&op_0x01, &&op_0x02, &&op_0x03, &&op_0x04, &&op_0x05, &&op_0x06, &&op_0x07, &&op_0x08, &&op_0x09, &&op_0x0a, &&op_0x0b, &&op_0x0c, &&op_0x0d, &&op_0x0e, &&op_0x0f,
+        &&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13, &&op_0x14, &&op_0x15, &&op_0x16, &&op_0x17, &&op_0x18, &&op_0x19, &&op_0x1a, &&op_0x1b, &&op_0x1c, &&op_0x1d, &&op_0x1e, &&op_0x1f,
+        &&op_0x20, &&op_0x21, &&op_0x22, &&op_0x23, &&op_0x24, &&op_0x25, &&op_0x26, &&op_0x27, &&op_0x28, &&op_0x29, &&op_0x2a, &&op_0x2b, &&op_0x2c, &&op_0x2d, &&op_0x2e, &&op_0x2f,
+        &&op_0x30, &&op_0x31, &&op_0x32, &&op_0x33, &&op_0x34, &&op_0x35, &&op_0x36, &&op_0x37, &&op_0x38, &&op_0x39, &&op_0x3a, &&op_0x3b, &&op_0x3c, &&op_0x3d, &&op_0x3e, &&op_0x3f,
+        &&op_0x40, &&op_0x41, &&op_0x42, &&op_0x43, &&op_0x44, &&op_0x45, &&op_0x46, &&op_0x47, &&op_0x48, &&op_0x49, &&op_0x4a, &&op_0x4b, &&op_0x4c, &&op_0x4d, &&op_0x4e, &&op_0x4f,
+        &&op_0x50, &&op_0x51, &&op_0x52, &&op_0x53, &&op_0x54, &&op_0x55, &&op_0x56, &&op_0x57, &&op_0x58, &&op_0x59, &&op_0x5a, &&op_0x5b, &&op_0x5c, &&op_0x5d, &&op_0x5e, &&op_0x5f,
+        &&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63, &&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67, &&op_0x68, &&op_0x69, &&op_0x6a, &&op_0x6b, &&op_0x6c, &&op_0x6d, &&op_0x6e, &&op_0x6f,
+        &&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73, &&op_0x74, &&op_0x75, &&op_0x76, &&op_0x77, &&op_0x78, &&op_0x79, &&op_0x7a, &&op_0x7b, &&op_0x7c, &&op_0x7d, &&op_0x7e, &&op_0x7f,
+        &&op_0x80, &&op_0x81, &&op_0x82, &&op_0x83, &&op_0x84, &&op_0x85, &&op_0x86, &&op_0x87, &&op_0x88, &&op_0x89, &&op_0x8a, &&op_0x8b, &&op_0x8c, &&op_0x8d, &&op_0x8e, &&op_0x8f,
+        &&op_0x90, &&op_0x91, &&op_0x92, &&op_0x93, &&op_0x94, &&op_0x95, &&op_0x96, &&op_0x97, &&op_0x98, &&op_0x99, &&op_0x9a, &&op_0x9b, &&op_0x9c, &&op_0x9d, &&op_0x9e, &&op_0x9f,
+        &&op_0xa0, &&op_0xa1, &&op_0xa2, &&op_0xa3, &&op_0xa4, &&op_0xa5, &&op_0xa6, &&op_0xa7, &&op_0xa8, &&op_0xa9, &&op_0xaa, &&op_0xab, &&op_0xac, &&op_0xad, &&op_0xae, &&op_0xaf,
+        &&op_0xb0, &&op_0xb1, &&op_0xb2, &&op_0xb3, &&op_0xb4, &&op_0xb5, &&op_0xb6, &&op_0xb7, &&op_0xb8, &&op_0xb9, &&op_0xba, &&op_0xbb, &&op_0xbc, &&op_0xbd, &&op_0xbe, &&op_0xbf,
+        &&op_0xc0, &&op_0xc1, &&op_0xc2, &&op_0xc3, &&op_0xc4, &&op_0xc5, &&op_0xc6, &&op_0xc7, &&op_0xc8, &&op_0xc9, &&op_0xca, &&op_0xcb, &&op_0xcc, &&op_0xcd, &&op_0xce, &&op_0xcf,
+        &&op_0xd0, &&op_0xd1, &&op_0xd2, &&op_0xd3, &&op_0xd4, &&op_0xd5, &&op_0xd6, &&op_0xd7, &&op_0xd8, &&op_0xd9, &&op_0xda, &&op_0xdb, &&op_0xdc, &&op_0xdd, &&op_0xde, &&op_0xdf,
+        &&op_0xe0, &&op_0xe1, &&op_0xe2, &&op_0xe3, &&op_0xe4, &&op_0xe5, &&op_0xe6, &&op_0xe7, &&op_0xe8, &&op_0xe9, &&op_0xea, &&op_0xeb, &&op_0xec, &&op_0xed, &&op_0xee, &&op_0xef,
+        &&op_0xf0, &&op_0xf1, &&op_0xf2, &&op_0xf3, &&op_0xf4, &&op_0xf5, &&op_0xf6, &&op_0xf7, &&op_0xf8, &&op_0xf9, &&op_0xfa, &&op_0xfb, &&op_0xfc, &&op_0xfd, &&op_0xfe, &&op_0xff,
+#ifdef FLAG_LIVENESS
+        // Flag-less variants, the other opcodes run their normal handler.
+        &&op_0x00, &&op_0x01, &&op_0x02, &&op_0x03, &&op_0x104, &&op_0x105, &&op_0x06, &&op_0x07, &&op_0x08, &&op_0x09, &&op_0x0a, &&op_0x0b, &&op_0x10c, &&op_0x10d, &&op_0x0e, &&op_0x0f,
+        &&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13, &&op_0x114, &&op_0x115, &&op_0x16, &&op_0x17, &&op_0x18, &&op_0x19, &&op_0x1a, &&op_0x1b, &&op_0x11c, &&op_0x11d, &&op_0x1e, &&op_0x1f,
+        &&op_0x20, &&op_0x21, &&op_0x22, &&op_0x23, &&op_0x124, &&op_0x125, &&op_0x26, &&op_0x27, &&op_0x28, &&op_0x29, &&op_0x2a, &&op_0x2b, &&op_0x12c, &&op_0x12d, &&op_0x2e, &&op_0x2f,
+        &&op_0x30, &&op_0x31, &&op_0x32, &&op_0x33, &&op_0x134, &&op_0x135, &&op_0x36, &&op_0x37, &&op_0x38, &&op_0x39, &&op_0x3a, &&op_0x3b, &&op_0x13c, &&op_0x13d, &&op_0x3e, &&op_0x3f,
+        &&op_0x40, &&op_0x41, &&op_0x42, &&op_0x43, &&op_0x44, &&op_0x45, &&op_0x46, &&op_0x47, &&op_0x48, &&op_0x49, &&op_0x4a, &&op_0x4b, &&op_0x4c, &&op_0x4d, &&op_0x4e, &&op_0x4f,
+        &&op_0x50, &&op_0x51, &&op_0x52, &&op_0x53, &&op_0x54, &&op_0x55, &&op_0x56, &&op_0x57, &&op_0x58, &&op_0x59, &&op_0x5a, &&op_0x5b, &&op_0x5c, &&op_0x5d, &&op_0x5e, &&op_0x5f,
+        &&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63, &&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67, &&op_0x68, &&op_0x69, &&op_0x6a, &&op_0x6b, &&op_0x6c, &&op_0x6d, &&op_0x6e, &&op_0x6f,
+        &&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73, &&op_0x74, &&op_0x75, &&op_0x76, &&op_0x77, &&op_0x78, &&op_0x79, &&op_0x7a, &&op_0x7b, &&op_0x7c, &&op_0x7d, &&op_0x7e, &&op_0x7f,
+        &&op_0x180, &&op_0x181, &&op_0x182, &&op_0x183, &&op_0x184, &&op_0x185, &&op_0x186, &&op_0x187, &&op_0x188, &&op_0x189, &&op_0x18a, &&op_0x18b, &&op_0x18c, &&op_0x18d, &&op_0x18e, &&op_0x18f,
+        &&op_0x190, &&op_0x191, &&op_0x192, &&op_0x193, &&op_0x194, &&op_0x195, &&op_0x196, &&op_0x197, &&op_0x198, &&op_0x199, &&op_0x19a, &&op_0x19b, &&op_0x19c, &&op_0x19d, &&op_0x19e, &&op_0x19f,
+        &&op_0x1a0, &&op_0x1a1, &&op_0x1a2, &&op_0x1a3, &&op_0x1a4, &&op_0x1a5, &&op_0x1a6, &&op_0x1a7, &&op_0x1a8, &&op_0x1a9, &&op_0x1aa, &&op_0x1ab, &&op_0x1ac, &&op_0x1ad, &&op_0x1ae, &&op_0x1af,
+        &&op_0x1b0, &&op_0x1b1, &&op_0x1b2, &&op_0x1b3, &&op_0x1b4, &&op_0x1b5, &&op_0x1b6, &&op_0x1b7, &&op_0x1b8, &&op_0x1b9, &&op_0x1ba, &&op_0x1bb, &&op_0x1bc, &&op_0x1bd, &&op_0x1be, &&op_0x1bf,
+        &&op_0xc0, &&op_0xc1, &&op_0xc2, &&op_0xc3, &&op_0xc4, &&op_0xc5, &&op_0x1c6, &&op_0xc7, &&op_0xc8, &&op_0xc9, &&op_0xca, &&op_0xcb, &&op_0xcc, &&op_0xcd, &&op_0x1ce, &&op_0xcf,
+        &&op_0xd0, &&op_0xd1, &&op_0xd2, &&op_0xd3, &&op_0xd4, &&op_0xd5, &&op_0x1d6, &&op_0xd7, &&op_0xd8, &&op_0xd9, &&op_0xda, &&op_0xdb, &&op_0xdc, &&op_0xdd, &&op_0x1de, &&op_0xdf,
+        &&op_0xe0, &&op_0xe1, &&op_0xe2, &&op_0xe3, &&op_0xe4, &&op_0xe5, &&op_0x1e6, &&op_0xe7, &&op_0xe8, &&op_0xe9, &&op_0xea, &&op_0xeb, &&op_0xec, &&op_0xed, &&op_0x1ee, &&op_0xef,
+        &&op_0xf0, &&op_0xf1, &&op_0xf2, &&op_0xf3, &&op_0xf4, &&op_0xf5, &&op_0x1f6, &&op_0xf7, &&op_0xf8, &&op_0xf9, &&op_0xfa, &&op_0xfb, &&op_0xfc, &&op_0xfd, &&op_0x1fe, &&op_0xff,
+#endif
+    };
+    // clang-format on
+#endif
+
+    for (;;)
+    {
+        FETCH;
+
+#ifdef FLAG_LIVENESS
+    dispatch:
+#endif
+#ifdef THREADED_DISPATCH
+        goto *dispatch_table[op];
+#else
+        switch (op)
+#endif
+        {
+        OP(0x00): // NOP
+            NEXT;
+        OP(0x01): // LXI B, Word
+            state->c = IMM8;
+            state->b = IMM16 >> 8;
+            state->pc += 2;
+            NEXT;
+        OP(0x02): // STAX B
+        {
+            write_mem(state, get_bc(state), state->a);
+            NEXT;
+        }
+        OP(0x03): // INX B
+        {
+            set_bc(state, get_bc(state) + 1);
+            NEXT;
+        }
+        OP(0x04): // INR B
+            state->b = inr(state, state->b);
+            NEXT;
+        OP(0x05): // DCR B
+            state->b = dcr(state, state->b);
+            NEXT;
+        OP(0x06): // MVI B, D8
+            state->b = IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x07): // RLC
+        {
+            uint8_t bit_seven = state->a >> 7;
+            state->a = (state->a << 1) | bit_seven;
+            set_cy(state, bit_seven);
+            NEXT;
+        }
+        OP(0x08): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x09): // DAD B
+        {
+            dad(state, get_bc(state));
+            NEXT;
+        }
+        OP(0x0a): // LDA B
+        {
+            state->a = read_8080(state, get_bc(state));
+            NEXT;
+        }
+        OP(0x0b): // DCX B
+        {
+            set_bc(state, get_bc(state) - 1);
+            NEXT;
+        }
+        OP(0x0c): // INR C
+            state->c = inr(state, state->c);
+            NEXT;
+        OP(0x0d): // DCR C
+            state->c = dcr(state, state->c);
+            NEXT;
+        OP(0x0e): // MVI C, D8
+            state->c = IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x0f): // RRC
+        {
+            uint8_t bit_zero = state->a & 0x1;
+            state->a = (state->a >> 1) | (bit_zero << 7);
+            set_cy(state, bit_zero);
+            NEXT;
+        }
+        OP(0x10): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x11): // LXI D, Word
+            state->e = IMM8;
+            state->d = IMM16 >> 8;
+            state->pc += 2;
+            NEXT;
+        OP(0x12): // STAX D
+            write_mem(state, get_de(state), state->a);
+            NEXT;
+        OP(0x13): // INX D
+            set_de(state, get_de(state) + 1);
+            NEXT;
+        OP(0x14): // INR D
+            state->d = inr(state, state->d);
+            NEXT;
+        OP(0x15): // DCR D
+            state->d = dcr(state, state->d);
+            NEXT;
+        OP(0x16): // MVI D, D8
+            state->d = IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x17): // RAL
+        {
+            uint8_t bit_seven = state->a >> 7;
+            state->a = (state->a << 1) | flag_cy(state);
+            set_cy(state, bit_seven);
+            NEXT;
+        }
+        OP(0x18): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x19): // DAD D
+            dad(state, get_de(state));
+            NEXT;
+        OP(0x1a): // LDA D
+#ifdef SUPERINSTRUCTIONS
+            if (!INSTRUMENTED && copy_loop(state, cycle_budget - (state->cycle_count - start)))
+            {
+                NEXT;
+            }
+#endif
+            state->a = read_8080(state, get_de(state));
+            NEXT;
+        OP(0x1b): // DCX D
+            set_de(state, get_de(state) - 1);
+            NEXT;
+        OP(0x1c): // INR E
+            state->e = inr(state, state->e);
+            NEXT;
+        OP(0x1d): // DCR E
+            state->e = dcr(state, state->e);
+            NEXT;
+        OP(0x1e): // MVI E, Byte
+            state->e = IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x1f): // RAR
+        {
+            uint8_t bit_zero = state->a & 0x1;
+            state->a = (state->a >> 1) | (flag_cy(state) << 7);
+            set_cy(state, bit_zero);
+            NEXT;
+        }
+        OP(0x20): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x21): // LXI H, Word
+            state->l = IMM8;
+            state->h = IMM16 >> 8;
+            state->pc += 2;
+            NEXT;
+        OP(0x22): // ShlD Address
+        {
+            uint16_t offset = IMM16;
+            write_mem(state, offset, state->l);
+            write_mem(state, offset + 1, state->h);
+            state->pc += 2;
+            NEXT;
+        }
+        OP(0x23): // INX H
+#ifdef SUPERINSTRUCTIONS
+            if (!INSTRUMENTED && hl_loop_end(state, cycle_budget - (state->cycle_count - start)))
+            {
+                NEXT;
+            }
+#endif
+            set_hl(state, get_hl(state) + 1);
+            NEXT;
+        OP(0x24): // INR H
+            state->h = inr(state, state->h);
+            NEXT;
+        OP(0x25): // DCR H
+            state->h = dcr(state, state->h);
+            NEXT;
+        OP(0x26): // MVI H, D8
+            state->h = IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x27): // DAA
+        {
+            bool cy = flag_cy(state);
+            uint8_t correction = 0;
+
+            uint8_t lsb = state->a & 0x0F;
+            uint8_t msb = state->a >> 4;
+
+            if (flag_ac(state) || lsb > 9)
+            {
+                correction += 0x06;
+            }
+
+            if (flag_cy(state) || msb > 9 || (msb >= 9 && lsb > 9))
+            {
+                correction += 0x60;
+                cy = 1;
+            }
+
+            add(state, &state->a, correction, 0);
+            set_cy(state, cy);
+            NEXT;
+        }
+        OP(0x28): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x29): // DAD H
+            dad(state, get_hl(state));
+            NEXT;
+        OP(0x2a): // LhlD Address
+        {
+            uint16_t offset = IMM16;
+            state->l = read_8080(state, offset);
+            state->h = read_8080(state, offset + 1);
+            state->pc += 2;
+            NEXT;
+        }
+        OP(0x2b): // DCX H
+            set_hl(state, get_hl(state) - 1);
+            NEXT;
+        OP(0x2c): // INR L
+            state->l = inr(state, state->l);
+            NEXT;
+        OP(0x2d): // DCR L
+            state->l = dcr(state, state->l);
+            NEXT;
+        OP(0x2e): // MVI L, D8
+            state->l = IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x2f): // CMA
+            state->a = ~state->a;
+            NEXT;
+        OP(0x30): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x31): // LXI SP, Word
+            state->sp = IMM16;
+            state->pc += 2;
+            NEXT;
+        OP(0x32): // STAX Address
+        {
+            uint16_t offset = IMM16;
+            write_mem(state, offset, state->a);
+            state->pc += 2;
+            NEXT;
+        }
+        OP(0x33): // INX SP
+            state->sp++;
+            NEXT;
+        OP(0x34): // INR M
+        {
+            uint8_t result = inr(state, read_from_m(state));
+            write_to_m(state, result);
+            NEXT;
+        }
+        OP(0x35): // DCR M
+        {
+            uint8_t result = dcr(state, read_from_m(state));
+            write_to_m(state, result);
+            NEXT;
+        }
+        OP(0x36): // MVI M, D8
+#ifdef SUPERINSTRUCTIONS
+            if (!INSTRUMENTED && fill_loop(state, cycle_budget - (state->cycle_count - start)))
+            {
+                NEXT;
+            }
+#endif
+            write_to_m(state, IMM8);
+            state->pc++;
+            NEXT;
+        OP(0x37): // STC
+            set_cy(state, 1);
+            NEXT;
+        OP(0x38): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x39): // DAD SP
+            dad(state, state->sp);
+            NEXT;
+        OP(0x3a): // LDA Address
+        {
+            uint16_t offset = IMM16;
+            state->a = read_8080(state, offset);
+            state->pc += 2;
+            NEXT;
+        }
+        OP(0x3b): // DCX SP
+            state->sp--;
+            NEXT;
+        OP(0x3c): // INR A
+            state->a = inr(state, state->a);
+            NEXT;
+        OP(0x3d): // DCR A
+            state->a = dcr(state, state->a);
+            NEXT;
+        OP(0x3e): // MVI A,D8
+            state->a = IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x3f): // CMC
+            set_cy(state, !flag_cy(state));
+            NEXT;
+        OP(0x40): // MOV B, B
+            NEXT;
+        OP(0x41): // MOV B, C
+            state->b = state->c;
+            NEXT;
+        OP(0x42): // MOV B, D
+            state->b = state->d;
+            NEXT;
+        OP(0x43): // MOV B, E
+            state->b = state->e;
+            NEXT;
+        OP(0x44): // MOV B, H
+            state->b = state->h;
+            NEXT;
+        OP(0x45): // MOV B, L
+            state->b = state->l;
+            NEXT;
+        OP(0x46): // MOV B, M
+            state->b = read_from_m(state);
+            NEXT;
+        OP(0x47): // MOV B, A
+            state->b = state->a;
+            NEXT;
+        OP(0x48): // MOV C, B
+            state->c = state->b;
+            NEXT;
+        OP(0x49): // MOV, C, C
+            NEXT;
+        OP(0x4a): // MOV C, D
+            state->c = state->d;
+            NEXT;
+        OP(0x4b): // MOV C, E
+            state->c = state->e;
+            NEXT;
+        OP(0x4c): // MOV C, H
+            state->c = state->h;
+            NEXT;
+        OP(0x4d): // MOV C, L
+            state->c = state->l;
+            NEXT;
+        OP(0x4e): // MOV C, M
+            state->c = read_from_m(state);
+            NEXT;
+        OP(0x4f): // MOV C, A
+            state->c = state->a;
+            NEXT;
+        OP(0x50): // MOV D, B
+            state->d = state->b;
+            NEXT;
+        OP(0x51): // MOV D, C
+            state->d = state->c;
+            NEXT;
+        OP(0x52): // MOV D, D
+            NEXT;
+        OP(0x53): // MOV D, E
+            state->d = state->e;
+            NEXT;
+        OP(0x54): // MOV D, H
+            state->d = state->h;
+            NEXT;
+        OP(0x55): // MOV D, L
+            state->d = state->l;
+            NEXT;
+        OP(0x56): // MOV D, M
+            state->d = read_from_m(state);
+            NEXT;
+        OP(0x57): // MOV D, A
+            state->d = state->a;
+            NEXT;
+        OP(0x58): // MOV E, B
+            state->e = state->b;
+            NEXT;
+        OP(0x59): // MOV E, C
+            state->e = state->c;
+            NEXT;
+        OP(0x5a): // MOV E, D
+            state->e = state->d;
+            NEXT;
+        OP(0x5b): // MOV E, E
+            NEXT;
+        OP(0x5c): // MOV E, H
+            state->e = state->h;
+            NEXT;
+        OP(0x5d): // MOV E, L
+            state->e = state->l;
+            NEXT;
+        OP(0x5e): // MOV E, M
+            state->e = read_from_m(state);
+            NEXT;
+        OP(0x5f): // MOV E, A
+            state->e = state->a;
+            NEXT;
+        OP(0x60): // MOV H, B
+            state->h = state->b;
+            NEXT;
+        OP(0x61): // MOV H, C
+            state->h = state->c;
+            NEXT;
+        OP(0x62): // MOV H, D
+            state->h = state->d;
+            NEXT;
+        OP(0x63): // MOV H, E
+            state->h = state->e;
+            NEXT;
+        OP(0x64): // MOV H, H
+            NEXT;
+        OP(0x65): // MOV H, L
+            state->h = state->l;
+            NEXT;
+        OP(0x66): // MOV H, M
+            state->h = read_from_m(state);
+            NEXT;
+        OP(0x67): // MOV  H, A
+            state->h = state->a;
+            NEXT;
+        OP(0x68): // MOV L, B
+            state->l = state->b;
+            NEXT;
+        OP(0x69): // MOV L, C
+            state->l = state->c;
+            NEXT;
+        OP(0x6a): // MOV L, D
+            state->l = state->d;
+            NEXT;
+        OP(0x6b): // MOV L, E
+            state->l = state->e;
+            NEXT;
+        OP(0x6c): // MOV L, H
+            state->l = state->h;
+            NEXT;
+        OP(0x6d): // MOV L, L
+            NEXT;
+        OP(0x6e): // MOV L, M
+            state->l = read_from_m(state);
+            NEXT;
+        OP(0x6f): // MOV L, A
+            state->l = state->a;
+            NEXT;
+        OP(0x70): // MOV M, B
+            write_to_m(state, state->b);
+            NEXT;
+        OP(0x71): // MOV M, C
+            write_to_m(state, state->c);
+            NEXT;
+        OP(0x72): // MOV M, D
+            write_to_m(state, state->d);
+            NEXT;
+        OP(0x73): // MOV M, E
+            write_to_m(state, state->e);
+            NEXT;
+        OP(0x74): // MOV M, H
+            write_to_m(state, state->h);
+            NEXT;
+        OP(0x75): // MOV M, L
+            write_to_m(state, state->l);
+            NEXT;
+        OP(0x76): // hlT
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0x77): // MOV M, A
+            write_to_m(state, state->a);
+            NEXT;
+        OP(0x78): // MOV A, B
+            state->a = state->b;
+            NEXT;
+        OP(0x79): // MOV A, C
+            state->a = state->c;
+            NEXT;
+        OP(0x7a): // MOV A, D
+            state->a = state->d;
+            NEXT;
+        OP(0x7b): // MOV A, E
+            state->a = state->e;
+            NEXT;
+        OP(0x7c): // MOV A, H
+            state->a = state->h;
+            NEXT;
+        OP(0x7d): // MOV A, L
+            state->a = state->l;
+            NEXT;
+        OP(0x7e): // MOV A, M
+            state->a = read_from_m(state);
+            NEXT;
+        OP(0x7f): // MOV A, A
+            NEXT;
+        OP(0x80): // ADD B
+            add(state, &state->a, state->b, 0);
+            NEXT;
+        OP(0x81): // ADD C
+            add(state, &state->a, state->c, 0);
+            NEXT;
+        OP(0x82): // ADD D
+            add(state, &state->a, state->d, 0);
+            NEXT;
+        OP(0x83): // ADD E
+            add(state, &state->a, state->e, 0);
+            NEXT;
+        OP(0x84): // ADD H
+            add(state, &state->a, state->h, 0);
+            NEXT;
+        OP(0x85): // ADD L
+            add(state, &state->a, state->l, 0);
+            NEXT;
+        OP(0x86): // ADD M
+            add(state, &state->a, read_from_m(state), 0);
+            NEXT;
+        OP(0x87): // ADD A
+            add(state, &state->a, state->a, 0);
+            NEXT;
+        OP(0x88): // ADC B
+            add(state, &state->a, state->b, flag_cy(state));
+            NEXT;
+        OP(0x89): // ADC C
+            add(state, &state->a, state->c, flag_cy(state));
+            NEXT;
+        OP(0x8a): // ADC D
+            add(state, &state->a, state->d, flag_cy(state));
+            NEXT;
+        OP(0x8b): // ADC E
+            add(state, &state->a, state->e, flag_cy(state));
+            NEXT;
+        OP(0x8c): // ADC H
+            add(state, &state->a, state->h, flag_cy(state));
+            NEXT;
+        OP(0x8d): // ADC L
+            add(state, &state->a, state->l, flag_cy(state));
+            NEXT;
+        OP(0x8e): // ADC M
+            add(state, &state->a, read_from_m(state), flag_cy(state));
+            NEXT;
+        OP(0x8f): // ADC A
+            add(state, &state->a, state->a, flag_cy(state));
+            NEXT;
+        OP(0x90): // SUB B
+            substract(state, &state->a, state->b, 0);
+            NEXT;
+        OP(0x91): // SUB C
+            substract(state, &state->a, state->c, 0);
+            NEXT;
+        OP(0x92): // SUB D
+            substract(state, &state->a, state->d, 0);
+            NEXT;
+        OP(0x93): // SUB E
+            substract(state, &state->a, state->e, 0);
+            NEXT;
+        OP(0x94): // SUB H
+            substract(state, &state->a, state->h, 0);
+            NEXT;
+        OP(0x95): // SUB L
+            substract(state, &state->a, state->l, 0);
+            NEXT;
+        OP(0x96): // SUB M
+            substract(state, &state->a, read_from_m(state), 0);
+            NEXT;
+        OP(0x97): // SUB A
+            substract(state, &state->a, state->a, 0);
+            NEXT;
+        OP(0x98): // SBB B
+            substract(state, &state->a, state->b, flag_cy(state));
+            NEXT;
+        OP(0x99): // SBB C
+            substract(state, &state->a, state->c, flag_cy(state));
+            NEXT;
+        OP(0x9a): // SBB D
+            substract(state, &state->a, state->d, flag_cy(state));
+            NEXT;
+        OP(0x9b): // SBB E
+            substract(state, &state->a, state->e, flag_cy(state));
+            NEXT;
+        OP(0x9c): // SBB H
+            substract(state, &state->a, state->h, flag_cy(state));
+            NEXT;
+        OP(0x9d): // SBB L
+            substract(state, &state->a, state->l, flag_cy(state));
+            NEXT;
+        OP(0x9e): // SBB M
+            substract(state, &state->a, read_from_m(state), flag_cy(state));
+            NEXT;
+        OP(0x9f): // SBB A
+            substract(state, &state->a, state->a, flag_cy(state));
+            NEXT;
+        OP(0xa0): // ANA B
+            ana(state, state->b);
+            NEXT;
+        OP(0xa1): // ANA C
+            ana(state, state->c);
+            NEXT;
+        OP(0xa2): // ANA D
+            ana(state, state->d);
+            NEXT;
+        OP(0xa3): // ANA E
+            ana(state, state->e);
+            NEXT;
+        OP(0xa4): // ANA H
+            ana(state, state->h);
+            NEXT;
+        OP(0xa5): // ANA L
+            ana(state, state->l);
+            NEXT;
+        OP(0xa6): // ANA M
+            ana(state, read_from_m(state));
+            NEXT;
+        OP(0xa7): // ANA A
+            ana(state, state->a);
+            NEXT;
+        OP(0xa8): // XRA B
+            xra(state, state->b);
+            NEXT;
+        OP(0xa9): // XRA C
+            xra(state, state->c);
+            NEXT;
+        OP(0xaa): // XRA D
+            xra(state, state->d);
+            NEXT;
+        OP(0xab): // XRA E
+            xra(state, state->e);
+            NEXT;
+        OP(0xac): // XRA H
+            xra(state, state->h);
+            NEXT;
+        OP(0xad): // XRA L
+            xra(state, state->l);
+            NEXT;
+        OP(0xae): // XRA M
+            xra(state, read_from_m(state));
+            NEXT;
+        OP(0xaf): // XRA A
+            xra(state, state->a);
+            NEXT;
+        OP(0xb0): // ORA B
+            ora(state, state->b);
+            NEXT;
+        OP(0xb1): // ORA C
+            ora(state, state->c);
+            NEXT;
+        OP(0xb2): // ORA D
+            ora(state, state->d);
+            NEXT;
+        OP(0xb3): // ORA E
+            ora(state, state->e);
+            NEXT;
+        OP(0xb4): // ORA H
+            ora(state, state->h);
+            NEXT;
+        OP(0xb5): // ORA L
+            ora(state, state->l);
+            NEXT;
+        OP(0xb6): // ORA M
+            ora(state, read_from_m(state));
+            NEXT;
+        OP(0xb7): // ORA A
+            ora(state, state->a);
+            NEXT;
+        OP(0xb8): // CMP B
+            cmp(state, state->b);
+            NEXT;
+        OP(0xb9): // CMP C
+            cmp(state, state->c);
+            NEXT;
+        OP(0xba): // CMP D
+            cmp(state, state->d);
+            NEXT;
+        OP(0xbb): // CMP E
+            cmp(state, state->e);
+            NEXT;
+        OP(0xbc): // CMP H
+            cmp(state, state->h);
+            NEXT;
+        OP(0xbd): // CMP L
+            cmp(state, state->l);
+            NEXT;
+        OP(0xbe): // CMP M
+            cmp(state, read_from_m(state));
+            NEXT;
+        OP(0xbf): // CMP A
+            cmp(state, state->a);
+            NEXT;
+        OP(0xc0): // RNZ
+            if (!flag_z(state))
+            {
+                TAKEN(0xc0);
+                ret(state);
+            }
+            NEXT;
+        OP(0xc1): // POP B
+            pop(state, &state->b, &state->c);
+            NEXT;
+        OP(0xc2): // JNZ Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, !flag_z(state));
+            SKIP_IDLE(address);
+            RUN_IDIOM(address);
+            NEXT;
+        }
+        OP(0xc3): // JMP Address
+        {
+            uint16_t address = IMM16;
+            state->pc = address;
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xc4): // CNZ Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, !flag_z(state)))
+            {
+                TAKEN(0xc4);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xc5): // push B
+            push(state, state->b, state->c);
+            NEXT;
+        OP(0xc6): // ADI Byte
+            add(state, &state->a, IMM8, 0);
+            state->pc++;
+            NEXT;
+        OP(0xc7): // RST 0
+            call(state, state->pc, 0x0000);
+            NEXT;
+        OP(0xc8): // RZ
+            if (flag_z(state))
+            {
+                TAKEN(0xc8);
+                ret(state);
+            }
+            NEXT;
+        OP(0xc9): // RET
+            ret(state);
+            NEXT;
+        OP(0xca): // JZ Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, flag_z(state));
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xcb): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0xcc): // CZ Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, flag_z(state)))
+            {
+                TAKEN(0xcc);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xcd): // call Address
+        {
+            uint16_t address = IMM16;
+            call(state, state->pc + 2, address);
+            RUN_HOOK;
+            NEXT;
+        }
+        OP(0xce): // ACI Byte
+            add(state, &state->a, IMM8, flag_cy(state));
+            state->pc++;
+            NEXT;
+        OP(0xcf): // RST 1
+            call(state, state->pc, 0x0008);
+            NEXT;
+        OP(0xd0): // RNC
+            if (!flag_cy(state))
+            {
+                TAKEN(0xd0);
+                ret(state);
+            }
+            NEXT;
+        OP(0xd1): // POP D
+            pop(state, &state->d, &state->e);
+            NEXT;
+        OP(0xd2): // JNC Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, !flag_cy(state));
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xd3): // OUT Byte
+            state->pc++;
+            BUS_SYNC;
+            bus_out_8080(state, IMM8, state->a);
+#ifdef SUPERINSTRUCTIONS
+            // A port access right after OUT, how the shift register gets
+            // driven. This OUT's cycles are counted first, NEXT counts
+            // the second one's, which costs the same.
+            if (!INSTRUMENTED && (state->memory[state->pc] & 0xf7) == 0xd3 &&
+                fits(cycle_budget - (state->cycle_count - start), 20, 10))
+            {
+                uint8_t port = state->memory[(uint16_t)(state->pc + 1)];
+                bool input = state->memory[state->pc] == 0xdb;
+                state->cycle_count += CYCLES;
+                state->pc += 2;
+                state->fused_dispatches++;
+                BUS_SYNC;
+                if (input)
+                {
+                    state->a = bus_in_8080(state, port);
+                }
+                else
+                {
+                    bus_out_8080(state, port, state->a);
+                }
+            }
+#endif
+            NEXT;
+        OP(0xd4): // CNC Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, !flag_cy(state)))
+            {
+                TAKEN(0xd4);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xd5): // push D
+            push(state, state->d, state->e);
+            NEXT;
+        OP(0xd6): // SUI Byte
+            substract(state, &state->a, IMM8, 0);
+            state->pc++;
+            NEXT;
+        OP(0xd7): // RST 2
+            call(state, state->pc, 0x0010);
+            NEXT;
+        OP(0xd8): // RC
+            if (flag_cy(state))
+            {
+                TAKEN(0xd8);
+                ret(state);
+            }
+            NEXT;
+        OP(0xd9): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0xda): // JC Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, flag_cy(state));
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xdb): // IN Byte
+            state->pc++;
+            BUS_SYNC;
+            state->a = bus_in_8080(state, IMM8);
+            NEXT;
+        OP(0xdc): // CC Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, flag_cy(state)))
+            {
+                TAKEN(0xdc);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xdd): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0xde): // SBI Byte
+            substract(state, &state->a, IMM8, flag_cy(state));
+            state->pc++;
+            NEXT;
+        OP(0xdf): // RST 3
+            call(state, state->pc, 0x0018);
+            NEXT;
+        OP(0xe0): // RPO
+            if (!flag_p(state))
+            {
+                TAKEN(0xe0);
+                ret(state);
+            }
+            NEXT;
+        OP(0xe1): // POP H
+            pop(state, &state->h, &state->l);
+            NEXT;
+        OP(0xe2): // JPO Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, !flag_p(state));
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xe3): // XThl
+        {
+            uint8_t l = state->l;
+            uint8_t h = state->h;
+            state->l = read_8080(state, state->sp);
+            state->h = read_8080(state, state->sp + 1);
+            write_mem(state, state->sp, l);
+            write_mem(state, state->sp + 1, h);
+            NEXT;
+        }
+        OP(0xe4): // CPO Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, !flag_p(state)))
+            {
+                TAKEN(0xe4);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xe5): // push H
+            push(state, state->h, state->l);
+            NEXT;
+        OP(0xe6): // ANI Byte
+            ana(state, IMM8);
+            state->pc++;
+            NEXT;
+        OP(0xe7): // RST 4
+            call(state, state->pc, 0x0020);
+            NEXT;
+        OP(0xe8): // RPE
+            if (flag_p(state))
+            {
+                TAKEN(0xe8);
+                ret(state);
+            }
+            NEXT;
+        OP(0xe9): // PChl
+            state->pc = get_hl(state);
+            NEXT;
+        OP(0xea): // JPE Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, flag_p(state));
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xeb): // XCHG
+        {
+            uint16_t de = get_de(state);
+            set_de(state, get_hl(state));
+            set_hl(state, de);
+            NEXT;
+        }
+        OP(0xec): // CPE Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, flag_p(state)))
+            {
+                TAKEN(0xec);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xed): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0xee): // XRI Byte
+            xra(state, IMM8);
+            state->pc++;
+            NEXT;
+        OP(0xef): // RST 5
+            call(state, state->pc, 0x0028);
+            NEXT;
+        OP(0xf0): // RP
+            if (!flag_s(state))
+            {
+                TAKEN(0xf0);
+                ret(state);
+            }
+            NEXT;
+        OP(0xf1): // POP PSW
+        {
+            uint8_t a = read_8080(state, state->sp + 1);
+            uint8_t psw = read_8080(state, state->sp);
+            state->sp += 2;
+            state->a = a;
+
+            set_psw(state, psw);
+            NEXT;
+        }
+        OP(0xf2): // JP Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, !flag_s(state));
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xf3): // DI
+            state->int_enable = 0;
+            NEXT;
+        OP(0xf4): // CP Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, !flag_s(state)))
+            {
+                TAKEN(0xf4);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xf5): // push PSW
+        {
+            uint8_t psw = get_psw(state);
+            write_mem(state, state->sp - 1, state->a);
+            write_mem(state, state->sp - 2, psw);
+            state->sp -= 2;
+            NEXT;
+        }
+        OP(0xf6): // ORI Byte
+            ora(state, IMM8);
+            state->pc++;
+            NEXT;
+        OP(0xf7): // RST 6
+            call(state, state->pc, 0x0030);
+            NEXT;
+        OP(0xf8): // RM
+            if (flag_s(state))
+            {
+                TAKEN(0xf8);
+                ret(state);
+            }
+            NEXT;
+        OP(0xf9): // SPhl
+            state->sp = get_hl(state);
+            NEXT;
+        OP(0xfa): // JM Address
+        {
+            uint16_t address = IMM16;
+            cond_jump(state, address, flag_s(state));
+            SKIP_IDLE(address);
+            NEXT;
+        }
+        OP(0xfb): // EI
+            state->int_enable = 1;
+            if (state->held_interrupt != 0)
+            {
+                // Ends the slice after the next instruction, see `done`.
+                cycle_budget = state->cycle_count - start + CYCLES + 1;
+            }
+            NEXT;
+        OP(0xfc): // CM Address
+        {
+            uint16_t address = IMM16;
+            if (cond_call(state, address, flag_s(state)))
+            {
+                TAKEN(0xfc);
+                RUN_HOOK;
+            }
+            NEXT;
+        }
+        OP(0xfd): // Unused
+            unimplemented_instruction(state);
+            NEXT;
+        OP(0xfe): // CPI Byte
+        {
+            cmp(state, IMM8);
+            state->pc++;
+            NEXT;
+        }
+        OP(0xff): // RST 7
+            call(state, state->pc, 0x0038);
+            NEXT;
+#ifdef FLAG_LIVENESS
+        OP(0x104): // INR B, flags dead
+            FLAGS_DEAD;
+            state->b++;
+            NEXT;
+        OP(0x105): // DCR B, flags dead
+            FLAGS_DEAD;
+            state->b--;
+            NEXT;
+        OP(0x10c): // INR C, flags dead
+            FLAGS_DEAD;
+            state->c++;
+            NEXT;
+        OP(0x10d): // DCR C, flags dead
+            FLAGS_DEAD;
+            state->c--;
+            NEXT;
+        OP(0x114): // INR D, flags dead
+            FLAGS_DEAD;
+            state->d++;
+            NEXT;
+        OP(0x115): // DCR D, flags dead
+            FLAGS_DEAD;
+            state->d--;
+            NEXT;
+        OP(0x11c): // INR E, flags dead
+            FLAGS_DEAD;
+            state->e++;
+            NEXT;
+        OP(0x11d): // DCR E, flags dead
+            FLAGS_DEAD;
+            state->e--;
+            NEXT;
+        OP(0x124): // INR H, flags dead
+            FLAGS_DEAD;
+            state->h++;
+            NEXT;
+        OP(0x125): // DCR H, flags dead
+            FLAGS_DEAD;
+            state->h--;
+            NEXT;
+        OP(0x12c): // INR L, flags dead
+            FLAGS_DEAD;
+            state->l++;
+            NEXT;
+        OP(0x12d): // DCR L, flags dead
+            FLAGS_DEAD;
+            state->l--;
+            NEXT;
+        OP(0x134): // INR M, flags dead
+            FLAGS_DEAD;
+            write_to_m(state, read_from_m(state) + 1);
+            NEXT;
+        OP(0x135): // DCR M, flags dead
+            FLAGS_DEAD;
+            write_to_m(state, read_from_m(state) - 1);
+            NEXT;
+        OP(0x13c): // INR A, flags dead
+            FLAGS_DEAD;
+            state->a++;
+            NEXT;
+        OP(0x13d): // DCR A, flags dead
+            FLAGS_DEAD;
+            state->a--;
+            NEXT;
+        OP(0x180): // ADD B, flags dead
+            FLAGS_DEAD;
+            state->a += state->b;
+            NEXT;
+        OP(0x181): // ADD C, flags dead
+            FLAGS_DEAD;
+            state->a += state->c;
+            NEXT;
+        OP(0x182): // ADD D, flags dead
+            FLAGS_DEAD;
+            state->a += state->d;
+            NEXT;
+        OP(0x183): // ADD E, flags dead
+            FLAGS_DEAD;
+            state->a += state->e;
+            NEXT;
+        OP(0x184): // ADD H, flags dead
+            FLAGS_DEAD;
+            state->a += state->h;
+            NEXT;
+        OP(0x185): // ADD L, flags dead
+            FLAGS_DEAD;
+            state->a += state->l;
+            NEXT;
+        OP(0x186): // ADD M, flags dead
+            FLAGS_DEAD;
+            state->a += read_from_m(state);
+            NEXT;
+        OP(0x187): // ADD A, flags dead
+            FLAGS_DEAD;
+            state->a += state->a;
+            NEXT;
+        OP(0x188): // ADC B, flags dead
+            FLAGS_DEAD;
+            state->a += state->b + flag_cy(state);
+            NEXT;
+        OP(0x189): // ADC C, flags dead
+            FLAGS_DEAD;
+            state->a += state->c + flag_cy(state);
+            NEXT;
+        OP(0x18a): // ADC D, flags dead
+            FLAGS_DEAD;
+            state->a += state->d + flag_cy(state);
+            NEXT;
+        OP(0x18b): // ADC E, flags dead
+            FLAGS_DEAD;
+            state->a += state->e + flag_cy(state);
+            NEXT;
+        OP(0x18c): // ADC H, flags dead
+            FLAGS_DEAD;
+            state->a += state->h + flag_cy(state);
+            NEXT;
+        OP(0x18d): // ADC L, flags dead
+            FLAGS_DEAD;
+            state->a += state->l + flag_cy(state);
+            NEXT;
+        OP(0x18e): // ADC M, flags dead
+            FLAGS_DEAD;
+            state->a += read_from_m(state) + flag_cy(state);
+            NEXT;
+        OP(0x18f): // ADC A, flags dead
+            FLAGS_DEAD;
+            state->a += state->a + flag_cy(state);
+            NEXT;
+        OP(0x190): // SUB B, flags dead
+            FLAGS_DEAD;
+            state->a -= state->b;
+            NEXT;
+        OP(0x191): // SUB C, flags dead
+            FLAGS_DEAD;
+            state->a -= state->c;
+            NEXT;
+        OP(0x192): // SUB D, flags dead
+            FLAGS_DEAD;
+            state->a -= state->d;
+            NEXT;
+        OP(0x193): // SUB E, flags dead
+            FLAGS_DEAD;
+            state->a -= state->e;
+            NEXT;
+        OP(0x194): // SUB H, flags dead
+            FLAGS_DEAD;
+            state->a -= state->h;
+            NEXT;
+        OP(0x195): // SUB L, flags dead
+            FLAGS_DEAD;
+            state->a -= state->l;
+            NEXT;
+        OP(0x196): // SUB M, flags dead
+            FLAGS_DEAD;
+            state->a -= read_from_m(state);
+            NEXT;
+        OP(0x197): // SUB A, flags dead
+            FLAGS_DEAD;
+            state->a -= state->a;
+            NEXT;
+        OP(0x198): // SBB B, flags dead
+            FLAGS_DEAD;
+            state->a -= state->b + flag_cy(state);
+            NEXT;
+        OP(0x199): // SBB C, flags dead
+            FLAGS_DEAD;
+            state->a -= state->c + flag_cy(state);
+            NEXT;
+        OP(0x19a): // SBB D, flags dead
+            FLAGS_DEAD;
+            state->a -= state->d + flag_cy(state);
+            NEXT;
+        OP(0x19b): // SBB E, flags dead
+            FLAGS_DEAD;
+            state->a -= state->e + flag_cy(state);
+            NEXT;
+        OP(0x19c): // SBB H, flags dead
+            FLAGS_DEAD;
+            state->a -= state->h + flag_cy(state);
+            NEXT;
+        OP(0x19d): // SBB L, flags dead
+            FLAGS_DEAD;
+            state->a -= state->l + flag_cy(state);
+            NEXT;
+        OP(0x19e): // SBB M, flags dead
+            FLAGS_DEAD;
+            state->a -= read_from_m(state) + flag_cy(state);
+            NEXT;
+        OP(0x19f): // SBB A, flags dead
+            FLAGS_DEAD;
+            state->a -= state->a + flag_cy(state);
+            NEXT;
+        OP(0x1a0): // ANA B, flags dead
+            FLAGS_DEAD;
+            state->a &= state->b;
+            NEXT;
+        OP(0x1a1): // ANA C, flags dead
+            FLAGS_DEAD;
+            state->a &= state->c;
+            NEXT;
+        OP(0x1a2): // ANA D, flags dead
+            FLAGS_DEAD;
+            state->a &= state->d;
+            NEXT;
+        OP(0x1a3): // ANA E, flags dead
+            FLAGS_DEAD;
+            state->a &= state->e;
+            NEXT;
+        OP(0x1a4): // ANA H, flags dead
+            FLAGS_DEAD;
+            state->a &= state->h;
+            NEXT;
+        OP(0x1a5): // ANA L, flags dead
+            FLAGS_DEAD;
+            state->a &= state->l;
+            NEXT;
+        OP(0x1a6): // ANA M, flags dead
+            FLAGS_DEAD;
+            state->a &= read_from_m(state);
+            NEXT;
+        OP(0x1a7): // ANA A, flags dead
+            FLAGS_DEAD;
+            state->a &= state->a;
+            NEXT;
+        OP(0x1a8): // XRA B, flags dead
+            FLAGS_DEAD;
+            state->a ^= state->b;
+            NEXT;
+        OP(0x1a9): // XRA C, flags dead
+            FLAGS_DEAD;
+            state->a ^= state->c;
+            NEXT;
+        OP(0x1aa): // XRA D, flags dead
+            FLAGS_DEAD;
+            state->a ^= state->d;
+            NEXT;
+        OP(0x1ab): // XRA E, flags dead
+            FLAGS_DEAD;
+            state->a ^= state->e;
+            NEXT;
+        OP(0x1ac): // XRA H, flags dead
+            FLAGS_DEAD;
+            state->a ^= state->h;
+            NEXT;
+        OP(0x1ad): // XRA L, flags dead
+            FLAGS_DEAD;
+            state->a ^= state->l;
+            NEXT;
+        OP(0x1ae): // XRA M, flags dead
+            FLAGS_DEAD;
+            state->a ^= read_from_m(state);
+            NEXT;
+        OP(0x1af): // XRA A, flags dead
+            FLAGS_DEAD;
+            state->a ^= state->a;
+            NEXT;
+        OP(0x1b0): // ORA B, flags dead
+            FLAGS_DEAD;
+            state->a |= state->b;
+            NEXT;
+        OP(0x1b1): // ORA C, flags dead
+            FLAGS_DEAD;
+            state->a |= state->c;
+            NEXT;
+        OP(0x1b2): // ORA D, flags dead
+            FLAGS_DEAD;
+            state->a |= state->d;
+            NEXT;
+        OP(0x1b3): // ORA E, flags dead
+            FLAGS_DEAD;
+            state->a |= state->e;
+            NEXT;
+        OP(0x1b4): // ORA H, flags dead
+            FLAGS_DEAD;
+            state->a |= state->h;
+            NEXT;
+        OP(0x1b5): // ORA L, flags dead
+            FLAGS_DEAD;
+            state->a |= state->l;
+            NEXT;
+        OP(0x1b6): // ORA M, flags dead
+            FLAGS_DEAD;
+            state->a |= read_from_m(state);
+            NEXT;
+        OP(0x1b7): // ORA A, flags dead
+            FLAGS_DEAD;
+            state->a |= state->a;
+            NEXT;
+        OP(0x1b8): // CMP B, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1b9): // CMP C, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1ba): // CMP D, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1bb): // CMP E, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1bc): // CMP H, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1bd): // CMP L, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1be): // CMP M, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1bf): // CMP A, flags dead
+            FLAGS_DEAD;
+            NEXT;
+        OP(0x1c6): // ADI Byte, flags dead
+            FLAGS_DEAD;
+            state->a += IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x1ce): // ACI Byte, flags dead
+            FLAGS_DEAD;
+            state->a += IMM8 + flag_cy(state);
+            state->pc++;
+            NEXT;
+        OP(0x1d6): // SUI Byte, flags dead
+            FLAGS_DEAD;
+            state->a -= IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x1de): // SBI Byte, flags dead
+            FLAGS_DEAD;
+            state->a -= IMM8 + flag_cy(state);
+            state->pc++;
+            NEXT;
+        OP(0x1e6): // ANI Byte, flags dead
+            FLAGS_DEAD;
+            state->a &= IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x1ee): // XRI Byte, flags dead
+            FLAGS_DEAD;
+            state->a ^= IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x1f6): // ORI Byte, flags dead
+            FLAGS_DEAD;
+            state->a |= IMM8;
+            state->pc++;
+            NEXT;
+        OP(0x1fe): // CPI Byte, flags dead
+            FLAGS_DEAD;
+            state->pc++;
+            NEXT;
+#endif
+        }
+
+        // Only the switch engine gets here, threaded handlers retire
+        // themselves in NEXT.
+        state->cycle_count += CYCLES;
+        if (state->cycle_count - start >= cycle_budget)
+        {
+            goto done;
+        }
+    }
+
+done:
+    SAVE_REGS;
+    take_held_interrupt_8080(cpu);
+    return state->cycle_count - start;
+}
+
+#undef SAVE_REGS
+#undef LOAD_REGS
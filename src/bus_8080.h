@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+#include "8080.h"
+
+// The bus the core stores and does I/O through. By default it calls the
+// State8080 callbacks, so any machine can plug in at run time. Building the
+// core with BUS_INVADERS, BUS_CPM or BUS_NULL ties it to one machine
+// instead, and its handlers inline into the opcode handlers. The callbacks
+// must still be set to the same handlers: the JIT, the HLE hooks and the
+// tools always call through them.
+//
+// BUS_SEES_REGISTERS says whether the port handlers look at the CPU
+// registers, which the core then writes back before each IN and OUT.
+
+#if defined(BUS_INVADERS)
+#include "machine_bus.h"
+
+#define BUS_SEES_REGISTERS 0
+
+static inline void bus_write_8080(State8080 *state, uint16_t address, uint8_t value)
+{
+    machine_bus_write(state->user_data, address, value);
+}
+
+static inline uint8_t bus_in_8080(State8080 *state, uint8_t port)
+{
+    return machine_bus_in(state->user_data, port);
+}
+
+static inline void bus_out_8080(State8080 *state, uint8_t port, uint8_t value)
+{
+    machine_bus_out(state->user_data, port, value);
+}
+
+#elif defined(BUS_CPM)
+#include "../test/cpm_bus.h"
+
+#define BUS_SEES_REGISTERS 1
+
+static inline void bus_write_8080(State8080 *state, uint16_t address, uint8_t value)
+{
+    cpm_bus_write(state->user_data, address, value);
+}
+
+static inline uint8_t bus_in_8080(State8080 *state, uint8_t port)
+{
+    return cpm_bus_in(state->user_data, port);
+}
+
+static inline void bus_out_8080(State8080 *state, uint8_t port, uint8_t value)
+{
+    cpm_bus_out(state->user_data, port, value);
+}
+
+#elif defined(BUS_NULL)
+// Plain RAM and no devices, for benchmarks: IN reads 0 and OUT is dropped.
+// `user_data` is the CPU.
+
+#define BUS_SEES_REGISTERS 0
+
+static inline void bus_write_8080(State8080 *state, uint16_t address, uint8_t value)
+{
+    State8080 *cpu = state->user_data;
+    cpu->memory[address] = value;
+    invalidate_8080_decoded(cpu, address);
+}
+
+static inline uint8_t bus_in_8080(State8080 *state, uint8_t port)
+{
+    (void)state;
+    (void)port;
+    return 0x00;
+}
+
+static inline void bus_out_8080(State8080 *state, uint8_t port, uint8_t value)
+{
+    (void)state;
+    (void)port;
+    (void)value;
+}
+
+#else
+
+#define BUS_SEES_REGISTERS 1
+
+static inline void bus_write_8080(State8080 *state, uint16_t address, uint8_t value)
+{
+    state->write_byte(state->user_data, address, value);
+}
+
+static inline uint8_t bus_in_8080(State8080 *state, uint8_t port)
+{
+    return state->port_input(state->user_data, port);
+}
+
+static inline void bus_out_8080(State8080 *state, uint8_t port, uint8_t value)
+{
+    state->port_output(state->user_data, port, value);
+}
+
+#endif
@@ -0,0 +1,448 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include "hle.h"
+
+#define PSW_S 0x80
+#define PSW_Z 0x40
+#define PSW_AC 0x10
+#define PSW_P 0x04
+#define PSW_CY 0x01
+
+#define RAM_START 0x2000
+#define RAM_SIZE 0x2000
+
+// A native routine in progress: the cycles it used out of what's left of
+// the slice, and the flags, written back when it stops.
+typedef struct Run
+{
+    State8080 *state;
+    uint32_t left, used;
+    uint8_t psw;
+} Run;
+
+typedef struct Routine
+{
+    const char *name;
+    uint16_t entry;
+    // The guest code the native version follows, from `entry` on.
+    const uint8_t *code;
+    uint16_t code_size;
+    Hook8080 run;
+} Routine;
+
+static Run start_run(State8080 *state, uint32_t left)
+{
+    Run run = {state, left, 0, get_psw_8080(state)};
+    return run;
+}
+
+static void finish_run(Run *run)
+{
+    set_psw_8080(run->state, run->psw);
+}
+
+// Whether a chunk of `opcodes` would retire entirely before the
+// interpreter ends the slice, i.e. before its last instruction.
+static bool fits(const Run *run, const uint8_t *opcodes, size_t count)
+{
+    uint32_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        total += cycles8080[opcodes[i]];
+    }
+    return run->used + total - cycles8080[opcodes[count - 1]] < run->left;
+}
+
+static void spend(Run *run, const uint8_t *opcodes, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        run->used += cycles8080[opcodes[i]];
+        run->state->cycle_count += cycles8080[opcodes[i]];
+    }
+}
+
+#define FITS(run, opcodes) fits(run, opcodes, sizeof(opcodes))
+#define SPEND(run, opcodes) spend(run, opcodes, sizeof(opcodes))
+
+static uint8_t zsp(uint8_t value)
+{
+    bool even = !__builtin_parity(value);
+    return (value & PSW_S) | (value == 0 ? PSW_Z : 0) | (even ? PSW_P : 0) | 0x02;
+}
+
+// Flags of ORA and XRA.
+static uint8_t logic(uint8_t result)
+{
+    return zsp(result);
+}
+
+static uint8_t dcr(uint8_t psw, uint8_t result)
+{
+    return zsp(result) | ((result & 0xf) != 0xf ? PSW_AC : 0) | (psw & PSW_CY);
+}
+
+static uint8_t cmp(uint8_t a, uint8_t value)
+{
+    uint16_t result = a - value;
+    return zsp(result & 0xff) | (~(a ^ result ^ value) & PSW_AC) | ((result >> 8) & PSW_CY);
+}
+
+static uint16_t get_hl(State8080 *state)
+{
+    return (state->h << 8) | state->l;
+}
+
+static void set_hl(State8080 *state, uint16_t value)
+{
+    state->h = value >> 8;
+    state->l = value & 0xff;
+}
+
+static uint16_t get_de(State8080 *state)
+{
+    return (state->d << 8) | state->e;
+}
+
+static void set_de(State8080 *state, uint16_t value)
+{
+    state->d = value >> 8;
+    state->e = value & 0xff;
+}
+
+static void push(State8080 *state, uint8_t high, uint8_t low)
+{
+    write_8080(state, state->sp - 1, high);
+    write_8080(state, state->sp - 2, low);
+    state->sp -= 2;
+}
+
+static void pop(State8080 *state, uint8_t *high, uint8_t *low)
+{
+    *low = read_8080(state, state->sp);
+    *high = read_8080(state, state->sp + 1);
+    state->sp += 2;
+}
+
+static bool ret(Run *run)
+{
+    static const uint8_t opcodes[] = {0xc9};
+    if (!FITS(run, opcodes))
+    {
+        return false;
+    }
+    State8080 *state = run->state;
+    state->pc = read_8080(state, state->sp) | (read_8080(state, state->sp + 1) << 8);
+    state->sp += 2;
+    SPEND(run, opcodes);
+    return true;
+}
+
+// Runs guest code on the interpreter until `pc` gets to `until`, the way
+// the interpreter would within the slice.
+static bool step_until(Run *run, uint16_t until)
+{
+    State8080 *state = run->state;
+    set_psw_8080(state, run->psw);
+    while (state->pc != until && run->used < run->left)
+    {
+        uint32_t before = state->cycle_count;
+        emulate_8080_op(state);
+        run->used += state->cycle_count - before;
+    }
+    run->psw = get_psw_8080(state);
+    return state->pc == until;
+}
+
+// BlockCopy: copies B bytes from DE to HL.
+static const uint8_t block_copy_code[] = {
+    0x1a, 0x77, 0x23, 0x13, 0x05, 0xc2, 0x32, 0x1a, // LDAX D; MOV M,A; INX H; INX D; DCR B; JNZ 1A32
+    0xc9,                                           // RET
+};
+
+static void block_copy(State8080 *state, uint32_t left)
+{
+    static const uint8_t loop[] = {0x1a, 0x77, 0x23, 0x13, 0x05, 0xc2};
+    Run run = start_run(state, left);
+    while (state->pc == 0x1a32 && FITS(&run, loop))
+    {
+        state->a = read_8080(state, get_de(state));
+        write_8080(state, get_hl(state), state->a);
+        set_hl(state, get_hl(state) + 1);
+        set_de(state, get_de(state) + 1);
+        state->b--;
+        run.psw = dcr(run.psw, state->b);
+        state->pc = state->b != 0 ? 0x1a32 : 0x1a3a;
+        SPEND(&run, loop);
+    }
+    if (state->pc == 0x1a3a)
+    {
+        ret(&run);
+    }
+    finish_run(&run);
+}
+
+// ClearScreen: zeroes the video RAM, 2400 to 3FFF.
+static const uint8_t clear_screen_code[] = {
+    0x21, 0x00, 0x24,                                     // LXI H,2400
+    0x36, 0x00, 0x23, 0x7c, 0xfe, 0x40, 0xc2, 0x5f, 0x1a, // MVI M,0; INX H; MOV A,H; CPI 40; JNZ 1A5F
+    0xc9,                                                 // RET
+};
+
+static void clear_screen(State8080 *state, uint32_t left)
+{
+    static const uint8_t start[] = {0x21};
+    static const uint8_t loop[] = {0x36, 0x23, 0x7c, 0xfe, 0xc2};
+    Run run = start_run(state, left);
+    if (state->pc == 0x1a5c && FITS(&run, start))
+    {
+        set_hl(state, 0x2400);
+        state->pc = 0x1a5f;
+        SPEND(&run, start);
+    }
+    while (state->pc == 0x1a5f && FITS(&run, loop))
+    {
+        write_8080(state, get_hl(state), 0x00);
+        set_hl(state, get_hl(state) + 1);
+        state->a = state->h;
+        run.psw = cmp(state->a, 0x40);
+        state->pc = state->a != 0x40 ? 0x1a5f : 0x1a68;
+        SPEND(&run, loop);
+    }
+    if (state->pc == 0x1a68)
+    {
+        ret(&run);
+    }
+    finish_run(&run);
+}
+
+// The rows of both sprite routines: save B and HL, work on one row, then
+// HL += 32 for the next one and count B down.
+static void next_row(Run *run, uint16_t loop, uint16_t end)
+{
+    State8080 *state = run->state;
+    pop(state, &state->h, &state->l);
+    state->b = 0x00;
+    state->c = 0x20;
+    uint32_t sum = get_hl(state) + 0x20;
+    run->psw = (run->psw & ~PSW_CY) | (sum >> 16);
+    set_hl(state, sum);
+    pop(state, &state->b, &state->c);
+    state->b--;
+    run->psw = dcr(run->psw, state->b);
+    state->pc = state->b != 0 ? loop : end;
+}
+
+// Shifts one byte through the shift register and ORs it onto the screen.
+static void draw_byte(State8080 *state, uint8_t *psw)
+{
+    state->port_output(state->user_data, 4, state->a);
+    state->a = state->port_input(state->user_data, 3);
+    state->a |= read_8080(state, get_hl(state));
+    *psw = logic(state->a);
+    write_8080(state, get_hl(state), state->a);
+}
+
+// DrawShiftedSprite: draws B rows of two bytes from DE at the pixel
+// position HL, shifted through the shift register. CnvtPixNumber runs on
+// the interpreter.
+static const uint8_t draw_shifted_sprite_code[] = {
+    0x00, 0xcd, 0x74, 0x14, 0x00, // NOP; CALL CnvtPixNumber; NOP
+    0xc5, 0xe5,                   // PUSH B; PUSH H
+    0x1a, 0xd3, 0x04, 0xdb, 0x03, // LDAX D; OUT 4; IN 3
+    0xb6, 0x77, 0x23, 0x13,       // ORA M; MOV M,A; INX H; INX D
+    0xaf, 0xd3, 0x04, 0xdb, 0x03, // XRA A; OUT 4; IN 3
+    0xb6, 0x77,                   // ORA M; MOV M,A
+    0xe1, 0x01, 0x20, 0x00, 0x09, // POP H; LXI B,0020; DAD B
+    0xc1, 0x05, 0xc2, 0x05, 0x14, // POP B; DCR B; JNZ 1405
+    0xc9,                         // RET
+};
+
+static void draw_shifted_sprite(State8080 *state, uint32_t left)
+{
+    static const uint8_t row[] = {0xc5, 0xe5, 0x1a, 0xd3, 0xdb, 0xb6, 0x77, 0x23, 0x13, 0xaf,
+                                  0xd3, 0xdb, 0xb6, 0x77, 0xe1, 0x01, 0x09, 0xc1, 0x05, 0xc2};
+    Run run = start_run(state, left);
+    step_until(&run, 0x1405);
+    while (state->pc == 0x1405 && FITS(&run, row))
+    {
+        push(state, state->b, state->c);
+        push(state, state->h, state->l);
+        state->a = read_8080(state, get_de(state));
+        draw_byte(state, &run.psw);
+        set_hl(state, get_hl(state) + 1);
+        set_de(state, get_de(state) + 1);
+        state->a = 0;
+        draw_byte(state, &run.psw);
+        next_row(&run, 0x1405, 0x1421);
+        SPEND(&run, row);
+    }
+    if (state->pc == 0x1421)
+    {
+        ret(&run);
+    }
+    finish_run(&run);
+}
+
+// EraseSimpleSprite: clears B rows of two bytes at the pixel position HL.
+static const uint8_t erase_simple_sprite_code[] = {
+    0xcd, 0x74, 0x14,             // CALL CnvtPixNumber
+    0xc5, 0xe5,                   // PUSH B; PUSH H
+    0xaf, 0x77, 0x23, 0x77, 0x23, // XRA A; MOV M,A; INX H; MOV M,A; INX H
+    0xe1, 0x01, 0x20, 0x00, 0x09, // POP H; LXI B,0020; DAD B
+    0xc1, 0x05, 0xc2, 0x27, 0x14, // POP B; DCR B; JNZ 1427
+    0xc9,                         // RET
+};
+
+static void erase_simple_sprite(State8080 *state, uint32_t left)
+{
+    static const uint8_t row[] = {0xc5, 0xe5, 0xaf, 0x77, 0x23, 0x77, 0x23,
+                                  0xe1, 0x01, 0x09, 0xc1, 0x05, 0xc2};
+    Run run = start_run(state, left);
+    step_until(&run, 0x1427);
+    while (state->pc == 0x1427 && FITS(&run, row))
+    {
+        push(state, state->b, state->c);
+        push(state, state->h, state->l);
+        state->a = 0;
+        run.psw = logic(0);
+        write_8080(state, get_hl(state), 0);
+        set_hl(state, get_hl(state) + 1);
+        write_8080(state, get_hl(state), 0);
+        set_hl(state, get_hl(state) + 1);
+        next_row(&run, 0x1427, 0x1438);
+        SPEND(&run, row);
+    }
+    if (state->pc == 0x1438)
+    {
+        ret(&run);
+    }
+    finish_run(&run);
+}
+
+static const Routine routines[] = {
+    {"DrawShiftedSprite", 0x1400, draw_shifted_sprite_code, sizeof(draw_shifted_sprite_code),
+     draw_shifted_sprite},
+    {"EraseSimpleSprite", 0x1424, erase_simple_sprite_code, sizeof(erase_simple_sprite_code),
+     erase_simple_sprite},
+    {"BlockCopy", 0x1a32, block_copy_code, sizeof(block_copy_code), block_copy},
+    {"ClearScreen", 0x1a5c, clear_screen_code, sizeof(clear_screen_code), clear_screen},
+};
+
+#define ROUTINE_COUNT (sizeof(routines) / sizeof(routines[0]))
+
+// What a routine left behind, compared in validation mode.
+static MachineSnapshot before, native, guest;
+
+// Finishes what the interpreter would still run of the routine in the
+// slice, so both sides stop at the same point.
+static void finish_on_interpreter(State8080 *state, uint16_t return_address, uint16_t sp,
+                                  uint32_t left, uint32_t start)
+{
+    while (!(state->pc == return_address && state->sp == sp) && state->cycle_count - start < left)
+    {
+        emulate_8080_op(state);
+    }
+}
+
+static bool same_outcome(const Routine *routine)
+{
+    const MachineSnapshot *a = &guest;
+    const MachineSnapshot *b = &native;
+    bool same = true;
+    if (a->a != b->a || a->b != b->b || a->c != b->c || a->d != b->d || a->e != b->e ||
+        a->h != b->h || a->l != b->l || a->sp != b->sp || a->pc != b->pc || a->psw != b->psw ||
+        a->cycle_count != b->cycle_count)
+    {
+        fprintf(stderr,
+                "hle: %s registers differ, guest pc %04x sp %04x psw %02x cycles %u, "
+                "native pc %04x sp %04x psw %02x cycles %u\n",
+                routine->name, a->pc, a->sp, a->psw, a->cycle_count, b->pc, b->sp, b->psw,
+                b->cycle_count);
+        same = false;
+    }
+    for (int i = 0; i < RAM_SIZE; i++)
+    {
+        if (a->ram[i] != b->ram[i])
+        {
+            fprintf(stderr, "hle: %s RAM differs at %04x, guest %02x native %02x\n",
+                    routine->name, RAM_START + i, a->ram[i], b->ram[i]);
+            same = false;
+            break;
+        }
+    }
+    if (a->shift_high != b->shift_high || a->shift_low != b->shift_low ||
+        a->shift_offset != b->shift_offset)
+    {
+        fprintf(stderr, "hle: %s shift register differs\n", routine->name);
+        same = false;
+    }
+    return same;
+}
+
+static void validate(State8080 *state, uint32_t left)
+{
+    Machine *machine = (Machine *)state->user_data;
+    const Routine *routine = NULL;
+    for (size_t i = 0; i < ROUTINE_COUNT; i++)
+    {
+        if (routines[i].entry == state->pc)
+        {
+            routine = &routines[i];
+        }
+    }
+    uint16_t return_address = read_8080(state, state->sp) | (read_8080(state, state->sp + 1) << 8);
+    uint16_t sp = state->sp + 2;
+    uint32_t start = state->cycle_count;
+
+    // A timeline with events from outside the board can't be rolled back,
+    // the guest code then runs alone and the routine is unhooked.
+    if (machine_snapshot(machine, &before))
+    {
+        routine->run(state, left);
+        finish_on_interpreter(state, return_address, sp, left, start);
+        machine_snapshot(machine, &native);
+        // Same again with the guest code, whose result is kept. Restoring
+        // goes through the memory map and drops what the native code
+        // stored from the decode cache.
+        machine_restore(machine, &before);
+    }
+    finish_on_interpreter(state, return_address, sp, left, start);
+
+    if (!machine_snapshot(machine, &guest) || !same_outcome(routine))
+    {
+        fprintf(stderr, "hle: %s (%04x) unhooked\n", routine->name, routine->entry);
+        machine->hooks[routine->entry] = NULL;
+    }
+}
+
+int init_hle(Machine *machine, bool validate_hooks)
+{
+    if (machine->hooks == NULL)
+    {
+        machine->hooks = calloc(0x10000, sizeof(Hook8080));
+    }
+    int count = 0;
+    for (size_t i = 0; i < ROUTINE_COUNT; i++)
+    {
+        const Routine *routine = &routines[i];
+        if (memcmp(&machine->cpu->memory[routine->entry], routine->code, routine->code_size) == 0)
+        {
+            machine->hooks[routine->entry] = validate_hooks ? validate : routine->run;
+            count++;
+        }
+    }
+    machine->cpu->hooks = machine->hooks;
+    return count;
+}
+
+bool hle_toggle(Machine *machine)
+{
+    State8080 *cpu = machine->cpu;
+    cpu->hooks = cpu->hooks == NULL ? machine->hooks : NULL;
+    return cpu->hooks != NULL;
+}
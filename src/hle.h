@@ -0,0 +1,17 @@
+#pragma once
+#include <stdbool.h>
+#include "machine.h"
+
+// High level emulation of the invaders ROM routines that only move memory
+// around: block copy, screen clear and sprite draw/erase. A CALL to one of
+// them runs native code instead, see Hook8080.
+//
+// Only routines whose guest code matches what the native version follows
+// get hooked. With `validate`, each call runs both the native code and the
+// guest code from the same state, compares registers, cycles, RAM and the
+// shift register, and keeps the guest's result. A routine that differs is
+// reported and unhooked. Returns the number of routines hooked, with HLE
+// switched on.
+int init_hle(Machine *machine, bool validate);
+// Switches HLE off or back on, returns whether it is now on.
+bool hle_toggle(Machine *machine);
@@ -0,0 +1,1506 @@
+#define _DEFAULT_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jit_8080.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#include <sys/mman.h>
+
+// Dynamic recompiler translating 8080 basic blocks to x86-64.
+//
+// While generated code runs, rbx holds the State8080, rbp the Jit8080, r12
+// the read pages of the memory map and r14d the cycles left in the slice. The 8080
+// registers stay in State8080, the flags are kept packed in `jit->psw`
+// because x86 `lahf` produces exactly the 8080 PSW layout. Every block
+// starts by checking that all of its cycles fit in r14d, otherwise it
+// bails out and the dispatcher runs one instruction at a time, so a slice
+// ends after the same instruction as with the interpreter.
+//
+// Stores go through jit_write, which invalidates any block covering the
+// written byte; the writing block then leaves at the next instruction.
+
+#define JIT_CODE_SIZE (4 * 1024 * 1024)
+#define JIT_SCRATCH_SIZE 1024
+#define JIT_MAX_BLOCK_INSTRUCTIONS 64
+// Pages whose code got rewritten this many times are left to the
+// interpreter, retranslating them would cost more than it saves.
+#define JIT_REWRITE_LIMIT 64
+// Every this many cycles, about a second, the rewrite counts halve and the
+// pages left out are translated again, until their code is next rewritten.
+#define JIT_REWRITE_DECAY_CYCLES 2000000
+// Upper bound of the code emitted for a single block.
+#define JIT_MAX_BLOCK_BYTES (JIT_MAX_BLOCK_INSTRUCTIONS * 160 + 256)
+
+// x86 register numbers.
+enum
+{
+    EAX = 0,
+    ECX = 1,
+    EDX = 2,
+    EBX = 3,
+    AH = 4,
+    ESI = 6,
+};
+
+enum
+{
+    PSW_S = 0x80,
+    PSW_Z = 0x40,
+    PSW_AC = 0x10,
+    PSW_P = 0x04,
+    PSW_CY = 0x01,
+};
+
+typedef struct JitBlock
+{
+    uint16_t start;
+    uint32_t end; // one past the last byte, may be 0x10000
+    uint8_t *code;
+    uint8_t *bail;
+    bool valid;
+} JitBlock;
+
+typedef struct PageBlocks
+{
+    uint32_t *indices;
+    uint32_t count, capacity;
+} PageBlocks;
+
+// Translations depend on nothing but the memory they were decoded from and
+// the code of the trampolines, so every JIT on one `memory` shares them.
+typedef struct JitCache
+{
+    uint8_t *memory;
+    uint32_t refs;
+    uint8_t *code;
+    size_t code_used;
+    uint8_t *scratch;
+    uint8_t *common_exit;
+    int32_t (*enter)(State8080 *, uint8_t *, int32_t, Jit8080 *);
+    uint8_t **lookup; // host code of the block starting at each address
+
+    JitBlock *blocks;
+    uint32_t block_count, block_capacity;
+    PageBlocks pages[256];
+    uint8_t code_bytes[0x10000]; // non zero where a valid block was decoded
+    uint8_t rewrites[256];
+    uint64_t decay_cycles; // run since the rewrite counts last halved
+} JitCache;
+
+struct Jit8080
+{
+    // Read by generated code through rbp, keep them within a disp8.
+    uint8_t psw;
+    uint8_t invalidated;
+    uint8_t *link_site;
+    uint8_t **lookup; // the cache's
+
+    JitCache *cache;
+    State8080 *state;
+    MemoryMap8080 *map;
+    void (*write_byte)(void *, uint16_t, uint8_t);
+    void *user_data;
+    // Swapped in while the interpreter runs, sends every store to jit_write.
+    MemoryMap8080 watch;
+};
+
+typedef struct Emitter
+{
+    uint8_t *start;
+    uint8_t *p;
+} Emitter;
+
+// Pending early exits, taken when a store hit translated code or EI lets a
+// held interrupt in.
+typedef struct EarlyExit
+{
+    uint8_t *jump;
+    uint16_t pc;
+    uint32_t refund;
+} EarlyExit;
+
+static const size_t register_offsets[8] = {
+    offsetof(State8080, b), offsetof(State8080, c),
+    offsetof(State8080, d), offsetof(State8080, e),
+    offsetof(State8080, h), offsetof(State8080, l),
+    0, // M
+    offsetof(State8080, a),
+};
+
+static void emit8(Emitter *e, uint8_t value)
+{
+    *e->p++ = value;
+}
+
+static void emit16(Emitter *e, uint16_t value)
+{
+    memcpy(e->p, &value, 2);
+    e->p += 2;
+}
+
+static void emit32(Emitter *e, uint32_t value)
+{
+    memcpy(e->p, &value, 4);
+    e->p += 4;
+}
+
+static void emit64(Emitter *e, uint64_t value)
+{
+    memcpy(e->p, &value, 8);
+    e->p += 8;
+}
+
+static void patch_rel32(uint8_t *field, uint8_t *target)
+{
+    int32_t rel = (int32_t)(target - (field + 4));
+    memcpy(field, &rel, 4);
+}
+
+// ModRM for [rbx + disp8] and [rbp + disp8].
+static void modrm_state(Emitter *e, int reg, size_t offset)
+{
+    emit8(e, 0x40 | (reg << 3) | EBX);
+    emit8(e, offset);
+}
+
+static void modrm_jit(Emitter *e, int reg, size_t offset)
+{
+    emit8(e, 0x40 | (reg << 3) | 5);
+    emit8(e, offset);
+}
+
+// movzx r32, byte [rbx + offset]
+static void load8(Emitter *e, int reg, size_t offset)
+{
+    emit8(e, 0x0f);
+    emit8(e, 0xb6);
+    modrm_state(e, reg, offset);
+}
+
+// mov byte [rbx + offset], r8
+static void store8(Emitter *e, size_t offset, int reg)
+{
+    emit8(e, 0x88);
+    modrm_state(e, reg, offset);
+}
+
+// movzx r32, word [rbx + offset]
+static void load16(Emitter *e, int reg, size_t offset)
+{
+    emit8(e, 0x0f);
+    emit8(e, 0xb7);
+    modrm_state(e, reg, offset);
+}
+
+// mov word [rbx + offset], r16
+static void store16(Emitter *e, size_t offset, int reg)
+{
+    emit8(e, 0x66);
+    emit8(e, 0x89);
+    modrm_state(e, reg, offset);
+}
+
+static void store8_imm(Emitter *e, size_t offset, uint8_t value)
+{
+    emit8(e, 0xc6);
+    modrm_state(e, 0, offset);
+    emit8(e, value);
+}
+
+static void store16_imm(Emitter *e, size_t offset, uint16_t value)
+{
+    emit8(e, 0x66);
+    emit8(e, 0xc7);
+    modrm_state(e, 0, offset);
+    emit16(e, value);
+}
+
+static void store_pc(Emitter *e, uint16_t pc)
+{
+    store16_imm(e, offsetof(State8080, pc), pc);
+}
+
+// Loads a register pair, `high` and `low` being 8080 register numbers
+// (SP is handled by the callers), into eax or ecx.
+static void load_pair(Emitter *e, int reg, int high, int low)
+{
+    load8(e, reg, register_offsets[high]);
+    emit8(e, 0xc1); // shl r32, 8
+    emit8(e, 0xe0 | reg);
+    emit8(e, 8);
+    emit8(e, 0x8a); // mov r8, [rbx + low]
+    modrm_state(e, reg, register_offsets[low]);
+}
+
+// Stores ax (al low, ah high) into a register pair.
+static void store_pair(Emitter *e, int high, int low)
+{
+    store8(e, register_offsets[low], EAX);
+    store8(e, register_offsets[high], AH);
+}
+
+static void load_hl(Emitter *e)
+{
+    load_pair(e, EAX, 4, 5);
+}
+
+// Loads the byte at guest address rax (kept) through the read pages,
+// resolving an own_8080 page as page_8080 does.
+static void read_memory(Emitter *e, int reg)
+{
+    static const uint8_t page[] = {
+        0x41, 0x89, 0xc3,       // mov r11d, eax
+        0x41, 0xc1, 0xeb, 0x08, // shr r11d, 8
+        0x4f, 0x8b, 0x1c, 0xdc, // mov r11, [r12 + r11 * 8]
+        0x4d, 0x8d, 0x53, 0xff, // lea r10, [r11 - 1]
+    };
+    memcpy(e->p, page, sizeof(page));
+    e->p += sizeof(page);
+    emit8(e, 0x4c); // add r10, [rbx + own]
+    emit8(e, 0x03);
+    modrm_state(e, 2, offsetof(State8080, own));
+    static const uint8_t own[] = {
+        0x41, 0xf6, 0xc3, 0x01, // test r11b, 1
+        0x4d, 0x0f, 0x45, 0xda, // cmovnz r11, r10
+        0x44, 0x0f, 0xb6, 0xd0, // movzx r10d, al
+    };
+    memcpy(e->p, own, sizeof(own));
+    e->p += sizeof(own);
+    emit8(e, 0x43); // movzx r32, byte [r11 + r10]
+    emit8(e, 0x0f);
+    emit8(e, 0xb6);
+    emit8(e, 0x04 | (reg << 3));
+    emit8(e, 0x13);
+}
+
+static void mov_imm32(Emitter *e, int reg, uint32_t value)
+{
+    emit8(e, 0xb8 | reg);
+    emit32(e, value);
+}
+
+typedef void (*Helper)(void);
+
+static void call_helper(Emitter *e, Helper function)
+{
+    uint64_t address;
+    memcpy(&address, &function, sizeof(address));
+    emit8(e, 0x48); // mov rdi, rbp
+    emit8(e, 0x89);
+    emit8(e, 0xef);
+    emit8(e, 0x48); // mov rax, imm64
+    emit8(e, 0xb8);
+    emit64(e, address);
+    emit8(e, 0xff); // call rax
+    emit8(e, 0xd0);
+}
+
+// Returns the address of the rel32 field to patch.
+static uint8_t *jump_rel32(Emitter *e, uint8_t condition)
+{
+    if (condition == 0)
+    {
+        emit8(e, 0xe9);
+    }
+    else
+    {
+        emit8(e, 0x0f);
+        emit8(e, condition);
+    }
+    uint8_t *field = e->p;
+    emit32(e, 0);
+    return field;
+}
+
+#define JZ 0x84
+#define JNZ 0x85
+#define JL 0x8c
+
+// Packed flags: ah = lahf result, stored to jit->psw.
+static void store_flags(Emitter *e)
+{
+    emit8(e, 0x88); // mov [rbp + psw], ah
+    modrm_jit(e, AH, offsetof(Jit8080, psw));
+}
+
+static void psw_op(Emitter *e, int operation, uint8_t value)
+{
+    emit8(e, 0x80); // op byte [rbp + psw], imm8
+    modrm_jit(e, operation, offsetof(Jit8080, psw));
+    emit8(e, value);
+}
+
+static void ah_op(Emitter *e, int operation, uint8_t value)
+{
+    emit8(e, 0x80); // op ah, imm8
+    emit8(e, 0xc0 | (operation << 3) | AH);
+    emit8(e, value);
+}
+
+#define OP_ADD 0
+#define OP_OR 1
+#define OP_AND 4
+#define OP_XOR 6
+
+// Sets CF from the 8080 carry: mov cl, [rbp + psw]; shr cl, 1
+static void carry_in(Emitter *e)
+{
+    emit8(e, 0x8a);
+    modrm_jit(e, ECX, offsetof(Jit8080, psw));
+    emit8(e, 0xd0);
+    emit8(e, 0xe9);
+}
+
+// Replaces the carry in jit->psw with the x86 carry flag.
+static void carry_out(Emitter *e)
+{
+    emit8(e, 0x0f); // setc cl
+    emit8(e, 0x92);
+    emit8(e, 0xc1);
+    psw_op(e, OP_AND, (uint8_t)~PSW_CY);
+    emit8(e, 0x08); // or [rbp + psw], cl
+    modrm_jit(e, ECX, offsetof(Jit8080, psw));
+}
+
+static int32_t remaining_cycles(int64_t cycles)
+{
+    return cycles > INT32_MAX ? INT32_MAX : (int32_t)cycles;
+}
+
+static void jit_invalidate(Jit8080 *jit, uint16_t address)
+{
+    JitCache *cache = jit->cache;
+    PageBlocks *page = &cache->pages[address >> 8];
+    for (uint32_t i = 0; i < page->count; i++)
+    {
+        JitBlock *block = &cache->blocks[page->indices[i]];
+        if (block->valid && address >= block->start && address < block->end)
+        {
+            // Linked predecessors still jump here, so the entry becomes a
+            // jump to the bail out stub, which hands back to the dispatcher.
+            block->valid = false;
+            block->code[0] = 0xe9;
+            patch_rel32(block->code + 1, block->bail);
+            if (cache->lookup[block->start] == block->code)
+            {
+                cache->lookup[block->start] = NULL;
+            }
+        }
+    }
+
+    // Recompute the translated bytes of the pages that changed.
+    for (int p = (address >> 8) - 1; p <= (address >> 8) + 1; p++)
+    {
+        if (p < 0 || p > 0xff)
+        {
+            continue;
+        }
+        memset(&cache->code_bytes[p << 8], 0, 0x100);
+        for (uint32_t i = 0; i < cache->pages[p].count; i++)
+        {
+            JitBlock *block = &cache->blocks[cache->pages[p].indices[i]];
+            if (!block->valid)
+            {
+                continue;
+            }
+            uint32_t from = block->start > (uint32_t)(p << 8) ? block->start : (uint32_t)(p << 8);
+            uint32_t to = block->end < (uint32_t)((p + 1) << 8) ? block->end : (uint32_t)((p + 1) << 8);
+            if (from < to)
+            {
+                memset(&cache->code_bytes[from], 1, to - from);
+            }
+        }
+    }
+    if (cache->rewrites[address >> 8] < JIT_REWRITE_LIMIT)
+    {
+        cache->rewrites[address >> 8]++;
+    }
+    jit->invalidated = 1;
+}
+
+// Like write_8080, but through the map saved by jit_8080_run, since
+// interpret() swaps the state's own.
+static void jit_write(Jit8080 *jit, uint32_t address, uint32_t value)
+{
+    uint8_t *page = page_8080(jit->state, jit->map->write[address >> 8]);
+    uint32_t changed = address;
+    if (page != NULL)
+    {
+        // Code runs from `memory`, a mirrored page changes another address
+        // and a page elsewhere none.
+        page[address & 0xff] = value;
+        changed = code_offset_8080(jit->state, &page[address & 0xff]);
+        if (changed < 0x10000)
+        {
+            invalidate_8080_decoded(jit->state, changed);
+        }
+    }
+    else if (jit->map->write_handler[address >> 8] != NULL)
+    {
+        // The handler sees the CPU as it is outside interpret() and may
+        // remap pages, as a copy on write does.
+        State8080 *state = jit->state;
+        MemoryMap8080 *map = state->map;
+        void *user_data = state->user_data;
+        state->map = jit->map;
+        state->user_data = jit->user_data;
+        jit->map->write_handler[address >> 8](jit->user_data, address, value);
+        state->map = map;
+        state->user_data = user_data;
+        memcpy(jit->watch.read, jit->map->read, sizeof(jit->watch.read));
+    }
+    else
+    {
+        jit->write_byte(jit->user_data, address, value);
+    }
+    if (changed < 0x10000 && jit->cache->code_bytes[changed])
+    {
+        jit_invalidate(jit, changed);
+    }
+}
+
+static void jit_push(Jit8080 *jit, uint32_t value)
+{
+    State8080 *state = jit->state;
+    jit_write(jit, (uint16_t)(state->sp - 1), value >> 8);
+    jit_write(jit, (uint16_t)(state->sp - 2), value & 0xff);
+    state->sp -= 2;
+}
+
+static void jit_xthl(Jit8080 *jit)
+{
+    State8080 *state = jit->state;
+    uint8_t l = state->l;
+    uint8_t h = state->h;
+    state->l = read_8080(state, state->sp);
+    state->h = read_8080(state, state->sp + 1);
+    jit_write(jit, state->sp, l);
+    jit_write(jit, (uint16_t)(state->sp + 1), h);
+}
+
+// Port callbacks may look at the whole CPU, so the flags are synced first.
+static uint32_t jit_in(Jit8080 *jit, uint32_t port)
+{
+    State8080 *state = jit->state;
+    set_psw_8080(state, jit->psw);
+    return state->port_input(state->user_data, port);
+}
+
+static void jit_out(Jit8080 *jit, uint32_t port)
+{
+    State8080 *state = jit->state;
+    set_psw_8080(state, jit->psw);
+    state->port_output(state->user_data, port, state->a);
+}
+
+static void jit_daa(Jit8080 *jit)
+{
+    State8080 *state = jit->state;
+    set_psw_8080(state, jit->psw);
+    // DAA doesn't touch memory or ports, so the interpreter can run it
+    // from the pc the block stored.
+    uint32_t cycles = state->cycle_count;
+    emulate_8080_op(state);
+    state->cycle_count = cycles;
+    jit->psw = get_psw_8080(state);
+}
+
+static void interpreter_write(void *data, uint16_t address, uint8_t value)
+{
+    jit_write((Jit8080 *)data, address, value);
+}
+
+// Runs one instruction on the interpreter, with its stores going through
+// jit_write so they still invalidate translated code.
+static void interpret(Jit8080 *jit)
+{
+    State8080 *state = jit->state;
+    uint8_t opcode = state->memory[state->pc];
+    set_psw_8080(state, jit->psw);
+    if (opcode == 0xd3 || opcode == 0xdb)
+    {
+        // Port callbacks get the real user_data, and IN/OUT don't store.
+        emulate_8080_op(state);
+    }
+    else
+    {
+        state->user_data = jit;
+        state->map = &jit->watch;
+        emulate_8080_op(state);
+        state->user_data = jit->user_data;
+        state->map = jit->map;
+    }
+    jit->psw = get_psw_8080(state);
+}
+
+static bool is_unimplemented(uint8_t opcode)
+{
+    return opcodes8080[opcode].op_class == OP_8080_UNIMPLEMENTED;
+}
+
+static bool ends_block(uint8_t opcode)
+{
+    OpClass8080 op_class = opcodes8080[opcode].op_class;
+    return op_class == OP_8080_JUMP || op_class == OP_8080_CALL || op_class == OP_8080_RETURN;
+}
+
+static bool condition_holds_mask(uint8_t opcode, uint8_t *mask)
+{
+    static const uint8_t masks[4] = {PSW_Z, PSW_CY, PSW_P, PSW_S};
+    int condition = (opcode >> 3) & 7;
+    *mask = masks[condition >> 1];
+    return condition & 1;
+}
+
+// Jumps when the condition of a conditional opcode does not hold.
+static uint8_t *jump_unless(Emitter *e, uint8_t opcode)
+{
+    uint8_t mask;
+    bool set = condition_holds_mask(opcode, &mask);
+    emit8(e, 0xf6); // test byte [rbp + psw], mask
+    modrm_jit(e, 0, offsetof(Jit8080, psw));
+    emit8(e, mask);
+    return jump_rel32(e, set ? JZ : JNZ);
+}
+
+// Static exit to `pc`. Unless `linkable` is false, the leading jump is
+// later patched to go straight to the translated target.
+static void exit_static(Jit8080 *jit, Emitter *e, uint16_t pc, bool linkable)
+{
+    uint8_t *site = e->p;
+    uint8_t *field = jump_rel32(e, 0);
+    patch_rel32(field, e->p);
+    store_pc(e, pc);
+    if (linkable)
+    {
+        emit8(e, 0x48); // mov rax, site
+        emit8(e, 0xb8);
+        emit64(e, (uint64_t)(uintptr_t)site);
+    }
+    else
+    {
+        emit8(e, 0x31); // xor eax, eax
+        emit8(e, 0xc0);
+    }
+    patch_rel32(jump_rel32(e, 0), jit->cache->common_exit);
+}
+
+// Exit to the address in eax, already stored in state->pc, going straight
+// to its block when it has been translated.
+static void exit_dynamic(Jit8080 *jit, Emitter *e)
+{
+    emit8(e, 0x48); // mov rcx, [rbp + lookup]
+    emit8(e, 0x8b);
+    modrm_jit(e, ECX, offsetof(Jit8080, lookup));
+    emit8(e, 0x48); // mov rcx, [rcx + rax * 8]
+    emit8(e, 0x8b);
+    emit8(e, 0x0c);
+    emit8(e, 0xc1);
+    emit8(e, 0x48); // test rcx, rcx
+    emit8(e, 0x85);
+    emit8(e, 0xc9);
+    emit8(e, 0x74); // jz +2
+    emit8(e, 2);
+    emit8(e, 0xff); // jmp rcx
+    emit8(e, 0xe1);
+    emit8(e, 0x31); // xor eax, eax
+    emit8(e, 0xc0);
+    patch_rel32(jump_rel32(e, 0), jit->cache->common_exit);
+}
+
+// After an instruction that stored to memory, leave the block if the store
+// invalidated translated code, which may be the rest of this block.
+static void check_invalidated(Emitter *e, EarlyExit *exits, int *count,
+                              uint16_t pc, uint32_t refund)
+{
+    emit8(e, 0x80); // cmp byte [rbp + invalidated], 0
+    modrm_jit(e, 7, offsetof(Jit8080, invalidated));
+    emit8(e, 0);
+    exits[*count].jump = jump_rel32(e, JNZ);
+    exits[*count].pc = pc;
+    exits[*count].refund = refund;
+    (*count)++;
+}
+
+// Leaves the block after EI while the CPU holds an interrupt, for
+// jit_8080_run to let it in after the next instruction.
+static void check_held_interrupt(Emitter *e, EarlyExit *exits, int *count, uint16_t pc,
+                                 uint32_t refund)
+{
+    emit8(e, 0x80); // cmp byte [rbx + held_interrupt], 0
+    modrm_state(e, 7, offsetof(State8080, held_interrupt));
+    emit8(e, 0);
+    exits[*count].jump = jump_rel32(e, JNZ);
+    exits[*count].pc = pc;
+    exits[*count].refund = refund;
+    (*count)++;
+}
+
+static void emit_pop(Emitter *e)
+{
+    load16(e, EAX, offsetof(State8080, sp));
+    read_memory(e, ECX);
+    emit8(e, 0x66); // inc ax
+    emit8(e, 0xff);
+    emit8(e, 0xc0);
+    read_memory(e, EDX);
+    emit8(e, 0x66); // add word [rbx + sp], 2
+    emit8(e, 0x83);
+    modrm_state(e, 0, offsetof(State8080, sp));
+    emit8(e, 2);
+}
+
+// The extra cycles of a conditional CALL or RET that branches, the block
+// only counted the ones for falling through.
+static void charge_taken(Emitter *e, uint8_t opcode)
+{
+    emit8(e, 0x41); // sub r14d, extra
+    emit8(e, 0x83);
+    emit8(e, 0xee);
+    emit8(e, taken_cycles8080[opcode] - cycles8080[opcode]);
+}
+
+static void emit_ret(Jit8080 *jit, Emitter *e)
+{
+    emit_pop(e);
+    emit8(e, 0xc1); // shl edx, 8
+    emit8(e, 0xe2);
+    emit8(e, 8);
+    emit8(e, 0x8d); // lea eax, [rdx + rcx]
+    emit8(e, 0x04);
+    emit8(e, 0x0a);
+    store16(e, offsetof(State8080, pc), EAX);
+    exit_dynamic(jit, e);
+}
+
+static void emit_call(Jit8080 *jit, Emitter *e, uint16_t next, uint16_t target,
+                      EarlyExit *exits, int *exit_count, uint32_t refund, bool linkable)
+{
+    mov_imm32(e, ESI, next);
+    call_helper(e, (Helper)jit_push);
+    check_invalidated(e, exits, exit_count, target, refund);
+    exit_static(jit, e, target, linkable);
+}
+
+// Loads the second ALU operand into edx.
+static void alu_operand(Emitter *e, int source)
+{
+    if (source == 6)
+    {
+        load_hl(e);
+        read_memory(e, EDX);
+    }
+    else
+    {
+        load8(e, EDX, register_offsets[source]);
+    }
+}
+
+// A (in al) op dl, for the eight ALU operations in opcode order.
+static void alu(Emitter *e, int operation)
+{
+    static const uint8_t opcodes[8] = {0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38};
+
+    load8(e, EAX, offsetof(State8080, a));
+    if (operation == 1 || operation == 3) // ADC, SBB
+    {
+        carry_in(e);
+    }
+    if (operation == 4) // ANA: AC is the OR of bit 3 of the operands
+    {
+        emit8(e, 0x88); // mov cl, al
+        emit8(e, 0xc1);
+        emit8(e, 0x08); // or cl, dl
+        emit8(e, 0xd1);
+    }
+    emit8(e, opcodes[operation]);
+    emit8(e, 0xd0); // al, dl
+    emit8(e, 0x9f); // lahf
+    switch (operation)
+    {
+    case 2: // SUB, SBB and CMP: the 8080 sets AC when there's no borrow
+    case 3:
+    case 7:
+        ah_op(e, OP_XOR, PSW_AC);
+        break;
+    case 4:
+        ah_op(e, OP_AND, (uint8_t)~PSW_AC);
+        emit8(e, 0xd0); // shl cl, 1
+        emit8(e, 0xe1);
+        emit8(e, 0x80); // and cl, 0x10
+        emit8(e, 0xe1);
+        emit8(e, PSW_AC);
+        emit8(e, 0x08); // or ah, cl
+        emit8(e, 0xcc);
+        break;
+    case 5:
+    case 6:
+        ah_op(e, OP_AND, (uint8_t)~PSW_AC);
+        break;
+    }
+    store_flags(e);
+    if (operation != 7)
+    {
+        store8(e, offsetof(State8080, a), EAX);
+    }
+}
+
+// INR/DCR on al, keeping the 8080 carry.
+static void increment(Emitter *e, bool decrement)
+{
+    emit8(e, 0xfe); // inc al / dec al
+    emit8(e, decrement ? 0xc8 : 0xc0);
+    emit8(e, 0x9f); // lahf
+    if (decrement)
+    {
+        ah_op(e, OP_XOR, PSW_AC);
+    }
+    ah_op(e, OP_AND, (uint8_t)~PSW_CY);
+    emit8(e, 0x8a); // mov cl, [rbp + psw]
+    modrm_jit(e, ECX, offsetof(Jit8080, psw));
+    emit8(e, 0x80); // and cl, 1
+    emit8(e, 0xe1);
+    emit8(e, PSW_CY);
+    emit8(e, 0x08); // or ah, cl
+    emit8(e, 0xcc);
+    store_flags(e);
+}
+
+// Emits one instruction. Returns false for the ones left to the
+// interpreter.
+static bool translate_instruction(Jit8080 *jit, Emitter *e, uint16_t pc,
+                                  EarlyExit *exits, int *exit_count,
+                                  uint32_t refund, bool linkable)
+{
+    uint8_t *memory = jit->state->memory;
+    uint8_t opcode = memory[pc];
+    uint8_t byte1 = memory[(uint16_t)(pc + 1)];
+    uint16_t word = byte1 | (memory[(uint16_t)(pc + 2)] << 8);
+    uint16_t next = pc + lengths8080[opcode];
+    int dst = (opcode >> 3) & 7;
+    int src = opcode & 7;
+    int pair = (opcode >> 4) & 3;
+    static const int pair_high[3] = {0, 2, 4};
+    static const int pair_low[3] = {1, 3, 5};
+
+    if (is_unimplemented(opcode))
+    {
+        return false;
+    }
+
+    if (opcode >= 0x40 && opcode < 0x80) // MOV
+    {
+        if (dst == 6)
+        {
+            load_hl(e);
+            emit8(e, 0x89); // mov esi, eax
+            emit8(e, 0xc6);
+            load8(e, EDX, register_offsets[src]);
+            call_helper(e, (Helper)jit_write);
+            check_invalidated(e, exits, exit_count, next, refund);
+        }
+        else if (src == 6)
+        {
+            load_hl(e);
+            read_memory(e, EAX);
+            store8(e, register_offsets[dst], EAX);
+        }
+        else if (src != dst)
+        {
+            load8(e, EAX, register_offsets[src]);
+            store8(e, register_offsets[dst], EAX);
+        }
+        return true;
+    }
+
+    if (opcode >= 0x80 && opcode < 0xc0)
+    {
+        alu_operand(e, src);
+        alu(e, dst);
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0xc6) // ALU immediate
+    {
+        mov_imm32(e, EDX, byte1);
+        alu(e, dst);
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0x04 || (opcode & 0xc7) == 0x05) // INR, DCR
+    {
+        bool decrement = opcode & 1;
+        if (dst == 6)
+        {
+            load_hl(e);
+            emit8(e, 0x89); // mov esi, eax
+            emit8(e, 0xc6);
+            read_memory(e, EAX);
+            increment(e, decrement);
+            emit8(e, 0x0f); // movzx edx, al
+            emit8(e, 0xb6);
+            emit8(e, 0xd0);
+            call_helper(e, (Helper)jit_write);
+            check_invalidated(e, exits, exit_count, next, refund);
+        }
+        else
+        {
+            load8(e, EAX, register_offsets[dst]);
+            increment(e, decrement);
+            store8(e, register_offsets[dst], EAX);
+        }
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0x06) // MVI
+    {
+        if (dst == 6)
+        {
+            load_hl(e);
+            emit8(e, 0x89); // mov esi, eax
+            emit8(e, 0xc6);
+            mov_imm32(e, EDX, byte1);
+            call_helper(e, (Helper)jit_write);
+            check_invalidated(e, exits, exit_count, next, refund);
+        }
+        else
+        {
+            store8_imm(e, register_offsets[dst], byte1);
+        }
+        return true;
+    }
+
+    if ((opcode & 0xcf) == 0x01) // LXI
+    {
+        if (pair == 3)
+        {
+            store16_imm(e, offsetof(State8080, sp), word);
+        }
+        else
+        {
+            store8_imm(e, register_offsets[pair_low[pair]], word & 0xff);
+            store8_imm(e, register_offsets[pair_high[pair]], word >> 8);
+        }
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0x03) // INX, DCX
+    {
+        bool decrement = opcode & 0x08;
+        if (pair == 3)
+        {
+            emit8(e, 0x66); // inc/dec word [rbx + sp]
+            emit8(e, 0xff);
+            modrm_state(e, decrement ? 1 : 0, offsetof(State8080, sp));
+        }
+        else
+        {
+            load_pair(e, EAX, pair_high[pair], pair_low[pair]);
+            emit8(e, 0xff); // inc/dec eax
+            emit8(e, decrement ? 0xc8 : 0xc0);
+            store_pair(e, pair_high[pair], pair_low[pair]);
+        }
+        return true;
+    }
+
+    if ((opcode & 0xcf) == 0x09) // DAD
+    {
+        load_hl(e);
+        if (pair == 3)
+        {
+            load16(e, ECX, offsetof(State8080, sp));
+        }
+        else
+        {
+            load_pair(e, ECX, pair_high[pair], pair_low[pair]);
+        }
+        emit8(e, 0x66); // add ax, cx
+        emit8(e, 0x01);
+        emit8(e, 0xc8);
+        store_pair(e, 4, 5);
+        carry_out(e);
+        return true;
+    }
+
+    if ((opcode & 0xcf) == 0xc1) // POP
+    {
+        emit_pop(e);
+        if (pair == 3)
+        {
+            emit8(e, 0x80); // and cl, 0xd5
+            emit8(e, 0xe1);
+            emit8(e, 0xd5);
+            emit8(e, 0x80); // or cl, 2
+            emit8(e, 0xc9);
+            emit8(e, 0x02);
+            emit8(e, 0x88); // mov [rbp + psw], cl
+            modrm_jit(e, ECX, offsetof(Jit8080, psw));
+            store8(e, offsetof(State8080, a), EDX);
+        }
+        else
+        {
+            store8(e, register_offsets[pair_low[pair]], ECX);
+            store8(e, register_offsets[pair_high[pair]], EDX);
+        }
+        return true;
+    }
+
+    if ((opcode & 0xcf) == 0xc5) // PUSH
+    {
+        if (pair == 3)
+        {
+            load8(e, EAX, offsetof(State8080, a));
+            emit8(e, 0xc1); // shl eax, 8
+            emit8(e, 0xe0);
+            emit8(e, 8);
+            emit8(e, 0x8a); // mov al, [rbp + psw]
+            modrm_jit(e, EAX, offsetof(Jit8080, psw));
+        }
+        else
+        {
+            load_pair(e, EAX, pair_high[pair], pair_low[pair]);
+        }
+        emit8(e, 0x89); // mov esi, eax
+        emit8(e, 0xc6);
+        call_helper(e, (Helper)jit_push);
+        check_invalidated(e, exits, exit_count, next, refund);
+        return true;
+    }
+
+    switch (opcode)
+    {
+    case 0x00: // NOP
+        return true;
+    case 0x02: // STAX B
+    case 0x12: // STAX D
+        load_pair(e, EAX, pair_high[pair], pair_low[pair]);
+        emit8(e, 0x89); // mov esi, eax
+        emit8(e, 0xc6);
+        load8(e, EDX, offsetof(State8080, a));
+        call_helper(e, (Helper)jit_write);
+        check_invalidated(e, exits, exit_count, next, refund);
+        return true;
+    case 0x0a: // LDAX B
+    case 0x1a: // LDAX D
+        load_pair(e, EAX, pair_high[pair], pair_low[pair]);
+        read_memory(e, EAX);
+        store8(e, offsetof(State8080, a), EAX);
+        return true;
+    case 0x07: // RLC
+    case 0x0f: // RRC
+    case 0x17: // RAL
+    case 0x1f: // RAR
+    {
+        static const uint8_t rotates[4] = {0xc0, 0xc8, 0xd0, 0xd8};
+        load8(e, EAX, offsetof(State8080, a));
+        if (opcode == 0x17 || opcode == 0x1f)
+        {
+            carry_in(e);
+        }
+        emit8(e, 0xd0); // rol/ror/rcl/rcr al, 1
+        emit8(e, rotates[opcode >> 3]);
+        store8(e, offsetof(State8080, a), EAX);
+        carry_out(e);
+        return true;
+    }
+    case 0x22: // SHLD
+        mov_imm32(e, ESI, word);
+        load8(e, EDX, offsetof(State8080, l));
+        call_helper(e, (Helper)jit_write);
+        mov_imm32(e, ESI, (uint16_t)(word + 1));
+        load8(e, EDX, offsetof(State8080, h));
+        call_helper(e, (Helper)jit_write);
+        check_invalidated(e, exits, exit_count, next, refund);
+        return true;
+    case 0x2a: // LHLD
+        mov_imm32(e, EAX, word);
+        read_memory(e, EAX);
+        store8(e, offsetof(State8080, l), EAX);
+        mov_imm32(e, EAX, (uint16_t)(word + 1));
+        read_memory(e, EAX);
+        store8(e, offsetof(State8080, h), EAX);
+        return true;
+    case 0x27: // DAA
+        store_pc(e, pc);
+        call_helper(e, (Helper)jit_daa);
+        return true;
+    case 0x2f: // CMA
+        emit8(e, 0xf6); // not byte [rbx + a]
+        modrm_state(e, 2, offsetof(State8080, a));
+        return true;
+    case 0x32: // STA
+        mov_imm32(e, ESI, word);
+        load8(e, EDX, offsetof(State8080, a));
+        call_helper(e, (Helper)jit_write);
+        check_invalidated(e, exits, exit_count, next, refund);
+        return true;
+    case 0x3a: // LDA
+        mov_imm32(e, EAX, word);
+        read_memory(e, EAX);
+        store8(e, offsetof(State8080, a), EAX);
+        return true;
+    case 0x37: // STC
+        psw_op(e, OP_OR, PSW_CY);
+        return true;
+    case 0x3f: // CMC
+        psw_op(e, OP_XOR, PSW_CY);
+        return true;
+    case 0xd3: // OUT
+        store_pc(e, next);
+        mov_imm32(e, ESI, byte1);
+        call_helper(e, (Helper)jit_out);
+        return true;
+    case 0xdb: // IN
+        store_pc(e, next);
+        mov_imm32(e, ESI, byte1);
+        call_helper(e, (Helper)jit_in);
+        store8(e, offsetof(State8080, a), EAX);
+        return true;
+    case 0xe3: // XTHL
+        call_helper(e, (Helper)jit_xthl);
+        check_invalidated(e, exits, exit_count, next, refund);
+        return true;
+    case 0xeb: // XCHG
+        load16(e, EAX, offsetof(State8080, d));
+        load16(e, ECX, offsetof(State8080, h));
+        store16(e, offsetof(State8080, d), ECX);
+        store16(e, offsetof(State8080, h), EAX);
+        return true;
+    case 0xf3: // DI
+        store8_imm(e, offsetof(State8080, int_enable), 0);
+        return true;
+    case 0xfb: // EI
+        store8_imm(e, offsetof(State8080, int_enable), 1);
+        check_held_interrupt(e, exits, exit_count, next, refund);
+        return true;
+    case 0xf9: // SPHL
+        load_hl(e);
+        store16(e, offsetof(State8080, sp), EAX);
+        return true;
+    case 0xe9: // PCHL
+        load_hl(e);
+        store16(e, offsetof(State8080, pc), EAX);
+        exit_dynamic(jit, e);
+        return true;
+    case 0xc3: // JMP
+        exit_static(jit, e, word, linkable);
+        return true;
+    case 0xc9: // RET
+        emit_ret(jit, e);
+        return true;
+    case 0xcd: // CALL
+        emit_call(jit, e, next, word, exits, exit_count, refund, linkable);
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0xc7) // RST
+    {
+        emit_call(jit, e, next, opcode & 0x38, exits, exit_count, refund, linkable);
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0xc2) // Jcc
+    {
+        uint8_t *skip = jump_unless(e, opcode);
+        exit_static(jit, e, word, linkable);
+        patch_rel32(skip, e->p);
+        exit_static(jit, e, next, linkable);
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0xc4) // Ccc
+    {
+        uint8_t *skip = jump_unless(e, opcode);
+        charge_taken(e, opcode);
+        emit_call(jit, e, next, word, exits, exit_count, refund, linkable);
+        patch_rel32(skip, e->p);
+        exit_static(jit, e, next, linkable);
+        return true;
+    }
+
+    if ((opcode & 0xc7) == 0xc0) // Rcc
+    {
+        uint8_t *skip = jump_unless(e, opcode);
+        charge_taken(e, opcode);
+        emit_ret(jit, e);
+        patch_rel32(skip, e->p);
+        exit_static(jit, e, next, linkable);
+        return true;
+    }
+
+    return false;
+}
+
+// Drops every translation in the cache. Only the JIT running holds a link
+// site, the others clear theirs when they stop.
+static void flush_code(Jit8080 *jit)
+{
+    JitCache *cache = jit->cache;
+    cache->code_used = 0;
+    cache->block_count = 0;
+    jit->link_site = NULL;
+    memset(cache->lookup, 0, 0x10000 * sizeof(uint8_t *));
+    memset(cache->code_bytes, 0, sizeof(cache->code_bytes));
+    for (int p = 0; p < 256; p++)
+    {
+        cache->pages[p].count = 0;
+    }
+}
+
+static void add_to_page(PageBlocks *page, uint32_t index)
+{
+    if (page->count == page->capacity)
+    {
+        page->capacity = page->capacity ? page->capacity * 2 : 16;
+        page->indices = realloc(page->indices, page->capacity * sizeof(uint32_t));
+    }
+    page->indices[page->count++] = index;
+}
+
+// Translates the block at `start`. A `single` block holds one instruction,
+// has no cycle check and goes to the scratch area: the dispatcher uses it
+// to finish a slice one instruction at a time.
+static uint8_t *translate(Jit8080 *jit, uint16_t start, bool single)
+{
+    JitCache *cache = jit->cache;
+    uint8_t *memory = cache->memory;
+    uint16_t pcs[JIT_MAX_BLOCK_INSTRUCTIONS];
+    int count = 0;
+    uint32_t cycles = 0;
+    uint32_t pc = start;
+
+    while (count < (single ? 1 : JIT_MAX_BLOCK_INSTRUCTIONS) && pc < 0x10000)
+    {
+        uint8_t opcode = memory[pc];
+        if (is_unimplemented(opcode) || pc + lengths8080[opcode] > 0x10000)
+        {
+            break;
+        }
+        pcs[count++] = pc;
+        cycles += cycles8080[opcode];
+        pc += lengths8080[opcode];
+        if (ends_block(opcode))
+        {
+            break;
+        }
+    }
+    if (count == 0)
+    {
+        return NULL;
+    }
+
+    if (!single && cache->code_used + JIT_MAX_BLOCK_BYTES > JIT_CODE_SIZE - JIT_SCRATCH_SIZE)
+    {
+        flush_code(jit);
+    }
+
+    Emitter e;
+    e.start = single ? cache->scratch : cache->code + cache->code_used;
+    e.p = e.start;
+
+    uint8_t *bail_jump = NULL;
+    if (!single)
+    {
+        emit8(&e, 0x41); // cmp r14d, cycles
+        emit8(&e, 0x81);
+        emit8(&e, 0xfe);
+        emit32(&e, cycles);
+        bail_jump = jump_rel32(&e, JL);
+        emit8(&e, 0x41); // sub r14d, cycles
+        emit8(&e, 0x81);
+        emit8(&e, 0xee);
+        emit32(&e, cycles);
+    }
+    else
+    {
+        emit8(&e, 0x41); // sub r14d, cycles
+        emit8(&e, 0x81);
+        emit8(&e, 0xee);
+        emit32(&e, cycles);
+    }
+
+    EarlyExit exits[JIT_MAX_BLOCK_INSTRUCTIONS];
+    int exit_count = 0;
+    uint32_t refund = cycles;
+    for (int i = 0; i < count; i++)
+    {
+        refund -= cycles8080[memory[pcs[i]]];
+        translate_instruction(jit, &e, pcs[i], exits, &exit_count, refund, !single);
+    }
+    uint8_t last = memory[pcs[count - 1]];
+    if (!ends_block(last))
+    {
+        exit_static(jit, &e, pc, !single);
+    }
+
+    for (int i = 0; i < exit_count; i++)
+    {
+        patch_rel32(exits[i].jump, e.p);
+        if (exits[i].refund)
+        {
+            emit8(&e, 0x41); // add r14d, refund
+            emit8(&e, 0x81);
+            emit8(&e, 0xc6);
+            emit32(&e, exits[i].refund);
+        }
+        store_pc(&e, exits[i].pc);
+        emit8(&e, 0x31); // xor eax, eax
+        emit8(&e, 0xc0);
+        patch_rel32(jump_rel32(&e, 0), cache->common_exit);
+    }
+
+    uint8_t *bail = e.p;
+    store_pc(&e, start);
+    emit8(&e, 0x31); // xor eax, eax
+    emit8(&e, 0xc0);
+    patch_rel32(jump_rel32(&e, 0), cache->common_exit);
+
+    if (single)
+    {
+        return e.start;
+    }
+    patch_rel32(bail_jump, bail);
+    cache->code_used += e.p - e.start;
+
+    if (cache->block_count == cache->block_capacity)
+    {
+        cache->block_capacity = cache->block_capacity ? cache->block_capacity * 2 : 1024;
+        cache->blocks = realloc(cache->blocks, cache->block_capacity * sizeof(JitBlock));
+    }
+    uint32_t index = cache->block_count++;
+    JitBlock *block = &cache->blocks[index];
+    block->start = start;
+    block->end = pc;
+    block->code = e.start;
+    block->bail = bail;
+    block->valid = true;
+    memset(&cache->code_bytes[start], 1, pc - start);
+    for (uint32_t page = start >> 8; page <= ((pc - 1) >> 8); page++)
+    {
+        add_to_page(&cache->pages[page], index);
+    }
+    cache->lookup[start] = e.start;
+    return e.start;
+}
+
+static void emit_trampolines(JitCache *cache)
+{
+    Emitter e;
+    e.start = cache->code + JIT_CODE_SIZE - JIT_SCRATCH_SIZE;
+    e.p = e.start;
+
+    // int32_t enter(State8080 *state, uint8_t *code, int32_t cycles, Jit8080 *jit)
+    uint8_t *enter = e.p;
+    static const uint8_t prologue[] = {
+        0x53,                   // push rbx
+        0x55,                   // push rbp
+        0x41, 0x54,             // push r12
+        0x41, 0x55,             // push r13
+        0x41, 0x56,             // push r14
+        0x41, 0x57,             // push r15
+        0x48, 0x83, 0xec, 0x08, // sub rsp, 8
+        0x48, 0x89, 0xfb,       // mov rbx, rdi
+        0x48, 0x89, 0xcd,       // mov rbp, rcx
+        0x41, 0x89, 0xd6,       // mov r14d, edx
+    };
+    memcpy(e.p, prologue, sizeof(prologue));
+    e.p += sizeof(prologue);
+    emit8(&e, 0x4c); // mov r12, [rbx + map], the read pages come first
+    emit8(&e, 0x8b);
+    modrm_state(&e, 4, offsetof(State8080, map));
+    emit8(&e, 0xff); // jmp rsi
+    emit8(&e, 0xe6);
+
+    // Every exit gets here with the link site (or 0) in rax.
+    cache->common_exit = e.p;
+    emit8(&e, 0x48); // mov [rbp + link_site], rax
+    emit8(&e, 0x89);
+    modrm_jit(&e, EAX, offsetof(Jit8080, link_site));
+    static const uint8_t epilogue[] = {
+        0x44, 0x89, 0xf0,       // mov eax, r14d
+        0x48, 0x83, 0xc4, 0x08, // add rsp, 8
+        0x41, 0x5f,             // pop r15
+        0x41, 0x5e,             // pop r14
+        0x41, 0x5d,             // pop r13
+        0x41, 0x5c,             // pop r12
+        0x5d,                   // pop rbp
+        0x5b,                   // pop rbx
+        0xc3,                   // ret
+    };
+    memcpy(e.p, epilogue, sizeof(epilogue));
+    e.p += sizeof(epilogue);
+
+    // ISO C has no conversion from data to function pointers.
+    memcpy(&cache->enter, &enter, sizeof(enter));
+    cache->scratch = e.p;
+}
+
+static JitCache *init_jit_cache(uint8_t *memory)
+{
+    uint8_t *code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    JitCache *cache = calloc(1, sizeof(JitCache));
+    cache->memory = memory;
+    cache->code = code;
+    cache->lookup = calloc(0x10000, sizeof(uint8_t *));
+    emit_trampolines(cache);
+    return cache;
+}
+
+Jit8080 *init_jit_8080_sharing(State8080 *state, Jit8080 *other)
+{
+    JitCache *cache = NULL;
+    if (other != NULL && other->cache->memory == state->memory)
+    {
+        cache = other->cache;
+    }
+    else
+    {
+        cache = init_jit_cache(state->memory);
+        if (cache == NULL)
+        {
+            return NULL;
+        }
+    }
+    cache->refs++;
+
+    Jit8080 *jit = calloc(1, sizeof(Jit8080));
+    jit->state = state;
+    jit->cache = cache;
+    jit->lookup = cache->lookup;
+    for (int page = 0; page < 256; page++)
+    {
+        jit->watch.write_handler[page] = interpreter_write;
+    }
+    return jit;
+}
+
+Jit8080 *init_jit_8080(State8080 *state)
+{
+    return init_jit_8080_sharing(state, NULL);
+}
+
+void free_jit_8080(Jit8080 *jit)
+{
+    JitCache *cache = jit->cache;
+    free(jit);
+    if (--cache->refs != 0)
+    {
+        return;
+    }
+    munmap(cache->code, JIT_CODE_SIZE);
+    for (int p = 0; p < 256; p++)
+    {
+        free(cache->pages[p].indices);
+    }
+    free(cache->blocks);
+    free(cache->lookup);
+    free(cache);
+}
+
+uint32_t jit_8080_run(Jit8080 *jit, uint32_t cycle_budget)
+{
+    State8080 *state = jit->state;
+    JitCache *cache = jit->cache;
+    uint32_t start = state->cycle_count;
+    uint32_t consumed = 0;
+
+    jit->psw = get_psw_8080(state);
+    jit->map = state->map;
+    jit->write_byte = state->write_byte;
+    jit->user_data = state->user_data;
+    memcpy(jit->watch.read, jit->map->read, sizeof(jit->watch.read));
+    while (consumed < cycle_budget)
+    {
+        int32_t remaining = remaining_cycles((int64_t)cycle_budget - consumed);
+        uint8_t *code = cache->lookup[state->pc];
+        if (code == NULL && cache->rewrites[state->pc >> 8] < JIT_REWRITE_LIMIT)
+        {
+            code = translate(jit, state->pc, false);
+        }
+        if (code != NULL && jit->link_site != NULL)
+        {
+            patch_rel32(jit->link_site + 1, code);
+        }
+        jit->link_site = NULL;
+
+        // Blocks check their own cycles, one that doesn't fit bails out
+        // right away and the slice ends one instruction at a time.
+        if (code != NULL)
+        {
+            jit->invalidated = 0;
+            int32_t left = cache->enter(state, code, remaining, jit);
+            if (left == remaining && jit->link_site == NULL && !jit->invalidated)
+            {
+                code = translate(jit, state->pc, true);
+                left = cache->enter(state, code, remaining, jit);
+                jit->link_site = NULL;
+            }
+            state->cycle_count += remaining - left;
+            if (state->held_interrupt != 0 && state->int_enable)
+            {
+                // After EI: the interpreter runs the next instruction and
+                // takes the interrupt.
+                interpret(jit);
+            }
+        }
+        else
+        {
+            // Self-modifying code, HLT and the unused opcodes, which the
+            // interpreter reports.
+            interpret(jit);
+        }
+        consumed = state->cycle_count - start;
+    }
+    set_psw_8080(state, jit->psw);
+    // Another JIT on the cache may flush it before this one runs again.
+    jit->link_site = NULL;
+
+    cache->decay_cycles += consumed;
+    if (cache->decay_cycles >= JIT_REWRITE_DECAY_CYCLES)
+    {
+        cache->decay_cycles = 0;
+        for (int p = 0; p < 256; p++)
+        {
+            // A page left out gets one more try, a rewrite puts it back.
+            uint8_t count = cache->rewrites[p];
+            cache->rewrites[p] = count == JIT_REWRITE_LIMIT ? count - 1 : count / 2;
+        }
+    }
+    return consumed;
+}
+#else
+Jit8080 *init_jit_8080(State8080 *state)
+{
+    (void)state;
+    return NULL;
+}
+
+Jit8080 *init_jit_8080_sharing(State8080 *state, Jit8080 *other)
+{
+    (void)state;
+    (void)other;
+    return NULL;
+}
+
+void free_jit_8080(Jit8080 *jit)
+{
+    (void)jit;
+}
+
+uint32_t jit_8080_run(Jit8080 *jit, uint32_t cycle_budget)
+{
+    (void)jit;
+    (void)cycle_budget;
+    return 0;
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+#include "8080.h"
+
+typedef struct Jit8080 Jit8080;
+
+// Returns NULL when generated code can't run on this host (anything but
+// x86-64, or no executable memory), callers then stay on the interpreter.
+Jit8080 *init_jit_8080(State8080 *state);
+// Like init_jit_8080, but when `state` fetches code from the same memory as
+// `other` (machines on one ROM do), the two share their translations: code
+// one translates the other runs as it is. JITs sharing them must run on one
+// thread at a time. `other` may be NULL.
+Jit8080 *init_jit_8080_sharing(State8080 *state, Jit8080 *other);
+// The translations go with the last JIT sharing them.
+void free_jit_8080(Jit8080 *jit);
+// Same contract as emulate_8080_run, on the state given to init_jit_8080.
+// Only stores made while it runs invalidate translated code: anything
+// else writing guest code (e.g. generate_interrupt pushing onto a stack
+// that overlaps it) isn't noticed.
+uint32_t jit_8080_run(Jit8080 *jit, uint32_t cycle_budget);
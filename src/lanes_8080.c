@@ -0,0 +1,873 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lanes_8080.h"
+
+#define PSW_S 0x80
+#define PSW_Z 0x40
+#define PSW_AC 0x10
+#define PSW_P 0x04
+#define PSW_CY 0x01
+
+// One byte per lane, a vector register wide. Masks are the signed type,
+// all ones in the lanes where they hold. Register pairs are kept as their
+// two bytes, 16-bit lanes would take two registers.
+typedef uint8_t v8 __attribute__((vector_size(LANES_8080)));
+typedef int8_t mask8 __attribute__((vector_size(LANES_8080)));
+
+// The vectors hold the registers of the lanes in the group, which are all
+// at `group_pc`; the other lanes of a slice run on their own State8080 and
+// their entries are stale. The cycles the group ran are added to the lanes'
+// counts in one go when the group changes, see settle_cycles.
+struct Lanes8080
+{
+    v8 r[8]; // B C D E H L - A, numbered like in the opcodes
+    v8 psw;  // as PUSH PSW stores it
+    uint16_t sp[LANES_8080];
+    uint32_t group;               // the lanes in the vectors
+    uint16_t group_pc;            // the address they are at
+    uint32_t group_cycles;        // run by the group since the last settle_cycles
+    bool parted;                  // the last instruction sent the lanes to `target`
+    uint16_t target[LANES_8080];  // each lane's next pc then
+    uint32_t start[LANES_8080];   // cycle counts at the start of the slice
+    bool shared[256];             // every lane reads the page from the same memory
+    int count;
+    State8080 *cpus[LANES_8080];
+    Lanes8080Stats stats;
+};
+
+// Eight lanes per 64-bit word: the low bit of each byte, gathered into the
+// top byte by the multiply.
+static uint32_t lane_bits(mask8 mask)
+{
+    uint64_t words[LANES_8080 / 8];
+    memcpy(words, &mask, sizeof(words));
+    uint32_t bits = 0;
+    for (int i = 0; i < LANES_8080 / 8; i++)
+    {
+        uint64_t low = words[i] & 0x0101010101010101ull;
+        bits |= (uint32_t)((low * 0x0102040810204080ull) >> 56) << (8 * i);
+    }
+    return bits;
+}
+
+// Bit 7 of `a + b` plus a carry in, as a 0 or 1 in each lane, from the sum.
+static v8 carry_out(v8 a, v8 b, v8 sum)
+{
+    return ((a & b) | ((a ^ b) & ~sum)) >> 7;
+}
+
+static v8 zsp(v8 x)
+{
+    v8 p = x ^ (x >> 4);
+    p ^= p >> 2;
+    p ^= p >> 1;
+    return (x & PSW_S) | ((v8)(x == 0) & PSW_Z) | ((~p & 1) << 2) | 0x02;
+}
+
+static void load_lane(Lanes8080 *lanes, int i)
+{
+    State8080 *cpu = lanes->cpus[i];
+    lanes->r[0][i] = cpu->b;
+    lanes->r[1][i] = cpu->c;
+    lanes->r[2][i] = cpu->d;
+    lanes->r[3][i] = cpu->e;
+    lanes->r[4][i] = cpu->h;
+    lanes->r[5][i] = cpu->l;
+    lanes->r[7][i] = cpu->a;
+    lanes->psw[i] = get_psw_8080(cpu);
+    lanes->sp[i] = cpu->sp;
+}
+
+static void store_lane(Lanes8080 *lanes, int i, uint16_t pc)
+{
+    State8080 *cpu = lanes->cpus[i];
+    cpu->b = lanes->r[0][i];
+    cpu->c = lanes->r[1][i];
+    cpu->d = lanes->r[2][i];
+    cpu->e = lanes->r[3][i];
+    cpu->h = lanes->r[4][i];
+    cpu->l = lanes->r[5][i];
+    cpu->a = lanes->r[7][i];
+    set_psw_8080(cpu, lanes->psw[i]);
+    cpu->sp = lanes->sp[i];
+    cpu->pc = pc;
+}
+
+static void settle_cycles(Lanes8080 *lanes)
+{
+    for (uint32_t left = lanes->group; left != 0; left &= left - 1)
+    {
+        lanes->cpus[__builtin_ctz(left)]->cycle_count += lanes->group_cycles;
+    }
+    lanes->group_cycles = 0;
+}
+
+// Takes the lanes of `bits` out of the group, each to go on at its
+// `target` when `parted`, else at `group_pc`.
+static void leave_group(Lanes8080 *lanes, uint32_t bits)
+{
+    settle_cycles(lanes);
+    for (uint32_t left = bits; left != 0; left &= left - 1)
+    {
+        int i = __builtin_ctz(left);
+        store_lane(lanes, i, lanes->parted ? lanes->target[i] : lanes->group_pc);
+    }
+    lanes->group &= ~bits;
+}
+
+// The lane's BC, DE, HL or SP.
+static uint16_t lane_pair(const Lanes8080 *lanes, int pair, int i)
+{
+    if (pair == 3)
+    {
+        return lanes->sp[i];
+    }
+    return (lanes->r[2 * pair][i] << 8) | lanes->r[2 * pair + 1][i];
+}
+
+// The byte at each lane's BC, DE or HL.
+static v8 load_at_pair(Lanes8080 *lanes, int pair)
+{
+    v8 value = {0};
+    for (uint32_t left = lanes->group; left != 0; left &= left - 1)
+    {
+        int i = __builtin_ctz(left);
+        value[i] = read_8080(lanes->cpus[i], lane_pair(lanes, pair, i));
+    }
+    return value;
+}
+
+static void store_at_pair(Lanes8080 *lanes, int pair, v8 value)
+{
+    for (uint32_t left = lanes->group; left != 0; left &= left - 1)
+    {
+        int i = __builtin_ctz(left);
+        write_8080(lanes->cpus[i], lane_pair(lanes, pair, i), value[i]);
+    }
+}
+
+static v8 load_at(Lanes8080 *lanes, uint16_t address)
+{
+    v8 value = {0};
+    for (uint32_t left = lanes->group; left != 0; left &= left - 1)
+    {
+        int i = __builtin_ctz(left);
+        value[i] = read_8080(lanes->cpus[i], address);
+    }
+    return value;
+}
+
+static void store_at(Lanes8080 *lanes, uint16_t address, v8 value)
+{
+    for (uint32_t left = lanes->group; left != 0; left &= left - 1)
+    {
+        int i = __builtin_ctz(left);
+        write_8080(lanes->cpus[i], address, value[i]);
+    }
+}
+
+// High byte first, like the interpreter.
+static void push_lane(Lanes8080 *lanes, int i, uint16_t value)
+{
+    State8080 *cpu = lanes->cpus[i];
+    uint16_t sp = lanes->sp[i] - 2;
+    write_8080(cpu, sp + 1, value >> 8);
+    write_8080(cpu, sp, value & 0xff);
+    lanes->sp[i] = sp;
+}
+
+static uint16_t pop_lane(Lanes8080 *lanes, int i)
+{
+    State8080 *cpu = lanes->cpus[i];
+    uint16_t sp = lanes->sp[i];
+    lanes->sp[i] = sp + 2;
+    return read_8080(cpu, sp) | (read_8080(cpu, sp + 1) << 8);
+}
+
+// NZ Z NC C PO PE P M.
+static mask8 condition(v8 psw, int code)
+{
+    static const uint8_t flag_bit[4] = {6, 0, 2, 7};
+    mask8 set = (mask8)(((psw >> flag_bit[code >> 1]) & 1) != 0);
+    return code & 1 ? set : ~set;
+}
+
+// ADD ADC SUB SBB ANA XRA ORA CMP, with the flags of the interpreter.
+static void alu(Lanes8080 *lanes, int kind, v8 value)
+{
+    v8 a = lanes->r[7];
+    v8 psw = lanes->psw;
+    v8 result;
+    v8 flags;
+
+    if (kind <= 3 || kind == 7)
+    {
+        // Subtraction is a + ~value + !borrow with the carry inverted.
+        bool subtract = kind >= 2;
+        v8 b = subtract ? ~value : value;
+        v8 carry_in = (v8){0};
+        if (kind == 1)
+        {
+            carry_in = psw & PSW_CY;
+        }
+        else if (kind == 3)
+        {
+            carry_in = (psw & PSW_CY) ^ 1;
+        }
+        else if (subtract)
+        {
+            carry_in += 1;
+        }
+        result = a + b + carry_in;
+        flags = zsp(result) | ((a ^ b ^ result) & PSW_AC) | carry_out(a, b, result);
+        if (subtract)
+        {
+            flags ^= PSW_CY;
+        }
+    }
+    else if (kind == 4)
+    {
+        result = a & value;
+        flags = zsp(result) | (((a | value) << 1) & PSW_AC);
+    }
+    else
+    {
+        result = kind == 5 ? a ^ value : a | value;
+        flags = zsp(result);
+    }
+
+    if (kind != 7)
+    {
+        lanes->r[7] = result;
+    }
+    lanes->psw = flags;
+}
+
+static v8 inr_dcr(Lanes8080 *lanes, v8 value, bool decrement)
+{
+    v8 result;
+    v8 half;
+    if (decrement)
+    {
+        result = value - 1;
+        half = (v8)((result & 0xf) != 0xf) & PSW_AC;
+    }
+    else
+    {
+        result = value + 1;
+        half = (v8)((result & 0xf) == 0) & PSW_AC;
+    }
+    lanes->psw = zsp(result) | half | (lanes->psw & PSW_CY);
+    return result;
+}
+
+// Sends the lanes of the group where `taken` holds to `address`, the
+// others to `next`. When that parts the group run_group picks the side it
+// keeps.
+static void branch(Lanes8080 *lanes, uint32_t taken, uint16_t address, uint16_t next)
+{
+    if (taken == lanes->group)
+    {
+        lanes->group_pc = address;
+        return;
+    }
+    if (taken == 0)
+    {
+        lanes->group_pc = next;
+        return;
+    }
+    for (uint32_t left = lanes->group; left != 0; left &= left - 1)
+    {
+        int i = __builtin_ctz(left);
+        lanes->target[i] = taken & (1u << i) ? address : next;
+    }
+    lanes->parted = true;
+}
+
+// Runs the instruction at `group_pc` across the group and moves
+// `group_pc` along. Returns false, having changed nothing, for the
+// instructions without a vector version.
+static bool run_vector(Lanes8080 *lanes, uint8_t op, uint8_t imm8, uint16_t imm16)
+{
+    v8 *r = lanes->r;
+    uint16_t next = lanes->group_pc + lengths8080[op];
+    uint32_t group = lanes->group;
+
+    if (op >= 0x40 && op < 0x80 && op != 0x76) // MOV
+    {
+        int to = (op >> 3) & 7;
+        int from = op & 7;
+        v8 value = from == 6 ? load_at_pair(lanes, 2) : r[from];
+        if (to == 6)
+        {
+            store_at_pair(lanes, 2, value);
+        }
+        else
+        {
+            r[to] = value;
+        }
+    }
+    else if (op >= 0x80 && op < 0xc0) // ALU with a register or M
+    {
+        int from = op & 7;
+        alu(lanes, (op >> 3) & 7, from == 6 ? load_at_pair(lanes, 2) : r[from]);
+    }
+    else if ((op & 0xc7) == 0xc6) // ALU with an immediate
+    {
+        alu(lanes, (op >> 3) & 7, (v8){0} + imm8);
+    }
+    else if ((op & 0xc6) == 0x04) // INR, DCR
+    {
+        int to = (op >> 3) & 7;
+        bool decrement = op & 1;
+        if (to == 6)
+        {
+            store_at_pair(lanes, 2, inr_dcr(lanes, load_at_pair(lanes, 2), decrement));
+        }
+        else
+        {
+            r[to] = inr_dcr(lanes, r[to], decrement);
+        }
+    }
+    else if ((op & 0xc7) == 0x06) // MVI
+    {
+        int to = (op >> 3) & 7;
+        if (to == 6)
+        {
+            store_at_pair(lanes, 2, (v8){0} + imm8);
+        }
+        else
+        {
+            r[to] = (v8){0} + imm8;
+        }
+    }
+    else if ((op & 0xcf) == 0x01 || (op & 0xc7) == 0x03) // LXI, INX, DCX
+    {
+        int pair = (op >> 4) & 3;
+        int kind = op & 0x0f;
+        if (pair == 3)
+        {
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                lanes->sp[i] = kind == 0x01 ? imm16 : lanes->sp[i] + (kind == 0x03 ? 1 : -1);
+            }
+        }
+        else if (kind == 0x01)
+        {
+            r[2 * pair] = (v8){0} + (uint8_t)(imm16 >> 8);
+            r[2 * pair + 1] = (v8){0} + (uint8_t)imm16;
+        }
+        else if (kind == 0x03)
+        {
+            // The high byte takes the carry where the low one wrapped to 0,
+            // minus a mask of all ones adds 1.
+            v8 low = r[2 * pair + 1] + 1;
+            r[2 * pair] -= (v8)(low == 0);
+            r[2 * pair + 1] = low;
+        }
+        else
+        {
+            r[2 * pair] += (v8)(r[2 * pair + 1] == 0);
+            r[2 * pair + 1] -= 1;
+        }
+    }
+    else if ((op & 0xcf) == 0x09) // DAD
+    {
+        int pair = op >> 4;
+        v8 high = {0};
+        v8 low = {0};
+        if (pair == 3)
+        {
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                high[i] = lanes->sp[i] >> 8;
+                low[i] = lanes->sp[i] & 0xff;
+            }
+        }
+        else
+        {
+            high = r[2 * pair];
+            low = r[2 * pair + 1];
+        }
+        v8 l = r[5] + low;
+        v8 h = r[4] + high + carry_out(r[5], low, l);
+        lanes->psw = (lanes->psw & ~PSW_CY) | carry_out(r[4], high, h);
+        r[4] = h;
+        r[5] = l;
+    }
+    else if ((op & 0xc7) == 0xc2 || op == 0xc3) // JMP, Jcc
+    {
+        uint32_t taken = op == 0xc3 ? group : group & lane_bits(condition(lanes->psw, (op >> 3) & 7));
+        branch(lanes, taken, imm16, next);
+        return true;
+    }
+    else if ((op & 0xc7) == 0xc4 || op == 0xcd) // CALL, Ccc
+    {
+        uint32_t taken = op == 0xcd ? group : group & lane_bits(condition(lanes->psw, (op >> 3) & 7));
+        for (uint32_t left = taken; left != 0; left &= left - 1)
+        {
+            int i = __builtin_ctz(left);
+            push_lane(lanes, i, next);
+            lanes->cpus[i]->cycle_count += taken_cycles8080[op] - cycles8080[op];
+        }
+        branch(lanes, taken, imm16, next);
+        return true;
+    }
+    else if ((op & 0xc7) == 0xc0 || op == 0xc9 || op == 0xe9) // RET, Rcc, PCHL
+    {
+        // Each lane goes to its own address, the group parts unless they
+        // all go to the same one.
+        uint32_t taken = (op & 0xc7) == 0xc0 ? group & lane_bits(condition(lanes->psw, (op >> 3) & 7))
+                                             : group;
+        uint16_t address = 0;
+        bool parted = false;
+        for (uint32_t left = group; left != 0; left &= left - 1)
+        {
+            int i = __builtin_ctz(left);
+            uint16_t to = next;
+            if (taken & (1u << i))
+            {
+                to = op == 0xe9 ? lane_pair(lanes, 2, i) : pop_lane(lanes, i);
+                lanes->cpus[i]->cycle_count += taken_cycles8080[op] - cycles8080[op];
+            }
+            if (left == group)
+            {
+                address = to;
+            }
+            parted = parted || to != address;
+            lanes->target[i] = to;
+        }
+        lanes->group_pc = address;
+        lanes->parted = parted;
+        return true;
+    }
+    else if ((op & 0xc7) == 0xc7) // RST
+    {
+        for (uint32_t left = group; left != 0; left &= left - 1)
+        {
+            push_lane(lanes, __builtin_ctz(left), next);
+        }
+        lanes->group_pc = op & 0x38;
+        return true;
+    }
+    else if ((op & 0xcf) == 0xc5) // PUSH
+    {
+        int pair = (op >> 4) & 3;
+        for (uint32_t left = group; left != 0; left &= left - 1)
+        {
+            int i = __builtin_ctz(left);
+            push_lane(lanes, i,
+                      pair == 3 ? (r[7][i] << 8) | lanes->psw[i] : lane_pair(lanes, pair, i));
+        }
+    }
+    else if ((op & 0xcf) == 0xc1) // POP
+    {
+        int pair = (op >> 4) & 3;
+        int high = pair == 3 ? 7 : 2 * pair;
+        for (uint32_t left = group; left != 0; left &= left - 1)
+        {
+            int i = __builtin_ctz(left);
+            uint16_t value = pop_lane(lanes, i);
+            r[high][i] = value >> 8;
+            if (pair == 3)
+            {
+                lanes->psw[i] = (value & (PSW_S | PSW_Z | PSW_AC | PSW_P | PSW_CY)) | 0x02;
+            }
+            else
+            {
+                r[high + 1][i] = value & 0xff;
+            }
+        }
+    }
+    else
+    {
+        v8 a = r[7];
+        v8 cy = lanes->psw & PSW_CY;
+        switch (op)
+        {
+        case 0x00: // NOP
+            break;
+        case 0x02: // STAX B
+        case 0x12: // STAX D
+            store_at_pair(lanes, op >> 4, a);
+            break;
+        case 0x0a: // LDAX B
+        case 0x1a: // LDAX D
+            a = load_at_pair(lanes, op >> 4);
+            break;
+        case 0x22: // SHLD
+            store_at(lanes, imm16, r[5]);
+            store_at(lanes, imm16 + 1, r[4]);
+            break;
+        case 0x2a: // LHLD
+            r[5] = load_at(lanes, imm16);
+            r[4] = load_at(lanes, imm16 + 1);
+            break;
+        case 0x32: // STA
+            store_at(lanes, imm16, a);
+            break;
+        case 0x3a: // LDA
+            a = load_at(lanes, imm16);
+            break;
+        case 0x07: // RLC
+            a = (a << 1) | (a >> 7);
+            cy = a & 1;
+            break;
+        case 0x0f: // RRC
+            cy = a & 1;
+            a = (a >> 1) | (a << 7);
+            break;
+        case 0x17: // RAL
+        {
+            v8 out = a >> 7;
+            a = (a << 1) | cy;
+            cy = out;
+            break;
+        }
+        case 0x1f: // RAR
+        {
+            v8 out = a & 1;
+            a = (a >> 1) | (cy << 7);
+            cy = out;
+            break;
+        }
+        case 0x2f: // CMA
+            a = ~a;
+            break;
+        case 0x37: // STC
+            cy = (v8){0} + 1;
+            break;
+        case 0x3f: // CMC
+            cy ^= 1;
+            break;
+        case 0xe3: // XTHL
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                State8080 *cpu = lanes->cpus[i];
+                uint16_t sp = lanes->sp[i];
+                uint8_t low = read_8080(cpu, sp);
+                uint8_t high = read_8080(cpu, sp + 1);
+                write_8080(cpu, sp, r[5][i]);
+                write_8080(cpu, sp + 1, r[4][i]);
+                r[5][i] = low;
+                r[4][i] = high;
+            }
+            break;
+        case 0xeb: // XCHG
+        {
+            v8 d = r[2];
+            v8 e = r[3];
+            r[2] = r[4];
+            r[3] = r[5];
+            r[4] = d;
+            r[5] = e;
+            break;
+        }
+        case 0xf9: // SPHL
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                lanes->sp[i] = lane_pair(lanes, 2, i);
+            }
+            break;
+        case 0xd3: // OUT
+        case 0xdb: // IN
+            // Each CPU's own port handlers, which may look at its registers
+            // and cycle count.
+            settle_cycles(lanes);
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                State8080 *cpu = lanes->cpus[i];
+                store_lane(lanes, i, next);
+                if (op == 0xdb)
+                {
+                    a[i] = cpu->port_input(cpu->user_data, imm8);
+                }
+                else
+                {
+                    cpu->port_output(cpu->user_data, imm8, a[i]);
+                }
+            }
+            break;
+        case 0xf3: // DI
+        case 0xfb: // EI
+            // An EI that lets a held interrupt in takes it after the next
+            // instruction, which the interpreter does.
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                if (op == 0xfb && lanes->cpus[__builtin_ctz(left)]->held_interrupt != 0)
+                {
+                    return false;
+                }
+            }
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                lanes->cpus[__builtin_ctz(left)]->int_enable = op == 0xfb;
+            }
+            break;
+        default:
+            return false;
+        }
+        r[7] = a;
+        lanes->psw = (lanes->psw & ~PSW_CY) | cy;
+    }
+
+    lanes->group_pc = next;
+    return true;
+}
+
+// Runs the instruction at `group_pc` across the lanes of the group holding
+// the same code as the first, when it has a vector version. The lanes the
+// group loses go on on their own: those with other code, all of them for
+// an instruction without a vector version, and the smaller side of a
+// branch.
+static void run_group(Lanes8080 *lanes)
+{
+    uint32_t group = lanes->group;
+    State8080 *leader = lanes->cpus[__builtin_ctz(group)];
+    uint16_t pc = lanes->group_pc;
+    uint8_t code[3];
+    for (int k = 0; k < 3; k++)
+    {
+        code[k] = read_8080(leader, pc + k);
+    }
+
+    // Code in pages all lanes read from the same memory is the same in all
+    // of them, elsewhere it is compared, as a word where the page has one.
+    uint8_t op = code[0];
+    int length = lengths8080[op];
+    uint16_t last = pc + length - 1;
+    lanes->parted = false;
+    if (!lanes->shared[pc >> 8] || !lanes->shared[last >> 8])
+    {
+        static const uint8_t ones[4][4] = {{0}, {0xff}, {0xff, 0xff}, {0xff, 0xff, 0xff}};
+        bool one_word = (pc & 0xff) <= 0xfc;
+        uint32_t mask;
+        uint32_t want = 0;
+        memcpy(&mask, ones[length], 4);
+        if (one_word)
+        {
+            memcpy(&want, page_8080(leader, leader->map->read[pc >> 8]) + (pc & 0xff), 4);
+        }
+        uint32_t other = 0;
+        for (uint32_t left = group & (group - 1); left != 0; left &= left - 1)
+        {
+            int i = __builtin_ctz(left);
+            if (one_word)
+            {
+                uint32_t word;
+                const State8080 *cpu = lanes->cpus[i];
+                memcpy(&word, page_8080(cpu, cpu->map->read[pc >> 8]) + (pc & 0xff), 4);
+                other |= ((word ^ want) & mask) != 0 ? 1u << i : 0;
+                continue;
+            }
+            for (int k = 0; k < length; k++)
+            {
+                if (read_8080(lanes->cpus[i], pc + k) != code[k])
+                {
+                    other |= 1u << i;
+                    break;
+                }
+            }
+        }
+        if (other != 0)
+        {
+            leave_group(lanes, other);
+        }
+    }
+
+    group = lanes->group;
+    if (!run_vector(lanes, op, code[1], code[1] | (code[2] << 8)))
+    {
+        leave_group(lanes, group);
+        return;
+    }
+    lanes->stats.vector_steps++;
+    lanes->stats.vector_instructions += __builtin_popcount(group);
+    lanes->group_cycles += cycles8080[op];
+    if (lanes->parted)
+    {
+        // The group follows the first lane's way when at least half the
+        // lanes go there, else the first lane going the other way.
+        int first = __builtin_ctz(group);
+        uint16_t address = lanes->target[first];
+        uint32_t along = 0;
+        for (uint32_t left = group; left != 0; left &= left - 1)
+        {
+            int i = __builtin_ctz(left);
+            along |= lanes->target[i] == address ? 1u << i : 0;
+        }
+        if (2 * __builtin_popcount(along) < __builtin_popcount(group))
+        {
+            address = lanes->target[__builtin_ctz(group & ~along)];
+            along = 0;
+            for (uint32_t left = group; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                along |= lanes->target[i] == address ? 1u << i : 0;
+            }
+        }
+        leave_group(lanes, group & ~along);
+        lanes->group_pc = address;
+        lanes->parted = false;
+    }
+}
+
+// The pc most of the lanes of `bits` are at, if most of them are at one
+// (majority vote), else one of theirs.
+static uint16_t elect_pc(const Lanes8080 *lanes, uint32_t bits)
+{
+    uint16_t candidate = 0;
+    int votes = 0;
+    for (uint32_t left = bits; left != 0; left &= left - 1)
+    {
+        uint16_t pc = lanes->cpus[__builtin_ctz(left)]->pc;
+        if (votes == 0)
+        {
+            candidate = pc;
+        }
+        votes += pc == candidate ? 1 : -1;
+    }
+    return candidate;
+}
+
+Lanes8080 *init_lanes_8080(State8080 *const *cpus, int count)
+{
+    if (count < 1 || count > LANES_8080)
+    {
+        return NULL;
+    }
+    // Vectors need their natural alignment.
+    size_t size = (sizeof(Lanes8080) + 63) / 64 * 64;
+    Lanes8080 *lanes = aligned_alloc(64, size);
+    memset(lanes, 0, size);
+    lanes->count = count;
+    memcpy(lanes->cpus, cpus, count * sizeof(State8080 *));
+    return lanes;
+}
+
+void free_lanes_8080(Lanes8080 *lanes)
+{
+    free(lanes);
+}
+
+void lanes_8080_run(Lanes8080 *lanes, uint32_t cycle_budget)
+{
+    for (int page = 0; page < 256; page++)
+    {
+        const State8080 *first = lanes->cpus[0];
+        const uint8_t *read = page_8080(first, first->map->read[page]);
+        lanes->shared[page] = true;
+        for (int i = 1; i < lanes->count; i++)
+        {
+            const State8080 *cpu = lanes->cpus[i];
+            lanes->shared[page] = lanes->shared[page] && page_8080(cpu, cpu->map->read[page]) == read;
+        }
+    }
+    for (int i = 0; i < lanes->count; i++)
+    {
+        lanes->start[i] = lanes->cpus[i]->cycle_count;
+    }
+    uint32_t running = lanes->count == 32 ? UINT32_MAX : (1u << lanes->count) - 1;
+    lanes->group = 0;
+    lanes->group_cycles = 0;
+
+    // The group and the lanes with budget left are looked at again when
+    // the group changed, until then the instructions it runs count down
+    // its headroom, which is what its lane closest to its budget has left.
+    int64_t headroom = 0;
+    for (;;)
+    {
+        if (headroom <= 0)
+        {
+            settle_cycles(lanes);
+            uint32_t done = 0;
+            for (uint32_t left = running; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                if (lanes->cpus[i]->cycle_count - lanes->start[i] >= cycle_budget)
+                {
+                    done |= 1u << i;
+                }
+            }
+            leave_group(lanes, done & lanes->group);
+            running &= ~done;
+            if (running == 0)
+            {
+                break;
+            }
+            // Move the group to where most lanes are once it holds half or less.
+            if (2 * __builtin_popcount(lanes->group) <= __builtin_popcount(running))
+            {
+                leave_group(lanes, lanes->group);
+                lanes->group_pc = elect_pc(lanes, running);
+                for (uint32_t left = running; left != 0; left &= left - 1)
+                {
+                    int i = __builtin_ctz(left);
+                    if (lanes->cpus[i]->pc == lanes->group_pc)
+                    {
+                        load_lane(lanes, i);
+                        lanes->group |= 1u << i;
+                    }
+                }
+            }
+            headroom = cycle_budget;
+            for (uint32_t left = lanes->group; left != 0; left &= left - 1)
+            {
+                int i = __builtin_ctz(left);
+                int64_t lane_headroom = (int64_t)cycle_budget -
+                                        (lanes->cpus[i]->cycle_count - lanes->start[i]);
+                headroom = lane_headroom < headroom ? lane_headroom : headroom;
+            }
+        }
+
+        // What the group's first lane ran is what every lane staying in it
+        // ran, taken CALLs and RETs included.
+        uint32_t ran = lanes->group;
+        State8080 *leader = lanes->cpus[__builtin_ctz(ran)];
+        uint32_t leader_cycles = leader->cycle_count + lanes->group_cycles;
+        run_group(lanes);
+        if (lanes->group == ran)
+        {
+            headroom -= leader->cycle_count + lanes->group_cycles - leader_cycles;
+        }
+        else
+        {
+            headroom = 0;
+        }
+
+        // The others one by one, joining the group when they get to it.
+        for (uint32_t loose = running & ~lanes->group; loose != 0; loose &= loose - 1)
+        {
+            int i = __builtin_ctz(loose);
+            State8080 *cpu = lanes->cpus[i];
+            if (cpu->cycle_count - lanes->start[i] >= cycle_budget)
+            {
+                running &= ~(1u << i);
+                continue;
+            }
+            emulate_8080_op(cpu);
+            lanes->stats.scalar_instructions++;
+            // Signed, a lane the step took over its budget must not join.
+            int64_t lane_headroom = (int64_t)cycle_budget - (cpu->cycle_count - lanes->start[i]);
+            if (headroom > 0 && cpu->pc == lanes->group_pc && lane_headroom > 0)
+            {
+                settle_cycles(lanes);
+                load_lane(lanes, i);
+                lanes->group |= 1u << i;
+                headroom = lane_headroom < headroom ? lane_headroom : headroom;
+            }
+        }
+    }
+}
+
+const Lanes8080Stats *lanes_8080_stats(const Lanes8080 *lanes)
+{
+    return &lanes->stats;
+}
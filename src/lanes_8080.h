@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include "8080.h"
+
+// Experimental: runs up to LANES_8080 CPUs running the same ROM side by
+// side, as many as there are bytes in a vector register. Their registers
+// are kept as one vector per register, a lane per CPU, and while CPUs are
+// at the same address one instruction runs for all of them in vector
+// operations. A CPU elsewhere runs emulate_8080_op on its
+// own and joins back in once its pc matches again. Loads, stores and I/O
+// go through each CPU, and the instructions without a vector version
+// (HLT, DAA, an EI that lets an interrupt in) run on each CPU on its own.
+// Needs the GCC/Clang vector extensions.
+//
+// HLE hooks, idle skipping and probes don't apply. Code in pages the CPUs
+// don't all read from the same memory is compared before it runs across
+// them; the memory maps are looked at once per slice.
+#ifdef __AVX2__
+#define LANES_8080 32
+#else
+#define LANES_8080 16
+#endif
+
+typedef struct Lanes8080 Lanes8080;
+
+typedef struct Lanes8080Stats
+{
+    uint64_t vector_steps;        // instructions run across lanes at once
+    uint64_t vector_instructions; // CPU instructions those retired
+    uint64_t scalar_instructions; // CPU instructions run on their own
+} Lanes8080Stats;
+
+Lanes8080 *init_lanes_8080(State8080 *const *cpus, int count);
+void free_lanes_8080(Lanes8080 *lanes);
+// Runs every CPU for a slice like emulate_8080_run(cpu, cycle_budget).
+// Between slices the CPUs are in their State8080, e.g. for interrupts.
+void lanes_8080_run(Lanes8080 *lanes, uint32_t cycle_budget);
+const Lanes8080Stats *lanes_8080_stats(const Lanes8080 *lanes);
@@ -1,103 +1,775 @@
+#define _GNU_SOURCE
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <SDL.h>
 #include "machine.h"
+#include "machine_bus.h"
 #include "8080.h"
 
-Machine *init_machine(void)
+#define ROM_SIZE MACHINE_ROM_SIZE
+#define RAM_SIZE 0x2000
+#define ROM_FILE_SIZE 0x800
+#define WATCHDOG_FRAMES 255
+// Pages copied from a fork are allocated this many at a time.
+#define COPY_PAGES 4
+
+// The ROM files in address order, with the CRC32 of the original dump.
+static const struct
+{
+    const char *name;
+    uint32_t crc32;
+} rom_files[ROM_SIZE / ROM_FILE_SIZE] = {
+    {"invaders.h", 0x734f5ad8},
+    {"invaders.g", 0x6bfaca4a},
+    {"invaders.f", 0x0ccead96},
+    {"invaders.e", 0x14e538b0},
+};
+
+// What a machine with the ROM protected looked like when the running slice
+// started, for the SIGSEGV handler and the replay.
+struct MachineTrap
+{
+    sigjmp_buf jump;
+    volatile sig_atomic_t address; // of the store that faulted
+    uint16_t replayed_pc;          // the instruction the replay is stepping
+    Machine machine;
+    State8080 cpu;
+    Scheduler scheduler;
+    uint8_t ram[RAM_SIZE];
+};
+
+// The machine machine_run is running on this thread, which a fault on it
+// comes from.
+static _Thread_local Machine *running_machine;
+
+static MachineRam *alloc_ram(uint32_t pages)
+{
+    MachineRam *ram = calloc(1, sizeof(MachineRam) + pages * 0x100);
+    ram->size = pages;
+    return ram;
+}
+
+static uint8_t *page_bytes(const Machine *machine, int index)
+{
+    return &machine->ram[index]->bytes[machine->slot[index] * 0x100];
+}
+
+static uint32_t *page_refs(Machine *machine, int index)
+{
+    return &machine->ram[index]->refs[machine->slot[index]];
+}
+
+static void copy_on_write(void *data, uint16_t address, uint8_t value);
+
+// Maps RAM page `index` at 0x2000 and every mirror up to the top of the
+// address space, in a memory map of the machine's own. Stores to a page a
+// fork shares go to copy_on_write.
+static void map_ram_page(Machine *machine, int index)
+{
+    uint8_t *bytes = page_bytes(machine, index);
+    uint8_t *write = *page_refs(machine, index) == 1 ? bytes : NULL;
+    map_8080_mirrored(machine->cpu, ROM_SIZE + index * 0x100, 0x100, RAM_SIZE, bytes, write,
+                      write == NULL ? copy_on_write : NULL);
+}
+
+// Gives the machine a memory map of its own in place of the ROM's, one it
+// can change.
+static void own_map(Machine *machine)
+{
+    State8080 *cpu = machine->cpu;
+    if (cpu->map == machine->rom->map)
+    {
+        cpu->map = malloc(sizeof(MemoryMap8080));
+        *cpu->map = *machine->rom->map;
+        for (int i = 0; i < MACHINE_RAM_PAGES; i++)
+        {
+            map_ram_page(machine, i);
+        }
+    }
+}
+
+// 8K of ROM, every machine reads it from the same shared copy. Unless
+// protected, stores to it fall through to the bus, machine_write_byte.
+static void map_machine_rom(Machine *machine)
+{
+    own_map(machine);
+    State8080 *cpu = machine->cpu;
+    uint8_t *rom_write = machine->rom_protected ? cpu->memory : NULL;
+    // Without mirrors, once in the address space.
+    map_8080_mirrored(cpu, 0x0000, ROM_SIZE, 0x10000, cpu->memory, rom_write, NULL);
+}
+
+static void release_page(Machine *machine, int index)
+{
+    MachineRam *ram = machine->ram[index];
+    if (--*page_refs(machine, index) != 0)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < ram->used; i++)
+    {
+        if (ram->refs[i] != 0)
+        {
+            return;
+        }
+    }
+    // Never a machine's `own`, which holds the last page it copied.
+    free(ram);
+}
+
+// Makes RAM page `index` the machine's own to store to, copying it into
+// its `own` block when a fork still shares it, and returns its bytes.
+static uint8_t *own_page(Machine *machine, int index)
+{
+    if (*page_refs(machine, index) > 1)
+    {
+        MachineRam *own = machine->own;
+        if (own == NULL || own->used == own->size)
+        {
+            own = alloc_ram(COPY_PAGES);
+            machine->own = own;
+        }
+        uint32_t slot = own->used++;
+        own->refs[slot] = 1;
+        memcpy(&own->bytes[slot * 0x100], page_bytes(machine, index), 0x100);
+        release_page(machine, index);
+        machine->ram[index] = own;
+        machine->slot[index] = slot;
+        map_ram_page(machine, index);
+    }
+    else if (machine->cpu->map->write[(ROM_SIZE >> 8) + index] == NULL)
+    {
+        // The forks that shared it copied it already.
+        map_ram_page(machine, index);
+    }
+    return page_bytes(machine, index);
+}
+
+// The first store to a shared page, at any mirror.
+static void copy_on_write(void *data, uint16_t address, uint8_t value)
+{
+    Machine *machine = (Machine *)data;
+    own_page(machine, ((address - ROM_SIZE) >> 8) % MACHINE_RAM_PAGES);
+    write_8080(machine->cpu, address, value);
+}
+
+static uint32_t crc32(const uint8_t *data, uint32_t size)
+{
+    uint32_t crc = 0xffffffff;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+MachineRom *init_machine_rom(const uint8_t *image, uint32_t size, bool any_image)
+{
+    if (size != ROM_SIZE)
+    {
+        printf("error: The ROM is 0x%x bytes instead of 0x%x\n", size, ROM_SIZE);
+        exit(1);
+    }
+    bool original = true;
+    for (int i = 0; i < ROM_SIZE / ROM_FILE_SIZE; i++)
+    {
+        uint32_t crc = crc32(&image[i * ROM_FILE_SIZE], ROM_FILE_SIZE);
+        if (crc != rom_files[i].crc32)
+        {
+            fprintf(stderr, "%s: %s has CRC32 %08x instead of %08x, not the original ROM\n",
+                    any_image ? "warning" : "error", rom_files[i].name, crc, rom_files[i].crc32);
+            original = false;
+        }
+    }
+    if (!original && !any_image)
+    {
+        exit(1);
+    }
+
+    // One mapping for every machine, in which the zeros above the ROM take
+    // no memory.
+    MachineRom *rom = malloc(sizeof(MachineRom));
+    rom->crc32 = crc32(image, ROM_SIZE);
+    rom->space = mmap(NULL, 0x10000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    rom->read_only = rom->space != MAP_FAILED;
+    if (!rom->read_only)
+    {
+        rom->space = calloc(1, 0x10000);
+    }
+    memcpy(rom->space, image, ROM_SIZE);
+    rom->read_only = rom->read_only && mprotect(rom->space, 0x10000, PROT_READ) == 0;
+
+    // Laid out on a CPU of its own, which goes once the map is taken.
+    State8080 *layout = init_8080_on(rom->space);
+    map_8080_mirrored(layout, ROM_SIZE, RAM_SIZE, RAM_SIZE, own_8080(0), own_8080(0), NULL);
+    rom->map = layout->map;
+    layout->memory = NULL;
+    layout->map = NULL;
+    free_8080(layout);
+    return rom;
+}
+
+MachineRom *load_machine_rom(const char *directory, bool any_image)
+{
+    uint8_t image[ROM_SIZE];
+    for (int i = 0; i < ROM_SIZE / ROM_FILE_SIZE; i++)
+    {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", directory, rom_files[i].name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL)
+        {
+            printf("error: Couldn't open %s\n", path);
+            exit(1);
+        }
+        size_t size = fread(&image[i * ROM_FILE_SIZE], 1, ROM_FILE_SIZE, f);
+        bool longer = fgetc(f) != EOF;
+        fclose(f);
+        if (size != ROM_FILE_SIZE || longer)
+        {
+            printf("error: %s isn't 0x%x bytes\n", path, ROM_FILE_SIZE);
+            exit(1);
+        }
+    }
+    return init_machine_rom(image, ROM_SIZE, any_image);
+}
+
+// The board keeps both interrupts and the watchdog on the timeline, which
+// SCHEDULER_MAX_EVENTS leaves room for others next to.
+static void schedule(Machine *machine, uint64_t due, EventHandler handler)
+{
+    if (!scheduler_add(machine->scheduler, due, handler, machine))
+    {
+        fprintf(stderr, "error: The machine's timeline is full\n");
+        exit(1);
+    }
+}
+
+// The CPU holds a request it can't take yet until EI, see
+// request_interrupt_8080.
+static void mid_screen(void *data, uint64_t due)
+{
+    (void)due;
+    request_interrupt_8080(((Machine *)data)->cpu, 1);
+}
+
+// Each vblank lays out the next frame, at the clock set by then.
+static void vblank(void *data, uint64_t due)
+{
+    Machine *machine = (Machine *)data;
+    machine->frames++;
+    request_interrupt_8080(machine->cpu, 2);
+    schedule(machine, due + machine->half_frame_cycles, mid_screen);
+    schedule(machine, due + 2 * machine->half_frame_cycles, vblank);
+    if (machine->on_vblank != NULL)
+    {
+        machine->on_vblank(machine);
+    }
+}
+
+static uint64_t watchdog_cycles(const Machine *machine)
+{
+    return WATCHDOG_FRAMES * 2 * (uint64_t)machine->half_frame_cycles;
+}
+
+static void watchdog(void *data, uint64_t due)
+{
+    Machine *machine = (Machine *)data;
+    if (!machine->watchdog_fed)
+    {
+        fprintf(stderr, "Watchdog reset at pc 0x%04x\n", machine->cpu->pc);
+        machine->cpu->pc = 0;
+        machine->cpu->int_enable = 0;
+        machine->cpu->held_interrupt = 0;
+    }
+    machine->watchdog_fed = false;
+    schedule(machine, due + watchdog_cycles(machine), watchdog);
+}
+
+void machine_start_watchdog(Machine *machine)
+{
+    machine->watchdog_fed = false;
+    schedule(machine, machine->scheduler->now + watchdog_cycles(machine), watchdog);
+}
+
+// The board's event handlers, by their kind in a snapshot.
+static const EventHandler event_kinds[] = {mid_screen, vblank, watchdog};
+#define EVENT_KINDS (int)(sizeof(event_kinds) / sizeof(event_kinds[0]))
+
+_Static_assert(sizeof(MachineSnapshot) == 208 + RAM_SIZE, "snapshot layout changed");
+
+// The kind of one of the machine's events, EVENT_KINDS for one from
+// outside the board.
+static int event_kind(const Machine *machine, const Event *event)
+{
+    int kind = 0;
+    while (kind < EVENT_KINDS && event_kinds[kind] != event->handler)
+    {
+        kind++;
+    }
+    return event->data == machine ? kind : EVENT_KINDS;
+}
+
+void machine_read(const Machine *machine, uint16_t address, uint32_t size, uint8_t *to)
+{
+    while (size > 0)
+    {
+        uint32_t chunk = 0x100 - (address & 0xff);
+        chunk = chunk < size ? chunk : size;
+        const State8080 *cpu = machine->cpu;
+        memcpy(to, &page_8080(cpu, cpu->map->read[address >> 8])[address & 0xff], chunk);
+        address += chunk;
+        to += chunk;
+        size -= chunk;
+    }
+}
+
+// Puts all of RAM back from `ram`, into pages of the machine's own.
+static void load_ram(Machine *machine, const uint8_t *ram)
+{
+    for (int i = 0; i < MACHINE_RAM_PAGES; i++)
+    {
+        memcpy(own_page(machine, i), &ram[i * 0x100], 0x100);
+    }
+}
+
+bool machine_snapshot(Machine *machine, MachineSnapshot *snapshot)
+{
+    State8080 *cpu = machine->cpu;
+    Scheduler *scheduler = machine->scheduler;
+    for (int i = 0; i < scheduler->count; i++)
+    {
+        Event *event = &scheduler->events[i];
+        int kind = event_kind(machine, event);
+        if (kind == EVENT_KINDS)
+        {
+            return false;
+        }
+        snapshot->events[i] = (MachineSnapshotEvent){event->due, event->order, kind, {0}};
+    }
+
+    memcpy(snapshot->magic, "SI80", 4);
+    snapshot->version = MACHINE_SNAPSHOT_VERSION;
+    snapshot->size = sizeof(MachineSnapshot);
+    snapshot->rom_crc32 = machine->rom->crc32;
+
+    snapshot->sp = cpu->sp;
+    snapshot->pc = cpu->pc;
+    snapshot->a = cpu->a;
+    snapshot->b = cpu->b;
+    snapshot->c = cpu->c;
+    snapshot->d = cpu->d;
+    snapshot->e = cpu->e;
+    snapshot->h = cpu->h;
+    snapshot->l = cpu->l;
+    snapshot->psw = get_psw_8080(cpu);
+    snapshot->int_enable = cpu->int_enable;
+    snapshot->cycle_count = cpu->cycle_count;
+
+    snapshot->in_port_1 = machine->in_port_1;
+    snapshot->in_port_2 = machine->in_port_2;
+    snapshot->out_port_3 = machine->out_port_3;
+    snapshot->out_port_5 = machine->out_port_5;
+    snapshot->shift_high = machine->shift_high;
+    snapshot->shift_low = machine->shift_low;
+    snapshot->shift_offset = machine->shift_offset;
+    snapshot->held_interrupt = cpu->held_interrupt;
+    snapshot->watchdog_fed = machine->watchdog_fed;
+    snapshot->event_count = scheduler->count;
+    snapshot->reserved = 0;
+    snapshot->half_frame_cycles = machine->half_frame_cycles;
+    snapshot->clock_multiplier = machine->clock_multiplier;
+    snapshot->frames = machine->frames;
+
+    snapshot->now = scheduler->now;
+    snapshot->scheduled = scheduler->scheduled;
+    snapshot->reserved2 = 0;
+    machine_read(machine, ROM_SIZE, RAM_SIZE, snapshot->ram);
+    return true;
+}
+
+bool machine_restore(Machine *machine, const MachineSnapshot *snapshot)
+{
+    if (memcmp(snapshot->magic, "SI80", 4) != 0 || snapshot->version != MACHINE_SNAPSHOT_VERSION ||
+        snapshot->size != sizeof(MachineSnapshot) || snapshot->rom_crc32 != machine->rom->crc32 ||
+        snapshot->event_count > SCHEDULER_MAX_EVENTS)
+    {
+        return false;
+    }
+    for (int i = 0; i < snapshot->event_count; i++)
+    {
+        if (snapshot->events[i].kind >= EVENT_KINDS)
+        {
+            return false;
+        }
+    }
+
+    State8080 *cpu = machine->cpu;
+    cpu->sp = snapshot->sp;
+    cpu->pc = snapshot->pc;
+    cpu->a = snapshot->a;
+    cpu->b = snapshot->b;
+    cpu->c = snapshot->c;
+    cpu->d = snapshot->d;
+    cpu->e = snapshot->e;
+    cpu->h = snapshot->h;
+    cpu->l = snapshot->l;
+    set_psw_8080(cpu, snapshot->psw);
+    cpu->int_enable = snapshot->int_enable;
+    cpu->cycle_count = snapshot->cycle_count;
+
+    machine->in_port_1 = snapshot->in_port_1;
+    machine->in_port_2 = snapshot->in_port_2;
+    machine->out_port_3 = snapshot->out_port_3;
+    machine->out_port_5 = snapshot->out_port_5;
+    machine->shift_high = snapshot->shift_high;
+    machine->shift_low = snapshot->shift_low;
+    machine->shift_offset = snapshot->shift_offset;
+    cpu->held_interrupt = snapshot->held_interrupt;
+    machine->watchdog_fed = snapshot->watchdog_fed;
+    machine->half_frame_cycles = snapshot->half_frame_cycles;
+    machine->clock_multiplier = snapshot->clock_multiplier;
+    machine->frames = snapshot->frames;
+
+    // Stored in heap order, so the events go back as they are.
+    Scheduler *scheduler = machine->scheduler;
+    scheduler->now = snapshot->now;
+    scheduler->scheduled = snapshot->scheduled;
+    scheduler->count = snapshot->event_count;
+    for (int i = 0; i < snapshot->event_count; i++)
+    {
+        const MachineSnapshotEvent *event = &snapshot->events[i];
+        scheduler->events[i] = (Event){event->due, event->order, event_kinds[event->kind], machine};
+    }
+
+    load_ram(machine, snapshot->ram);
+    return true;
+}
+
+bool machine_save_snapshot(const MachineSnapshot *snapshot, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    bool written = fwrite(snapshot, sizeof(MachineSnapshot), 1, f) == 1;
+    return fclose(f) == 0 && written;
+}
+
+const MachineSnapshot *machine_map_snapshot(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat info;
+    MachineSnapshot *snapshot = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size == sizeof(MachineSnapshot))
+    {
+        snapshot = mmap(NULL, sizeof(MachineSnapshot), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (snapshot == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (memcmp(snapshot->magic, "SI80", 4) != 0 || snapshot->version != MACHINE_SNAPSHOT_VERSION)
+    {
+        munmap(snapshot, sizeof(MachineSnapshot));
+        return NULL;
+    }
+    return snapshot;
+}
+
+void machine_unmap_snapshot(const MachineSnapshot *snapshot)
+{
+    munmap((void *)snapshot, sizeof(MachineSnapshot));
+}
+
+double machine_set_clock(Machine *machine, double multiplier)
+{
+    if (multiplier < MACHINE_MIN_CLOCK)
+    {
+        multiplier = MACHINE_MIN_CLOCK;
+    }
+    else if (multiplier > MACHINE_MAX_CLOCK)
+    {
+        multiplier = MACHINE_MAX_CLOCK;
+    }
+    machine->clock_multiplier = multiplier;
+    machine->half_frame_cycles = (uint32_t)(MACHINE_CYCLES_PER_HALF_FRAME * multiplier);
+    return multiplier;
+}
+
+// A machine on `rom`, with its CPU, on the ROM's memory map, and timeline,
+// the rest for the caller to set.
+static Machine *alloc_machine(const MachineRom *rom)
 {
-    State8080 *cpu = init_8080();
     Machine *machine = malloc(sizeof(Machine));
+    machine->cpu = init_8080_on(rom->space);
+    free(machine->cpu->map);
+    machine->cpu->map = rom->map;
+    machine->rom = rom;
+    machine->rom_protected = false;
+    machine->trap = NULL;
+    machine->scheduler = init_scheduler();
+    return machine;
+}
+
+Machine *init_machine(const MachineRom *rom)
+{
+    Machine *machine = alloc_machine(rom);
+    machine->own = alloc_ram(MACHINE_RAM_PAGES);
+    machine->own->used = MACHINE_RAM_PAGES;
+    machine->cpu->own = machine->own->bytes;
+    for (int i = 0; i < MACHINE_RAM_PAGES; i++)
+    {
+        machine->own->refs[i] = 1;
+        machine->ram[i] = machine->own;
+        machine->slot[i] = i;
+    }
     machine->in_port_1 = 0x08;
     machine->in_port_2 = 0;
+    machine->out_port_3 = 0;
+    machine->out_port_5 = 0;
 
     machine->shift_high = 0;
     machine->shift_low = 0;
     machine->shift_offset = 0;
-    machine->cpu = cpu;
-
+    machine->hooks = NULL;
+    machine->watchdog_fed = false;
+    machine->frames = 0;
+    machine->on_vblank = NULL;
+    machine_set_clock(machine, 1.0);
+    schedule(machine, MACHINE_CYCLES_PER_HALF_FRAME, mid_screen);
+    schedule(machine, MACHINE_CYCLES_PER_FRAME, vblank);
     return machine;
 }
 
-void read_file_into_memory_at(Machine *machine, char *filename, uint32_t offset)
+Machine *machine_fork(Machine *parent)
 {
-    FILE *f = fopen(filename, "rb");
-    if (f == NULL)
+    for (int i = 0; i < parent->scheduler->count; i++)
     {
-        printf("error: Couldn't open %s\n", filename);
-        exit(1);
+        if (event_kind(parent, &parent->scheduler->events[i]) == EVENT_KINDS)
+        {
+            return NULL;
+        }
+    }
+
+    // The pages the parent had to itself are shared from now on, stores to
+    // them from either machine copy them first.
+    own_map(parent);
+    for (int i = 0; i < MACHINE_RAM_PAGES; i++)
+    {
+        if ((*page_refs(parent, i))++ == 1)
+        {
+            map_ram_page(parent, i);
+        }
+    }
+    Machine *machine = alloc_machine(parent->rom);
+    memcpy(machine->ram, parent->ram, sizeof(machine->ram));
+    memcpy(machine->slot, parent->slot, sizeof(machine->slot));
+    machine->own = NULL;
+    machine->cpu->map = malloc(sizeof(MemoryMap8080));
+    *machine->cpu->map = *parent->cpu->map;
+    // Only the parent has the ROM protected.
+    if (parent->rom_protected)
+    {
+        map_machine_rom(machine);
     }
 
-    fseek(f, 0L, SEEK_END);
-    int fsize = ftell(f);
-    fseek(f, 0L, SEEK_SET);
+    State8080 *from = parent->cpu;
+    State8080 *cpu = machine->cpu;
+    cpu->sp = from->sp;
+    cpu->pc = from->pc;
+    cpu->a = from->a;
+    cpu->b = from->b;
+    cpu->c = from->c;
+    cpu->d = from->d;
+    cpu->e = from->e;
+    cpu->h = from->h;
+    cpu->l = from->l;
+    set_psw_8080(cpu, get_psw_8080(from));
+    cpu->int_enable = from->int_enable;
+    cpu->held_interrupt = from->held_interrupt;
+    cpu->cycle_count = from->cycle_count;
+    cpu->hooks = from->hooks;
+    cpu->skip_idle = from->skip_idle;
+    cpu->user_data = machine;
+    cpu->write_byte = from->write_byte;
+    cpu->port_input = from->port_input;
+    cpu->port_output = from->port_output;
 
-    uint8_t *buffer = &machine->cpu->memory[offset];
-    fread(buffer, fsize, 1, f);
-    fclose(f);
+    machine->in_port_1 = parent->in_port_1;
+    machine->in_port_2 = parent->in_port_2;
+    machine->out_port_3 = parent->out_port_3;
+    machine->out_port_5 = parent->out_port_5;
+    machine->shift_high = parent->shift_high;
+    machine->shift_low = parent->shift_low;
+    machine->shift_offset = parent->shift_offset;
+    machine->hooks = parent->hooks;
+    machine->watchdog_fed = parent->watchdog_fed;
+    machine->clock_multiplier = parent->clock_multiplier;
+    machine->half_frame_cycles = parent->half_frame_cycles;
+    machine->frames = parent->frames;
+    machine->on_vblank = parent->on_vblank;
+
+    *machine->scheduler = *parent->scheduler;
+    for (int i = 0; i < machine->scheduler->count; i++)
+    {
+        machine->scheduler->events[i].data = machine;
+    }
+    return machine;
 }
 
-void machine_write_byte(void *data, uint16_t address, uint8_t value)
+void free_machine(Machine *machine)
+{
+    for (int i = 0; i < MACHINE_RAM_PAGES; i++)
+    {
+        release_page(machine, i);
+    }
+    free(machine->trap);
+    machine->cpu->memory = NULL; // the ROM's
+    if (machine->cpu->map == machine->rom->map)
+    {
+        machine->cpu->map = NULL;
+    }
+    free_8080(machine->cpu);
+    free(machine->scheduler);
+    free(machine);
+}
+
+static void rom_write_trapped(int signal_number, siginfo_t *info, void *context)
 {
-    State8080 *state = (State8080 *)data;
+    (void)context;
+    uint8_t *address = info->si_addr;
+    Machine *machine = running_machine;
+    uint8_t *memory = machine != NULL && machine->trap != NULL ? machine->cpu->memory : NULL;
+    if (memory == NULL || address < memory || address >= memory + ROM_SIZE)
+    {
+        // A genuine crash: returning faults again, this time fatally.
+        signal(signal_number, SIG_DFL);
+        return;
+    }
+    machine->trap->address = address - memory;
+    siglongjmp(machine->trap->jump, 1);
+}
 
-    if ((address >= 0x2000) && (address < 0x4000))
+bool machine_protect_rom(Machine *machine)
+{
+    if (!machine->rom->read_only)
     {
-        state->memory[address] = value;
+        return false;
     }
-    else
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = rom_write_trapped;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, NULL);
+#ifdef __APPLE__
+    sigaction(SIGBUS, &action, NULL);
+#endif
+
+    machine->rom_protected = true;
+    map_machine_rom(machine);
+    if (machine->trap == NULL)
     {
-        fprintf(stderr, "Attempted to write to ROM\n");
-        exit(1);
+        machine->trap = malloc(sizeof(struct MachineTrap));
     }
+    return true;
 }
 
-uint8_t machine_in(void *data, uint8_t port_number)
+static void replayed_rom_write(void *data, uint16_t address, uint8_t value)
 {
-    Machine *machine = (Machine *)data;
-    uint8_t a = 0xff;
+    (void)value;
+    fprintf(stderr, "Attempted to write to ROM at 0x%04x (pc 0x%04x)\n", address,
+            ((Machine *)data)->trap->replayed_pc);
+    exit(1);
+}
+
+void machine_rom_write(Machine *machine, uint16_t address)
+{
+    // Cores keep the registers to themselves for a slice, this is the pc
+    // it started at.
+    fprintf(stderr, "Attempted to write to ROM at 0x%04x (slice from pc 0x%04x)\n", address,
+            machine->cpu->pc);
+    exit(1);
+}
 
-    switch (port_number)
+uint32_t machine_run(Machine *machine, uint32_t (*run)(void *, uint32_t), void *core,
+                     uint32_t cycle_budget)
+{
+    struct MachineTrap *trap = machine->trap;
+    if (trap == NULL)
     {
-    case 0:
-        break;
-    case 1:
-        a = machine->in_port_1;
-        break;
-    case 2:
-        a = machine->in_port_2;
-        break;
-    case 3:
+        return run(core, cycle_budget);
+    }
+
+    State8080 *cpu = machine->cpu;
+    trap->machine = *machine;
+    trap->cpu = *cpu;
+    trap->scheduler = *machine->scheduler;
+    machine_read(machine, ROM_SIZE, RAM_SIZE, trap->ram);
+    if (sigsetjmp(trap->jump, 1) == 0)
     {
-        uint16_t shift = (machine->shift_high << 8) | machine->shift_low;
-        a = (shift >> (8 - machine->shift_offset)) & 0xff;
-        break;
+        running_machine = machine;
+        uint32_t ran = run(core, cycle_budget);
+        running_machine = NULL;
+        return ran;
     }
-    default:
-        fprintf(stderr, "error: unknown IN port %02x\n", port_number);
-        exit(1);
-        break;
+
+    // Back from the SIGSEGV handler, the slice stopped somewhere inside a
+    // store. Run it again with checked ROM stores. The RAM pages are the
+    // ones its map has now.
+    running_machine = NULL;
+    Machine now = *machine;
+    *machine = trap->machine;
+    memcpy(machine->ram, now.ram, sizeof(now.ram));
+    memcpy(machine->slot, now.slot, sizeof(now.slot));
+    machine->own = now.own;
+    *cpu = trap->cpu;
+    *machine->scheduler = trap->scheduler;
+    load_ram(machine, trap->ram);
+    map_8080_memory(cpu, 0x0000, ROM_SIZE, cpu->memory, NULL, replayed_rom_write);
+    uint32_t start = cpu->cycle_count;
+    while (cpu->cycle_count - start < cycle_budget)
+    {
+        trap->replayed_pc = cpu->pc;
+        emulate_8080_op(cpu);
     }
+    fprintf(stderr, "Attempted to write to ROM at 0x%04x\n", (unsigned)trap->address);
+    exit(1);
+}
+
+void machine_write_byte(void *data, uint16_t address, uint8_t value)
+{
+    machine_bus_write((Machine *)data, address, value);
+}
 
-    return a;
+uint8_t machine_in(void *data, uint8_t port_number)
+{
+    return machine_bus_in((Machine *)data, port_number);
 }
 
 void machine_out(void *data, uint8_t port_number, uint8_t value)
 {
-    Machine *machine = (Machine *)data;
-    switch (port_number)
-    {
-    case 2:
-        // The first three bits of the `a` register are stored into
-        // the shift register offset.
-        machine->shift_offset = value & 0x7;
-        break;
-    case 4:
-        machine->shift_low = machine->shift_high;
-        machine->shift_high = value;
-        break;
-    }
-    return;
+    machine_bus_out((Machine *)data, port_number, value);
 }
 
 void machine_handle_key_down(Machine *machine, SDL_KeyCode key)
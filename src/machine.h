@@ -1,19 +1,183 @@
 #pragma once
 #include <stdint.h>
+#include <stdbool.h>
+#include <SDL.h>
 #include "8080.h"
+#include "scheduler.h"
+
+#define MACHINE_CLOCK_SPEED 1996800
+#define MACHINE_FPS 59.541985
+// RST 1 comes mid-screen and RST 2 at vblank, half a frame apart.
+#define MACHINE_CYCLES_PER_HALF_FRAME ((uint32_t)(MACHINE_CLOCK_SPEED / MACHINE_FPS / 2))
+#define MACHINE_CYCLES_PER_FRAME (2 * MACHINE_CYCLES_PER_HALF_FRAME)
+#define MACHINE_MIN_CLOCK 0.125
+#define MACHINE_MAX_CLOCK 256.0
+// The 8K of RAM in pages of the CPU's memory map.
+#define MACHINE_RAM_PAGES (0x2000 / 0x100)
+
+// The ROM set, loaded once per process and shared read only by every
+// machine made from it.
+typedef struct MachineRom
+{
+    // The 64K address space as the machines' CPUs fetch code from it, their
+    // `cpu->memory`: the 8K image, then zeros, since RAM is only in each
+    // machine's memory map.
+    uint8_t *space;
+    // The memory map of every machine that hasn't forked: ROM, and RAM at
+    // 0x2000 and every mirror in the machine's own block, see own_8080.
+    MemoryMap8080 *map;
+    bool read_only; // `space` is mapped read only, see machine_protect_rom
+    uint32_t crc32; // of the whole image
+} MachineRom;
+
+// RAM pages in one block: a machine's 8K, all its pages in order, or the
+// pages it copied from a fork. Forks share pages copy-on-write, see
+// machine_fork: `refs` counts the machines mapping each, and the block is
+// freed once none does.
+typedef struct MachineRam
+{
+    uint32_t size; // pages in `bytes`
+    uint32_t used; // pages handed out, the rest is for copies to come
+    uint32_t refs[MACHINE_RAM_PAGES];
+    uint8_t bytes[];
+} MachineRam;
 
 typedef struct Machine
 {
     uint8_t in_port_1, in_port_2;
-    uint8_t out_port_3, out_port_5;
+    uint8_t out_port_3, out_port_5; // sound latches
     uint8_t shift_high, shift_low, shift_offset;
     State8080 *cpu;
+    const MachineRom *rom;
+    bool rom_protected;
+    struct MachineTrap *trap; // the slice's start, with the ROM protected
+    Hook8080 *hooks; // HLE hooks, see hle.h
+    // RAM page i is page `slot[i]` of block `ram[i]`. Copies of pages a
+    // fork shares go to `own`, a new block once it is full. A machine that
+    // never forked has all its pages in order in `own` and the ROM's memory
+    // map.
+    MachineRam *ram[MACHINE_RAM_PAGES];
+    uint8_t slot[MACHINE_RAM_PAGES];
+    MachineRam *own;
+    // The board's timeline, with both interrupts on it from power on. Run
+    // slices of scheduler_cycles_to_next() and pass what ran to
+    // scheduler_advance().
+    Scheduler *scheduler;
+    bool watchdog_fed;         // OUT 6 since the watchdog last looked
+    double clock_multiplier;
+    uint32_t half_frame_cycles; // CPU cycles between interrupts at that clock
+    uint64_t frames;            // vblanks since power on
+    // Called at each vblank once RST 2 is requested, e.g. to draw the
+    // screen. NULL for none.
+    void (*on_vblank)(struct Machine *machine);
 } Machine;
 
+#define MACHINE_SNAPSHOT_VERSION 2
+
+typedef struct MachineSnapshotEvent
+{
+    uint64_t due;
+    uint32_t order;
+    uint8_t kind; // which of the board's handlers, see machine.c
+    uint8_t reserved[3];
+} MachineSnapshotEvent;
+
+// Everything about a machine that changes as it runs, with fixed size
+// fields and no pointers, so it is copied, written to disk and mapped back
+// as it is (in host byte order). The ROM never changes, only its CRC32 is
+// kept to refuse a snapshot of another ROM.
+typedef struct MachineSnapshot
+{
+    char magic[4];    // "SI80"
+    uint32_t version; // MACHINE_SNAPSHOT_VERSION
+    uint32_t size;    // sizeof(MachineSnapshot)
+    uint32_t rom_crc32;
+    // CPU
+    uint16_t sp, pc;
+    uint8_t a, b, c, d, e, h, l, psw;
+    uint8_t int_enable;
+    // Board
+    uint8_t in_port_1, in_port_2, out_port_3, out_port_5;
+    uint8_t shift_high, shift_low, shift_offset;
+    uint8_t held_interrupt;
+    uint8_t watchdog_fed;
+    uint8_t event_count;
+    uint8_t reserved;
+    uint32_t cycle_count;
+    uint32_t half_frame_cycles;
+    double clock_multiplier;
+    uint64_t frames;
+    // Timeline
+    uint64_t now;
+    uint32_t scheduled;
+    uint32_t reserved2;
+    MachineSnapshotEvent events[SCHEDULER_MAX_EVENTS];
+    uint8_t ram[0x2000];
+} MachineSnapshot;
+
 void machine_write_byte(void *data, uint16_t address, uint8_t value);
+// Reports a store to ROM, from the bus, with the pc the slice started at,
+// and exits.
+void machine_rom_write(Machine *machine, uint16_t address);
 uint8_t machine_in(void *machine, uint8_t port_number);
 void machine_out(void *machine, uint8_t port_number, uint8_t value);
 void machine_handle_key_down(Machine *machine, SDL_KeyCode key);
 void machine_handle_key_up(Machine *machine, SDL_KeyCode key);
-void read_file_into_memory_at(Machine *machine, char *filename, uint32_t offset);
-Machine *init_machine(void);
+// Loads invaders.h, .g, .f and .e from `directory`. Each file must be 2K
+// and the original dump, by its CRC32: another ROM is an error, or only a
+// warning with `any_image` set.
+MachineRom *load_machine_rom(const char *directory, bool any_image);
+// The same from an 8K image already in memory.
+MachineRom *init_machine_rom(const uint8_t *image, uint32_t size, bool any_image);
+// A machine running `rom`. Its CPU fetches code from the ROM's shared
+// address space, so it only runs code from ROM, and its 8K of RAM is a
+// block of its own, mapped at every mirror: read it through the memory map
+// (read_8080, machine_read) or a snapshot, not `cpu->memory`. The RAM is
+// all the memory a machine has of its own, with its registers and timeline,
+// about 9K; the memory map is the ROM's until it forks or protects the ROM.
+// Built with DECODE_CACHE, each CPU also has 512K of decoded instructions:
+// leave it out for many machines.
+Machine *init_machine(const MachineRom *rom);
+// A new machine in the same state as `parent`, sharing its RAM pages: they
+// are only copied when one of the two stores to them. Forking copies the
+// page map and counts references, the first fork after the parent stored
+// also maps those pages copy-on-write in the parent. Both then have memory
+// maps of their own. Returns NULL when the
+// parent's timeline holds an event from outside the board.
+Machine *machine_fork(Machine *parent);
+// Copies `size` bytes of the address space from `address` on to `to`,
+// through the memory map, which RAM is only in.
+void machine_read(const Machine *machine, uint16_t address, uint32_t size, uint8_t *to);
+// Frees a machine from init_machine or machine_fork. Its ROM and HLE hooks
+// stay, other machines may use them.
+void free_machine(Machine *machine);
+// Has the core store to ROM and RAM alike without any check, a store to
+// the read only ROM mapping then faults instead. Any number of machines
+// may, each run on one thread at a time, their forks keep the check.
+// Returns false when the ROM couldn't be mapped read only.
+bool machine_protect_rom(Machine *machine);
+// Resets the CPU when the game stops writing to port 6 for about 255
+// frames, as the board's watchdog does.
+void machine_start_watchdog(Machine *machine);
+// Gives the CPU `multiplier` times the cycles per frame, with the
+// interrupts still at 59.54 Hz, from the next vblank on. Clamped to
+// MACHINE_MIN_CLOCK..MACHINE_MAX_CLOCK, returns what it set.
+double machine_set_clock(Machine *machine, double multiplier);
+// Copies the machine's state into `snapshot`, allocating nothing. Returns
+// false when its timeline holds an event from outside the board.
+bool machine_snapshot(Machine *machine, MachineSnapshot *snapshot);
+// Puts the machine back in the state of `snapshot`. Returns false,
+// changing nothing, when it isn't a snapshot of this version or was taken
+// on another ROM. Translated code in RAM isn't dropped, see jit_8080.h.
+bool machine_restore(Machine *machine, const MachineSnapshot *snapshot);
+bool machine_save_snapshot(const MachineSnapshot *snapshot, const char *path);
+// Maps a snapshot saved by machine_save_snapshot read only, NULL when the
+// file can't be mapped or isn't one. Release it with machine_unmap_snapshot.
+const MachineSnapshot *machine_map_snapshot(const char *path);
+void machine_unmap_snapshot(const MachineSnapshot *snapshot);
+// Runs a slice on `run`, passed `core`. With the ROM protected, it first
+// saves the machine, and a store to ROM raising SIGSEGV replays the slice
+// one instruction at a time from there to report the instruction that did
+// it, then exits. Machines may run on several threads at once.
+uint32_t machine_run(Machine *machine, uint32_t (*run)(void *, uint32_t), void *core,
+                     uint32_t cycle_budget);
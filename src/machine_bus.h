@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "machine.h"
+
+// The invaders board's memory and port handlers, inline so a core built
+// with BUS_INVADERS can take them in (see bus_8080.h). machine_write_byte,
+// machine_in and machine_out are the callback versions.
+
+#define MACHINE_ROM_SIZE 0x2000
+
+// RAM pages are written through the memory map, this only gets ROM stores
+// from the core.
+static inline void machine_bus_write(Machine *machine, uint16_t address, uint8_t value)
+{
+    if (address >= MACHINE_ROM_SIZE)
+    {
+        write_8080(machine->cpu, address, value);
+    }
+    else
+    {
+        machine_rom_write(machine, address);
+    }
+}
+
+static inline uint8_t machine_bus_in(Machine *machine, uint8_t port_number)
+{
+    uint8_t a = 0xff;
+
+    switch (port_number)
+    {
+    case 0:
+        break;
+    case 1:
+        a = machine->in_port_1;
+        break;
+    case 2:
+        a = machine->in_port_2;
+        break;
+    case 3:
+    {
+        uint16_t shift = (machine->shift_high << 8) | machine->shift_low;
+        a = (shift >> (8 - machine->shift_offset)) & 0xff;
+        break;
+    }
+    default:
+        fprintf(stderr, "error: unknown IN port %02x\n", port_number);
+        exit(1);
+        break;
+    }
+
+    return a;
+}
+
+static inline void machine_bus_out(Machine *machine, uint8_t port_number, uint8_t value)
+{
+    switch (port_number)
+    {
+    case 2:
+        // The first three bits of the `a` register are stored into
+        // the shift register offset.
+        machine->shift_offset = value & 0x7;
+        break;
+    case 3:
+        machine->out_port_3 = value;
+        break;
+    case 4:
+        machine->shift_low = machine->shift_high;
+        machine->shift_high = value;
+        break;
+    case 5:
+        machine->out_port_5 = value;
+        break;
+    case 6:
+        machine->watchdog_fed = true;
+        break;
+    }
+}
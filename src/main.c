@@ -7,16 +7,111 @@
 #include <unistd.h>
 #include "machine.h"
 #include "disassembler_8080.h"
+#include "jit_8080.h"
+#include "hle.h"
+#include "monitor.h"
 #include "renderer.h"
+#include "rewind.h"
 
-#define FPS 59.541985
-#define CLOCK_SPEED 1996800
-#define CYCLES_PER_FRAME (CLOCK_SPEED / FPS)
-#define VIDEO_BITMAP_START 0x2400;
+#define VIDEO_BITMAP_START 0x2400
+// When the host falls behind, as it may on a high clock multiplier, the
+// game slows down instead of running ever longer catch up slices.
+#define MAX_CATCH_UP_MS 100
+// Frames shown ahead at most, each costs a frame of emulation per frame.
+#define MAX_RUN_AHEAD 8
 static uint32_t current_time = 0;
 static uint32_t last_time = 0;
 static uint32_t dt = 0;
 
+static uint32_t run_interpreter(void *cpu, uint32_t cycle_budget)
+{
+    return emulate_8080_run(cpu, cycle_budget);
+}
+
+static uint32_t run_jit(void *jit, uint32_t cycle_budget)
+{
+    return jit_8080_run(jit, cycle_budget);
+}
+
+// Drawn at each vblank, right after RST 2 is requested.
+static void draw_frame(Machine *machine)
+{
+    static uint8_t bitmap[0x4000 - VIDEO_BITMAP_START];
+    machine_read(machine, VIDEO_BITMAP_START, sizeof(bitmap), bitmap);
+    draw_screen(bitmap);
+}
+
+// Host time spent running ahead, see run_ahead.
+static struct
+{
+    uint64_t shown; // frames drawn ahead
+    uint64_t ticks; // SDL performance counter
+} run_ahead_cost;
+
+// Draws the frame `frames` vblanks on from where the machine is, as if the
+// controls stayed as they are, then puts the machine back. The game reads
+// the controls a frame or more before it draws what they did, so the frame
+// shown is that much less behind them. The monitor only sees the frames
+// that count.
+static void run_ahead(Machine *machine, int frames, uint32_t (*run)(void *, uint32_t),
+                      void *core)
+{
+    static MachineSnapshot snapshot;
+    uint64_t start = SDL_GetPerformanceCounter();
+    if (!machine_snapshot(machine, &snapshot))
+    {
+        draw_frame(machine);
+        return;
+    }
+    Probe8080 probe = machine->cpu->probe;
+    machine->cpu->probe = NULL;
+    uint64_t last = machine->frames + frames;
+    while (machine->frames < last)
+    {
+        machine->on_vblank = machine->frames + 1 == last ? draw_frame : NULL;
+        uint32_t ran =
+            machine_run(machine, run, core, scheduler_cycles_to_next(machine->scheduler));
+        scheduler_advance(machine->scheduler, ran);
+    }
+    machine->on_vblank = NULL;
+    machine->cpu->probe = probe;
+    machine_restore(machine, &snapshot);
+    run_ahead_cost.shown++;
+    run_ahead_cost.ticks += SDL_GetPerformanceCounter() - start;
+}
+
+static void report_run_ahead_cost(int frames)
+{
+    if (run_ahead_cost.shown > 0)
+    {
+        double ms =
+            1000.0 * run_ahead_cost.ticks / SDL_GetPerformanceFrequency() / run_ahead_cost.shown;
+        printf("Run-ahead %d: %.3f ms per frame shown, %.3f ms per frame run ahead, %.1f%% of "
+               "the frame time.\n",
+               frames, ms, ms / frames, ms * MACHINE_FPS / 10);
+    }
+}
+
+// Host time spent running slices since the clock multiplier last changed.
+static struct
+{
+    uint64_t frames; // machine->frames when it started
+    uint64_t ticks;  // SDL performance counter
+} frame_cost;
+
+static void report_frame_cost(Machine *machine)
+{
+    uint64_t frames = machine->frames - frame_cost.frames;
+    if (frames > 0)
+    {
+        double ms = 1000.0 * frame_cost.ticks / SDL_GetPerformanceFrequency() / frames;
+        printf("Clock x%g: %.3f ms per frame over %llu frames, %.1f%% of the frame time.\n",
+               machine->clock_multiplier, ms, (unsigned long long)frames, ms * MACHINE_FPS / 10);
+    }
+    frame_cost.frames = machine->frames;
+    frame_cost.ticks = 0;
+}
+
 int main(int argc, char **argv)
 {
     if ((argc > 2) && (strcmp(argv[1], "--disassemble") == 0))
@@ -25,22 +120,96 @@ int main(int argc, char **argv)
     }
     else
     {
-        Machine *machine = init_machine();
-        read_file_into_memory_at(machine, "game_files/invaders.h", 0);
-        read_file_into_memory_at(machine, "game_files/invaders.g", 0x800);
-        read_file_into_memory_at(machine, "game_files/invaders.f", 0x1000);
-        read_file_into_memory_at(machine, "game_files/invaders.e", 0x1800);
+        // Needed before the ROM is loaded, the other options apply to the
+        // machine.
+        bool any_rom = false;
+        for (int i = 1; i < argc; i++)
+        {
+            any_rom = any_rom || strcmp(argv[i], "--any-rom") == 0;
+        }
+        Machine *machine = init_machine(load_machine_rom("game_files", any_rom));
+        analyze_8080_flags(machine->cpu, 0, 0x2000);
 
         machine->cpu->write_byte = machine_write_byte;
         machine->cpu->port_input = machine_in;
         machine->cpu->port_output = machine_out;
         machine->cpu->user_data = machine;
 
-        int which_interrupt = 1;
+        Monitor *monitor = init_monitor(machine->cpu);
+        bool use_jit = false;
+        int run_ahead_frames = 0;
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--jit") == 0)
+            {
+                use_jit = true;
+            }
+            else if (strcmp(argv[i], "--hle") == 0 || strcmp(argv[i], "--hle-validate") == 0)
+            {
+                int count = init_hle(machine, strcmp(argv[i], "--hle-validate") == 0);
+                printf("HLE: %d routines hooked.\n", count);
+            }
+            else if (strcmp(argv[i], "--break") == 0 && i + 1 < argc)
+            {
+                monitor_add_breakpoint(monitor, strtol(argv[++i], NULL, 16));
+            }
+            else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
+            {
+                monitor_add_watchpoint(monitor, strtol(argv[++i], NULL, 16));
+            }
+            else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc)
+            {
+                machine_set_clock(machine, atof(argv[++i]));
+            }
+            else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
+            {
+                run_ahead_frames = atoi(argv[++i]);
+                if (run_ahead_frames < 0 || run_ahead_frames > MAX_RUN_AHEAD)
+                {
+                    printf("Run-ahead is 0 to %d frames.\n", MAX_RUN_AHEAD);
+                    exit(1);
+                }
+            }
+            else if (strcmp(argv[i], "--skip-idle") == 0)
+            {
+                machine->cpu->skip_idle = true;
+            }
+            else if (strcmp(argv[i], "--protect-rom") == 0)
+            {
+                if (!machine_protect_rom(machine))
+                {
+                    printf("Can't protect the ROM on this host, checking stores instead.\n");
+                }
+            }
+        }
+
+        Jit8080 *jit = NULL;
+        if (use_jit)
+        {
+            jit = init_jit_8080(machine->cpu);
+            if (jit == NULL)
+            {
+                printf("JIT not available, using the interpreter.\n");
+            }
+        }
+
         SDL_Event event;
         bool quit = false;
 
-        uint8_t *bitmap_buffer = machine->cpu->memory + VIDEO_BITMAP_START;
+        Scheduler *scheduler = machine->scheduler;
+        // With run-ahead, frames are drawn by running ahead instead.
+        machine->on_vblank = run_ahead_frames > 0 ? NULL : draw_frame;
+        uint32_t (*run)(void *, uint32_t) = jit != NULL ? run_jit : run_interpreter;
+        void *core = jit != NULL ? (void *)jit : (void *)machine->cpu;
+        machine_start_watchdog(machine);
+
+        // Every frame is recorded once it ran, holding Backspace steps back
+        // through them one per frame of host time.
+        Rewind *rewind = init_rewind(REWIND_DEFAULT_BYTES);
+        uint64_t recorded = machine->frames;
+        uint64_t shown = machine->frames; // last frame run ahead of
+        bool rewinding = false;
+        double rewind_due = 0;
 
         if (!window_init())
         {
@@ -61,42 +230,100 @@ int main(int argc, char **argv)
                 }
                 if (event.type == SDL_KEYDOWN)
                 {
+                    if (event.key.keysym.sym == SDLK_h && machine->hooks != NULL)
+                    {
+                        printf("HLE %s.\n", hle_toggle(machine) ? "on" : "off");
+                    }
+                    else if (event.key.keysym.sym == SDLK_p && jit == NULL)
+                    {
+                        printf("Profile %s.\n", monitor_toggle_profile(monitor) ? "on" : "off");
+                    }
+                    else if (event.key.keysym.sym == SDLK_t && jit == NULL)
+                    {
+                        printf("Trace %s.\n", monitor_toggle_trace(monitor) ? "on" : "off");
+                    }
+                    else if (event.key.keysym.sym == SDLK_g && monitor->stopped)
+                    {
+                        monitor_resume(monitor);
+                    }
+                    else if (event.key.keysym.sym == SDLK_EQUALS ||
+                             event.key.keysym.sym == SDLK_MINUS)
+                    {
+                        report_frame_cost(machine);
+                        double factor = event.key.keysym.sym == SDLK_EQUALS ? 2.0 : 0.5;
+                        printf("Clock x%g.\n",
+                               machine_set_clock(machine, machine->clock_multiplier * factor));
+                    }
+                    else if (event.key.keysym.sym == SDLK_BACKSPACE && !rewinding)
+                    {
+                        rewinding = true;
+                        rewind_due = 0;
+                    }
                     machine_handle_key_down(machine, event.key.keysym.sym);
                 }
                 else if (event.type == SDL_KEYUP)
                 {
+                    if (event.key.keysym.sym == SDLK_BACKSPACE)
+                    {
+                        rewinding = false;
+                    }
                     machine_handle_key_up(machine, event.key.keysym.sym);
                 }
             }
 
-            uint32_t count = 0;
-            State8080 *cpu = machine->cpu;
-            while (count < dt * (CLOCK_SPEED / 1000))
+            if (dt > MAX_CATCH_UP_MS)
             {
-                int cycles = cpu->cycle_count;
-                emulate_8080_op(cpu);
-                int elapsed = cpu->cycle_count - cycles;
-                count += elapsed;
-
-                if (cpu->cycle_count >= CYCLES_PER_FRAME / 2)
+                dt = MAX_CATCH_UP_MS;
+            }
+            if (rewinding)
+            {
+                // The controls stay as they are now, not as they were.
+                uint8_t controls = machine->in_port_1;
+                for (rewind_due += dt * MACHINE_FPS / 1000; rewind_due >= 1; rewind_due--)
                 {
-                    cpu->cycle_count -= CYCLES_PER_FRAME / 2;
-
-                    generate_interrupt(cpu, which_interrupt);
-                    if (which_interrupt == 1)
-                    {
-                        which_interrupt = 2;
-                    }
-                    else
-                    {
-                        draw_screen(bitmap_buffer);
-                        which_interrupt = 1;
-                    }
+                    rewind_step_back(rewind, machine);
                 }
+                machine->in_port_1 = controls;
+                recorded = machine->frames;
+                draw_frame(machine);
+                last_time = current_time;
+                continue;
+            }
+            uint64_t count = 0;
+            uint64_t cycles_to_run =
+                (uint64_t)(dt * (MACHINE_CLOCK_SPEED / 1000) * machine->clock_multiplier);
+            uint64_t slices_start = SDL_GetPerformanceCounter();
+            while (count < cycles_to_run && !monitor->stopped)
+            {
+                // Run straight to the next event, so it happens after the
+                // same instruction as when stepping.
+                uint32_t budget = scheduler_cycles_to_next(scheduler);
+                if (budget > cycles_to_run - count)
+                {
+                    budget = cycles_to_run - count;
+                }
+                uint32_t ran = machine_run(machine, run, core, budget);
+                count += ran;
+                scheduler_advance(scheduler, ran);
+                if (machine->frames != recorded)
+                {
+                    rewind_push(rewind, machine);
+                    recorded = machine->frames;
+                }
+            }
+            frame_cost.ticks += SDL_GetPerformanceCounter() - slices_start;
+            // Once per frame that ran, from where the slices stopped.
+            if (run_ahead_frames > 0 && machine->frames != shown)
+            {
+                run_ahead(machine, run_ahead_frames, run, core);
+                shown = machine->frames;
             }
 
             last_time = current_time;
         }
+        report_frame_cost(machine);
+        report_run_ahead_cost(run_ahead_frames);
+        free_rewind(rewind);
         window_close();
     }
     return 0;
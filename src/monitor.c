@@ -0,0 +1,180 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "monitor.h"
+#include "disassembler_8080.h"
+
+#define PROFILE_REPORT_SIZE 10
+
+static void print_registers(State8080 *cpu)
+{
+    printf("a=%02x bc=%02x%02x de=%02x%02x hl=%02x%02x sp=%04x psw=%02x  ", cpu->a, cpu->b,
+           cpu->c, cpu->d, cpu->e, cpu->h, cpu->l, cpu->sp, get_psw_8080(cpu));
+}
+
+static bool probe(State8080 *cpu, void *data)
+{
+    Monitor *monitor = (Monitor *)data;
+    bool go_on = true;
+    // The instruction it stopped at runs once the CPU carries on.
+    bool may_stop = !monitor->resuming;
+    monitor->resuming = false;
+
+    if (monitor->profile != NULL)
+    {
+        monitor->profile[cpu->pc]++;
+    }
+    // A store shows up before the instruction after it.
+    for (int i = 0; i < monitor->watchpoint_count; i++)
+    {
+        uint8_t value = read_8080(cpu, monitor->watchpoints[i]);
+        if (value != monitor->watched[i])
+        {
+            printf("Watchpoint 0x%04x: %02x -> %02x before 0x%04x\n", monitor->watchpoints[i],
+                   monitor->watched[i], value, cpu->pc);
+            monitor->watched[i] = value;
+            go_on = go_on && !may_stop;
+        }
+    }
+    for (int i = 0; i < monitor->breakpoint_count; i++)
+    {
+        if (cpu->pc == monitor->breakpoints[i] && may_stop)
+        {
+            printf("Breakpoint 0x%04x\n", cpu->pc);
+            go_on = false;
+        }
+    }
+    if (monitor->trace)
+    {
+        print_registers(cpu);
+        disassemble_8080_op(cpu->memory, cpu->pc);
+    }
+
+    if (!go_on)
+    {
+        monitor->stopped = true;
+    }
+    return go_on;
+}
+
+// The instrumented core only runs while something uses it.
+static void update_probe(Monitor *monitor)
+{
+    State8080 *cpu = monitor->cpu;
+    if (monitor->profile != NULL || monitor->trace || monitor->breakpoint_count > 0 ||
+        monitor->watchpoint_count > 0)
+    {
+        cpu->probe = probe;
+        cpu->probe_data = monitor;
+    }
+    else
+    {
+        cpu->probe = NULL;
+        cpu->probe_data = NULL;
+    }
+}
+
+Monitor *init_monitor(State8080 *cpu)
+{
+    Monitor *monitor = calloc(1, sizeof(Monitor));
+    monitor->cpu = cpu;
+    return monitor;
+}
+
+static bool ranks_before(Monitor *monitor, uint32_t a, uint32_t b)
+{
+    return monitor->profile[a] > monitor->profile[b] ||
+           (monitor->profile[a] == monitor->profile[b] && a < b);
+}
+
+static void print_profile(Monitor *monitor)
+{
+    uint64_t total = 0;
+    for (uint32_t address = 0; address < 0x10000; address++)
+    {
+        total += monitor->profile[address];
+    }
+    printf("Profile: %llu instructions, the most run:\n", (unsigned long long)total);
+    if (total == 0)
+    {
+        return;
+    }
+
+    // A few passes over the counts, each taking the next one down, ties in
+    // address order.
+    uint32_t previous = 0x10000;
+    for (int rank = 0; rank < PROFILE_REPORT_SIZE; rank++)
+    {
+        uint32_t best = 0x10000;
+        for (uint32_t address = 0; address < 0x10000; address++)
+        {
+            uint64_t count = monitor->profile[address];
+            if (count > 0 && (previous == 0x10000 || ranks_before(monitor, previous, address)) &&
+                (best == 0x10000 || ranks_before(monitor, address, best)))
+            {
+                best = address;
+            }
+        }
+        if (best == 0x10000)
+        {
+            break;
+        }
+        printf("%6.2f%% ", 100.0 * monitor->profile[best] / total);
+        disassemble_8080_op(monitor->cpu->memory, best);
+        previous = best;
+    }
+}
+
+bool monitor_toggle_profile(Monitor *monitor)
+{
+    if (monitor->profile == NULL)
+    {
+        monitor->profile = calloc(0x10000, sizeof(uint64_t));
+    }
+    else
+    {
+        print_profile(monitor);
+        free(monitor->profile);
+        monitor->profile = NULL;
+    }
+    update_probe(monitor);
+    return monitor->profile != NULL;
+}
+
+bool monitor_toggle_trace(Monitor *monitor)
+{
+    monitor->trace = !monitor->trace;
+    update_probe(monitor);
+    return monitor->trace;
+}
+
+bool monitor_add_breakpoint(Monitor *monitor, uint16_t address)
+{
+    if (monitor->breakpoint_count == MONITOR_MAX_POINTS)
+    {
+        return false;
+    }
+    monitor->breakpoints[monitor->breakpoint_count++] = address;
+    update_probe(monitor);
+    return true;
+}
+
+bool monitor_add_watchpoint(Monitor *monitor, uint16_t address)
+{
+    if (monitor->watchpoint_count == MONITOR_MAX_POINTS)
+    {
+        return false;
+    }
+    monitor->watchpoints[monitor->watchpoint_count] = address;
+    monitor->watched[monitor->watchpoint_count] = read_8080(monitor->cpu, address);
+    monitor->watchpoint_count++;
+    update_probe(monitor);
+    return true;
+}
+
+void monitor_resume(Monitor *monitor)
+{
+    monitor->stopped = false;
+    monitor->resuming = true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "8080.h"
+
+#define MONITOR_MAX_POINTS 16
+
+// Debugging and profiling on a running CPU: an execution profile, an
+// instruction trace, breakpoints and watchpoints. They run on the
+// instrumented core through a Probe8080, which the monitor sets while any
+// of them is on and clears otherwise, so the CPU is back on the plain core
+// when nothing is watching it. Changes take effect at the next slice.
+typedef struct Monitor
+{
+    State8080 *cpu;
+    uint64_t *profile; // instructions run per address, NULL when off
+    bool trace;        // prints each instruction before it runs
+    int breakpoint_count;
+    uint16_t breakpoints[MONITOR_MAX_POINTS];
+    int watchpoint_count;
+    uint16_t watchpoints[MONITOR_MAX_POINTS];
+    uint8_t watched[MONITOR_MAX_POINTS]; // last value seen at each watchpoint
+    bool stopped;  // a breakpoint or watchpoint ended the last slice
+    bool resuming; // the next instruction is the one it stopped at
+} Monitor;
+
+Monitor *init_monitor(State8080 *cpu);
+// Switches profiling on or off, returns whether it is now on. Switching it
+// off prints the addresses that ran the most instructions.
+bool monitor_toggle_profile(Monitor *monitor);
+// Switches the trace on or off, returns whether it is now on.
+bool monitor_toggle_trace(Monitor *monitor);
+// Stops before the instruction at `address` runs. Returns false when all
+// breakpoints are taken.
+bool monitor_add_breakpoint(Monitor *monitor, uint16_t address);
+// Stops after an instruction changes the byte at `address`. Returns false
+// when all watchpoints are taken.
+bool monitor_add_watchpoint(Monitor *monitor, uint16_t address);
+// Lets the CPU carry on after a stop. Don't run it while stopped, it would
+// stop again before the same instruction.
+void monitor_resume(Monitor *monitor);
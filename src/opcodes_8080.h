@@ -0,0 +1,310 @@
+#pragma once
+#include <stdint.h>
+
+// Everything about each 8080 opcode but what it does, in one table that
+// the cores, the analyses and the disassembler all expand:
+//
+//   X(opcode, mnemonic, operands, length, cycles, taken, reads, writes, class)
+//
+// `operands` is a printf format, given the immediate byte or little endian
+// word for 2 and 3 byte instructions. `cycles` is what the instruction
+// takes, `taken` what a conditional CALL or RET takes when it branches
+// (the same for everything else). `reads` and `writes` are the flags it
+// depends on and sets, FLAGS_8080_*, and `class` the kind of handler that
+// runs it, OP_8080_*. The undocumented opcodes and HLT are listed with
+// what they alias but the cores don't run them.
+
+// Flags as PSW bits.
+#define FLAGS_8080_NONE 0x00
+#define FLAGS_8080_S 0x80
+#define FLAGS_8080_Z 0x40
+#define FLAGS_8080_P 0x04
+#define FLAGS_8080_CY 0x01
+#define FLAGS_8080_AC_CY 0x11
+#define FLAGS_8080_SZAP 0xd4
+#define FLAGS_8080_SZAPC 0xd5
+
+typedef enum OpClass8080
+{
+    OP_8080_MISC,          // NOP, XCHG, SPHL, EI, DI
+    OP_8080_LOAD,          // loads into registers, from memory or not
+    OP_8080_ALU,           // arithmetic, logic and rotates on registers
+    OP_8080_STORE,         // anything that writes memory, PUSH included
+    OP_8080_JUMP,          // JMP, Jcc, PCHL
+    OP_8080_CALL,          // CALL, Ccc, RST
+    OP_8080_RETURN,        // RET, Rcc
+    OP_8080_IO,            // IN, OUT
+    OP_8080_UNIMPLEMENTED, // HLT and the undocumented opcodes
+} OpClass8080;
+
+typedef struct Opcode8080
+{
+    const char *mnemonic;
+    const char *operands;
+    uint8_t length;
+    uint8_t cycles;
+    uint8_t taken_cycles;
+    uint8_t flags_read;
+    uint8_t flags_written;
+    OpClass8080 op_class;
+} Opcode8080;
+
+// clang-format off
+#define OPCODES_8080(X) \
+    X(0x00, "NOP",  "",          1, 4,  4,  NONE,  NONE,  MISC)          \
+    X(0x01, "LXI",  "B,0x%04x",  3, 10, 10, NONE,  NONE,  LOAD)          \
+    X(0x02, "STAX", "B",         1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x03, "INX",  "B",         1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x04, "INR",  "B",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x05, "DCR",  "B",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x06, "MVI",  "B,0x%02x",  2, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x07, "RLC",  "",          1, 4,  4,  NONE,  CY,    ALU)           \
+    X(0x08, "NOP",  "",          1, 4,  4,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x09, "DAD",  "B",         1, 10, 10, NONE,  CY,    ALU)           \
+    X(0x0a, "LDAX", "B",         1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x0b, "DCX",  "B",         1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x0c, "INR",  "C",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x0d, "DCR",  "C",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x0e, "MVI",  "C,0x%02x",  2, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x0f, "RRC",  "",          1, 4,  4,  NONE,  CY,    ALU)           \
+    X(0x10, "NOP",  "",          1, 4,  4,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x11, "LXI",  "D,0x%04x",  3, 10, 10, NONE,  NONE,  LOAD)          \
+    X(0x12, "STAX", "D",         1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x13, "INX",  "D",         1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x14, "INR",  "D",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x15, "DCR",  "D",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x16, "MVI",  "D,0x%02x",  2, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x17, "RAL",  "",          1, 4,  4,  CY,    CY,    ALU)           \
+    X(0x18, "NOP",  "",          1, 4,  4,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x19, "DAD",  "D",         1, 10, 10, NONE,  CY,    ALU)           \
+    X(0x1a, "LDAX", "D",         1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x1b, "DCX",  "D",         1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x1c, "INR",  "E",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x1d, "DCR",  "E",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x1e, "MVI",  "E,0x%02x",  2, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x1f, "RAR",  "",          1, 4,  4,  CY,    CY,    ALU)           \
+    X(0x20, "RIM",  "",          1, 4,  4,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x21, "LXI",  "H,0x%04x",  3, 10, 10, NONE,  NONE,  LOAD)          \
+    X(0x22, "SHLD", "$0x%04x",   3, 16, 16, NONE,  NONE,  STORE)         \
+    X(0x23, "INX",  "H",         1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x24, "INR",  "H",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x25, "DCR",  "H",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x26, "MVI",  "H,0x%02x",  2, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x27, "DAA",  "",          1, 4,  4,  AC_CY, SZAPC, ALU)           \
+    X(0x28, "NOP",  "",          1, 4,  4,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x29, "DAD",  "H",         1, 10, 10, NONE,  CY,    ALU)           \
+    X(0x2a, "LHLD", "$0x%04x",   3, 16, 16, NONE,  NONE,  LOAD)          \
+    X(0x2b, "DCX",  "H",         1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x2c, "INR",  "L",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x2d, "DCR",  "L",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x2e, "MVI",  "L,0x%02x",  2, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x2f, "CMA",  "",          1, 4,  4,  NONE,  NONE,  ALU)           \
+    X(0x30, "SIM",  "",          1, 4,  4,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x31, "LXI",  "SP,0x%04x", 3, 10, 10, NONE,  NONE,  LOAD)          \
+    X(0x32, "STA",  "$0x%04x",   3, 13, 13, NONE,  NONE,  STORE)         \
+    X(0x33, "INX",  "SP",        1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x34, "INR",  "M",         1, 10, 10, NONE,  SZAP,  STORE)         \
+    X(0x35, "DCR",  "M",         1, 10, 10, NONE,  SZAP,  STORE)         \
+    X(0x36, "MVI",  "M,0x%02x",  2, 10, 10, NONE,  NONE,  STORE)         \
+    X(0x37, "STC",  "",          1, 4,  4,  NONE,  CY,    ALU)           \
+    X(0x38, "NOP",  "",          1, 4,  4,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x39, "DAD",  "SP",        1, 10, 10, NONE,  CY,    ALU)           \
+    X(0x3a, "LDA",  "$0x%04x",   3, 13, 13, NONE,  NONE,  LOAD)          \
+    X(0x3b, "DCX",  "SP",        1, 5,  5,  NONE,  NONE,  ALU)           \
+    X(0x3c, "INR",  "A",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x3d, "DCR",  "A",         1, 5,  5,  NONE,  SZAP,  ALU)           \
+    X(0x3e, "MVI",  "A,0x%02x",  2, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x3f, "CMC",  "",          1, 4,  4,  CY,    CY,    ALU)           \
+    X(0x40, "MOV",  "B,B",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x41, "MOV",  "B,C",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x42, "MOV",  "B,D",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x43, "MOV",  "B,E",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x44, "MOV",  "B,H",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x45, "MOV",  "B,L",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x46, "MOV",  "B,M",       1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x47, "MOV",  "B,A",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x48, "MOV",  "C,B",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x49, "MOV",  "C,C",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x4a, "MOV",  "C,D",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x4b, "MOV",  "C,E",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x4c, "MOV",  "C,H",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x4d, "MOV",  "C,L",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x4e, "MOV",  "C,M",       1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x4f, "MOV",  "C,A",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x50, "MOV",  "D,B",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x51, "MOV",  "D,C",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x52, "MOV",  "D,D",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x53, "MOV",  "D,E",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x54, "MOV",  "D,H",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x55, "MOV",  "D,L",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x56, "MOV",  "D,M",       1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x57, "MOV",  "D,A",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x58, "MOV",  "E,B",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x59, "MOV",  "E,C",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x5a, "MOV",  "E,D",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x5b, "MOV",  "E,E",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x5c, "MOV",  "E,H",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x5d, "MOV",  "E,L",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x5e, "MOV",  "E,M",       1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x5f, "MOV",  "E,A",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x60, "MOV",  "H,B",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x61, "MOV",  "H,C",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x62, "MOV",  "H,D",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x63, "MOV",  "H,E",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x64, "MOV",  "H,H",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x65, "MOV",  "H,L",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x66, "MOV",  "H,M",       1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x67, "MOV",  "H,A",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x68, "MOV",  "L,B",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x69, "MOV",  "L,C",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x6a, "MOV",  "L,D",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x6b, "MOV",  "L,E",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x6c, "MOV",  "L,H",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x6d, "MOV",  "L,L",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x6e, "MOV",  "L,M",       1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x6f, "MOV",  "L,A",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x70, "MOV",  "M,B",       1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x71, "MOV",  "M,C",       1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x72, "MOV",  "M,D",       1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x73, "MOV",  "M,E",       1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x74, "MOV",  "M,H",       1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x75, "MOV",  "M,L",       1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x76, "HLT",  "",          1, 7,  7,  NONE,  NONE,  UNIMPLEMENTED) \
+    X(0x77, "MOV",  "M,A",       1, 7,  7,  NONE,  NONE,  STORE)         \
+    X(0x78, "MOV",  "A,B",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x79, "MOV",  "A,C",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x7a, "MOV",  "A,D",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x7b, "MOV",  "A,E",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x7c, "MOV",  "A,H",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x7d, "MOV",  "A,L",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x7e, "MOV",  "A,M",       1, 7,  7,  NONE,  NONE,  LOAD)          \
+    X(0x7f, "MOV",  "A,A",       1, 5,  5,  NONE,  NONE,  LOAD)          \
+    X(0x80, "ADD",  "B",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x81, "ADD",  "C",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x82, "ADD",  "D",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x83, "ADD",  "E",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x84, "ADD",  "H",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x85, "ADD",  "L",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x86, "ADD",  "M",         1, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0x87, "ADD",  "A",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x88, "ADC",  "B",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x89, "ADC",  "C",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x8a, "ADC",  "D",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x8b, "ADC",  "E",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x8c, "ADC",  "H",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x8d, "ADC",  "L",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x8e, "ADC",  "M",         1, 7,  7,  CY,    SZAPC, ALU)           \
+    X(0x8f, "ADC",  "A",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x90, "SUB",  "B",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x91, "SUB",  "C",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x92, "SUB",  "D",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x93, "SUB",  "E",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x94, "SUB",  "H",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x95, "SUB",  "L",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x96, "SUB",  "M",         1, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0x97, "SUB",  "A",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0x98, "SBB",  "B",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x99, "SBB",  "C",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x9a, "SBB",  "D",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x9b, "SBB",  "E",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x9c, "SBB",  "H",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x9d, "SBB",  "L",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0x9e, "SBB",  "M",         1, 7,  7,  CY,    SZAPC, ALU)           \
+    X(0x9f, "SBB",  "A",         1, 4,  4,  CY,    SZAPC, ALU)           \
+    X(0xa0, "ANA",  "B",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa1, "ANA",  "C",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa2, "ANA",  "D",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa3, "ANA",  "E",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa4, "ANA",  "H",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa5, "ANA",  "L",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa6, "ANA",  "M",         1, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xa7, "ANA",  "A",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa8, "XRA",  "B",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xa9, "XRA",  "C",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xaa, "XRA",  "D",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xab, "XRA",  "E",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xac, "XRA",  "H",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xad, "XRA",  "L",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xae, "XRA",  "M",         1, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xaf, "XRA",  "A",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb0, "ORA",  "B",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb1, "ORA",  "C",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb2, "ORA",  "D",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb3, "ORA",  "E",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb4, "ORA",  "H",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb5, "ORA",  "L",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb6, "ORA",  "M",         1, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xb7, "ORA",  "A",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb8, "CMP",  "B",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xb9, "CMP",  "C",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xba, "CMP",  "D",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xbb, "CMP",  "E",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xbc, "CMP",  "H",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xbd, "CMP",  "L",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xbe, "CMP",  "M",         1, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xbf, "CMP",  "A",         1, 4,  4,  NONE,  SZAPC, ALU)           \
+    X(0xc0, "RNZ",  "",          1, 5,  11, Z,     NONE,  RETURN)        \
+    X(0xc1, "POP",  "B",         1, 10, 10, NONE,  NONE,  LOAD)          \
+    X(0xc2, "JNZ",  "$0x%04x",   3, 10, 10, Z,     NONE,  JUMP)          \
+    X(0xc3, "JMP",  "$0x%04x",   3, 10, 10, NONE,  NONE,  JUMP)          \
+    X(0xc4, "CNZ",  "$0x%04x",   3, 11, 17, Z,     NONE,  CALL)          \
+    X(0xc5, "PUSH", "B",         1, 11, 11, NONE,  NONE,  STORE)         \
+    X(0xc6, "ADI",  "0x%02x",    2, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xc7, "RST",  "0",         1, 11, 11, NONE,  NONE,  CALL)          \
+    X(0xc8, "RZ",   "",          1, 5,  11, Z,     NONE,  RETURN)        \
+    X(0xc9, "RET",  "",          1, 10, 10, NONE,  NONE,  RETURN)        \
+    X(0xca, "JZ",   "$0x%04x",   3, 10, 10, Z,     NONE,  JUMP)          \
+    X(0xcb, "JMP",  "$0x%04x",   3, 10, 10, NONE,  NONE,  UNIMPLEMENTED) \
+    X(0xcc, "CZ",   "$0x%04x",   3, 11, 17, Z,     NONE,  CALL)          \
+    X(0xcd, "CALL", "$0x%04x",   3, 17, 17, NONE,  NONE,  CALL)          \
+    X(0xce, "ACI",  "0x%02x",    2, 7,  7,  CY,    SZAPC, ALU)           \
+    X(0xcf, "RST",  "1",         1, 11, 11, NONE,  NONE,  CALL)          \
+    X(0xd0, "RNC",  "",          1, 5,  11, CY,    NONE,  RETURN)        \
+    X(0xd1, "POP",  "D",         1, 10, 10, NONE,  NONE,  LOAD)          \
+    X(0xd2, "JNC",  "$0x%04x",   3, 10, 10, CY,    NONE,  JUMP)          \
+    X(0xd3, "OUT",  "0x%02x",    2, 10, 10, NONE,  NONE,  IO)            \
+    X(0xd4, "CNC",  "$0x%04x",   3, 11, 17, CY,    NONE,  CALL)          \
+    X(0xd5, "PUSH", "D",         1, 11, 11, NONE,  NONE,  STORE)         \
+    X(0xd6, "SUI",  "0x%02x",    2, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xd7, "RST",  "2",         1, 11, 11, NONE,  NONE,  CALL)          \
+    X(0xd8, "RC",   "",          1, 5,  11, CY,    NONE,  RETURN)        \
+    X(0xd9, "RET",  "",          1, 10, 10, NONE,  NONE,  UNIMPLEMENTED) \
+    X(0xda, "JC",   "$0x%04x",   3, 10, 10, CY,    NONE,  JUMP)          \
+    X(0xdb, "IN",   "0x%02x",    2, 10, 10, NONE,  NONE,  IO)            \
+    X(0xdc, "CC",   "$0x%04x",   3, 11, 17, CY,    NONE,  CALL)          \
+    X(0xdd, "CALL", "$0x%04x",   3, 17, 17, NONE,  NONE,  UNIMPLEMENTED) \
+    X(0xde, "SBI",  "0x%02x",    2, 7,  7,  CY,    SZAPC, ALU)           \
+    X(0xdf, "RST",  "3",         1, 11, 11, NONE,  NONE,  CALL)          \
+    X(0xe0, "RPO",  "",          1, 5,  11, P,     NONE,  RETURN)        \
+    X(0xe1, "POP",  "H",         1, 10, 10, NONE,  NONE,  LOAD)          \
+    X(0xe2, "JPO",  "$0x%04x",   3, 10, 10, P,     NONE,  JUMP)          \
+    X(0xe3, "XTHL", "",          1, 18, 18, NONE,  NONE,  STORE)         \
+    X(0xe4, "CPO",  "$0x%04x",   3, 11, 17, P,     NONE,  CALL)          \
+    X(0xe5, "PUSH", "H",         1, 11, 11, NONE,  NONE,  STORE)         \
+    X(0xe6, "ANI",  "0x%02x",    2, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xe7, "RST",  "4",         1, 11, 11, NONE,  NONE,  CALL)          \
+    X(0xe8, "RPE",  "",          1, 5,  11, P,     NONE,  RETURN)        \
+    X(0xe9, "PCHL", "",          1, 5,  5,  NONE,  NONE,  JUMP)          \
+    X(0xea, "JPE",  "$0x%04x",   3, 10, 10, P,     NONE,  JUMP)          \
+    X(0xeb, "XCHG", "",          1, 5,  5,  NONE,  NONE,  MISC)          \
+    X(0xec, "CPE",  "$0x%04x",   3, 11, 17, P,     NONE,  CALL)          \
+    X(0xed, "CALL", "$0x%04x",   3, 17, 17, NONE,  NONE,  UNIMPLEMENTED) \
+    X(0xee, "XRI",  "0x%02x",    2, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xef, "RST",  "5",         1, 11, 11, NONE,  NONE,  CALL)          \
+    X(0xf0, "RP",   "",          1, 5,  11, S,     NONE,  RETURN)        \
+    X(0xf1, "POP",  "PSW",       1, 10, 10, NONE,  SZAPC, LOAD)          \
+    X(0xf2, "JP",   "$0x%04x",   3, 10, 10, S,     NONE,  JUMP)          \
+    X(0xf3, "DI",   "",          1, 4,  4,  NONE,  NONE,  MISC)          \
+    X(0xf4, "CP",   "$0x%04x",   3, 11, 17, S,     NONE,  CALL)          \
+    X(0xf5, "PUSH", "PSW",       1, 11, 11, SZAPC, NONE,  STORE)         \
+    X(0xf6, "ORI",  "0x%02x",    2, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xf7, "RST",  "6",         1, 11, 11, NONE,  NONE,  CALL)          \
+    X(0xf8, "RM",   "",          1, 5,  11, S,     NONE,  RETURN)        \
+    X(0xf9, "SPHL", "",          1, 5,  5,  NONE,  NONE,  MISC)          \
+    X(0xfa, "JM",   "$0x%04x",   3, 10, 10, S,     NONE,  JUMP)          \
+    X(0xfb, "EI",   "",          1, 4,  4,  NONE,  NONE,  MISC)          \
+    X(0xfc, "CM",   "$0x%04x",   3, 11, 17, S,     NONE,  CALL)          \
+    X(0xfd, "CALL", "$0x%04x",   3, 17, 17, NONE,  NONE,  UNIMPLEMENTED) \
+    X(0xfe, "CPI",  "0x%02x",    2, 7,  7,  NONE,  SZAPC, ALU)           \
+    X(0xff, "RST",  "7",         1, 11, 11, NONE,  NONE,  CALL)
+// clang-format on
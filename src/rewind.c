@@ -0,0 +1,212 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rewind.h"
+
+#define SNAPSHOT_SIZE ((uint32_t)sizeof(MachineSnapshot))
+// Two 16 bit counts before each run of literals. Fewer equal bytes than
+// that between two literals are cheaper left in as literals.
+#define RUN_HEADER 4
+// What a snapshot encodes to at worst, a header for every 5 bytes.
+#define MAX_ENTRY_SIZE (SNAPSHOT_SIZE + RUN_HEADER * (SNAPSHOT_SIZE / (RUN_HEADER + 1) + 2))
+// Room in the index for a frame per this many bytes of data, about the
+// least a frame that ran encodes to. A full index drops frames as well.
+#define BYTES_PER_ENTRY 64
+
+// Keyframes are encoded against nothing, all zeros.
+static const MachineSnapshot no_snapshot;
+
+// `a` XOR `b` as runs: a count of zero bytes, a count of literal bytes,
+// then the literals. Returns the encoded size.
+static uint32_t encode(uint8_t *out, const uint8_t *a, const uint8_t *b, uint32_t size)
+{
+    uint32_t n = 0;
+    uint32_t i = 0;
+    while (i < size)
+    {
+        uint32_t zeros = 0;
+        while (i + zeros < size && zeros < UINT16_MAX && a[i + zeros] == b[i + zeros])
+        {
+            zeros++;
+        }
+        i += zeros;
+        uint32_t literals = 0;
+        uint32_t same = 0; // equal bytes at the end of the literals
+        while (i + literals < size && literals < UINT16_MAX && same < RUN_HEADER)
+        {
+            same = a[i + literals] == b[i + literals] ? same + 1 : 0;
+            literals++;
+        }
+        literals -= same;
+
+        uint16_t counts[2] = {zeros, literals};
+        memcpy(&out[n], counts, RUN_HEADER);
+        n += RUN_HEADER;
+        for (uint32_t j = 0; j < literals; j++)
+        {
+            out[n + j] = a[i + j] ^ b[i + j];
+        }
+        n += literals;
+        i += literals;
+    }
+    return n;
+}
+
+// XORs what encode produced into `target`.
+static void apply(uint8_t *target, const uint8_t *in, uint32_t size)
+{
+    uint32_t n = 0;
+    uint32_t i = 0;
+    while (n < size)
+    {
+        uint16_t counts[2];
+        memcpy(counts, &in[n], RUN_HEADER);
+        n += RUN_HEADER;
+        i += counts[0];
+        for (uint32_t j = 0; j < counts[1]; j++)
+        {
+            target[i + j] ^= in[n + j];
+        }
+        n += counts[1];
+        i += counts[1];
+    }
+}
+
+// The `index`th frame held, from the oldest.
+static RewindEntry *entry(Rewind *rewind, uint32_t index)
+{
+    return &rewind->entries[(rewind->first + index) % rewind->max_entries];
+}
+
+// Drops the oldest keyframe and the deltas that need it.
+static void drop_oldest(Rewind *rewind)
+{
+    do
+    {
+        rewind->used -= entry(rewind, 0)->size;
+        rewind->first = (rewind->first + 1) % rewind->max_entries;
+        rewind->count--;
+    } while (rewind->count > 0 && !entry(rewind, 0)->keyframe);
+}
+
+// Where the next entry of `size` bytes goes, once the frames in its way
+// are dropped. Entries are laid out in order, wrapping at the end of
+// `data`, so the oldest one is the first after the newest.
+static uint32_t make_room(Rewind *rewind, uint32_t size)
+{
+    uint32_t offset = rewind->end;
+    if (offset + size > rewind->capacity)
+    {
+        while (rewind->count > 0 && entry(rewind, 0)->offset >= offset)
+        {
+            drop_oldest(rewind);
+        }
+        offset = 0;
+    }
+    while (rewind->count > 0 &&
+           (rewind->count == rewind->max_entries ||
+            (entry(rewind, 0)->offset >= offset && entry(rewind, 0)->offset < offset + size)))
+    {
+        drop_oldest(rewind);
+    }
+    return offset;
+}
+
+Rewind *init_rewind(uint32_t capacity)
+{
+    Rewind *rewind = calloc(1, sizeof(Rewind));
+    rewind->data = malloc(capacity);
+    rewind->capacity = capacity;
+    rewind->max_entries = capacity / BYTES_PER_ENTRY + 2;
+    rewind->entries = malloc(rewind->max_entries * sizeof(RewindEntry));
+    rewind->encoded = malloc(MAX_ENTRY_SIZE);
+    return rewind;
+}
+
+void free_rewind(Rewind *rewind)
+{
+    free(rewind->data);
+    free(rewind->entries);
+    free(rewind->encoded);
+    free(rewind);
+}
+
+bool rewind_push(Rewind *rewind, Machine *machine)
+{
+    if (!machine_snapshot(machine, &rewind->next))
+    {
+        return false;
+    }
+    bool keyframe = rewind->count == 0 || rewind->deltas + 1 >= REWIND_KEYFRAME_INTERVAL;
+    uint32_t size;
+    uint32_t offset;
+    for (;;)
+    {
+        const MachineSnapshot *base = keyframe ? &no_snapshot : &rewind->current;
+        size = encode(rewind->encoded, (const uint8_t *)&rewind->next, (const uint8_t *)base,
+                      SNAPSHOT_SIZE);
+        if (size > rewind->capacity)
+        {
+            return false;
+        }
+        offset = make_room(rewind, size);
+        if (keyframe || rewind->count > 0)
+        {
+            break;
+        }
+        // Making room dropped the frame the delta is against.
+        keyframe = true;
+    }
+
+    memcpy(&rewind->data[offset], rewind->encoded, size);
+    *entry(rewind, rewind->count) = (RewindEntry){offset, size, keyframe};
+    rewind->count++;
+    rewind->used += size;
+    rewind->end = offset + size;
+    rewind->deltas = keyframe ? 0 : rewind->deltas + 1;
+    rewind->current = rewind->next;
+    return true;
+}
+
+bool rewind_step_back(Rewind *rewind, Machine *machine)
+{
+    if (rewind->count < 2)
+    {
+        return false;
+    }
+    RewindEntry newest = *entry(rewind, rewind->count - 1);
+    uint32_t previous = rewind->count - 2;
+    uint8_t *next = (uint8_t *)&rewind->next;
+    uint32_t key = previous;
+    if (!newest.keyframe)
+    {
+        // A delta is its frame XOR the one before, so it undoes itself.
+        rewind->next = rewind->current;
+        apply(next, &rewind->data[newest.offset], newest.size);
+    }
+    else
+    {
+        // The oldest frame is always a keyframe.
+        while (!entry(rewind, key)->keyframe)
+        {
+            key--;
+        }
+        rewind->next = no_snapshot;
+        for (uint32_t i = key; i <= previous; i++)
+        {
+            apply(next, &rewind->data[entry(rewind, i)->offset], entry(rewind, i)->size);
+        }
+    }
+    if (!machine_restore(machine, &rewind->next))
+    {
+        return false;
+    }
+
+    rewind->count--;
+    rewind->used -= newest.size;
+    rewind->end = newest.offset;
+    rewind->deltas = newest.keyframe ? previous - key : rewind->deltas - 1;
+    rewind->current = rewind->next;
+    return true;
+}
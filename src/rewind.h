@@ -0,0 +1,51 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "machine.h"
+
+// A full frame every this many, the others are deltas.
+#define REWIND_KEYFRAME_INTERVAL 60
+// About six minutes of frames at the game's usual deltas.
+#define REWIND_DEFAULT_BYTES (4 << 20)
+
+typedef struct RewindEntry
+{
+    uint32_t offset; // into `Rewind.data`
+    uint16_t size;
+    bool keyframe;
+} RewindEntry;
+
+// A machine's recent frames, oldest first, in a fixed size ring buffer.
+// Each frame is its MachineSnapshot XORed with the frame before, which
+// leaves zeros wherever nothing changed, run length encoded. Every
+// REWIND_KEYFRAME_INTERVAL frames the snapshot itself is stored instead.
+// Stepping back undoes the newest delta on the current frame, or decodes
+// forward from the keyframe before when the newest is a keyframe. Once
+// full, the oldest keyframe and its deltas make room for the new frames.
+typedef struct Rewind
+{
+    uint8_t *data;
+    uint32_t capacity; // bytes of `data`
+    uint32_t end;      // where the newest entry ends in `data`
+    uint32_t used;     // bytes the entries take
+    RewindEntry *entries; // a ring of `max_entries`, `count` from `first` on
+    uint32_t max_entries;
+    uint32_t first;
+    uint32_t count;
+    uint32_t deltas;         // entries since the newest keyframe
+    MachineSnapshot current; // the newest frame
+    MachineSnapshot next;    // the one being pushed or stepped back to
+    uint8_t *encoded;        // room for one entry while it's encoded
+} Rewind;
+
+// Holds as many frames as fit in `capacity` bytes.
+Rewind *init_rewind(uint32_t capacity);
+void free_rewind(Rewind *rewind);
+// Records the machine as it is as the newest frame. Call it between
+// slices, once per frame. Returns false, recording nothing, when the
+// machine can't be snapshotted or the frame doesn't fit at all.
+bool rewind_push(Rewind *rewind, Machine *machine);
+// Puts the machine back to the frame before the newest, which is dropped.
+// Returns false, changing nothing, when there is none.
+bool rewind_step_back(Rewind *rewind, Machine *machine);
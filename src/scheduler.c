@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+Scheduler *init_scheduler(void)
+{
+    return calloc(1, sizeof(Scheduler));
+}
+
+static bool fires_before(const Event *a, const Event *b)
+{
+    return a->due < b->due || (a->due == b->due && (int32_t)(a->order - b->order) < 0);
+}
+
+bool scheduler_add(Scheduler *scheduler, uint64_t due, EventHandler handler, void *data)
+{
+    if (scheduler->count == SCHEDULER_MAX_EVENTS)
+    {
+        return false;
+    }
+    Event event = {due, scheduler->scheduled++, handler, data};
+    Event *events = scheduler->events;
+    int i = scheduler->count++;
+    while (i > 0 && fires_before(&event, &events[(i - 1) / 2]))
+    {
+        events[i] = events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    events[i] = event;
+    return true;
+}
+
+static Event take_first(Scheduler *scheduler)
+{
+    Event *events = scheduler->events;
+    Event first = events[0];
+    Event last = events[--scheduler->count];
+    int i = 0;
+    for (;;)
+    {
+        int child = 2 * i + 1;
+        if (child >= scheduler->count)
+        {
+            break;
+        }
+        if (child + 1 < scheduler->count && fires_before(&events[child + 1], &events[child]))
+        {
+            child++;
+        }
+        if (!fires_before(&events[child], &last))
+        {
+            break;
+        }
+        events[i] = events[child];
+        i = child;
+    }
+    events[i] = last;
+    return first;
+}
+
+uint32_t scheduler_cycles_to_next(const Scheduler *scheduler)
+{
+    if (scheduler->count == 0)
+    {
+        return UINT32_MAX;
+    }
+    uint64_t due = scheduler->events[0].due;
+    // One scheduled for now or earlier from outside a handler fires after
+    // the next instruction.
+    if (due <= scheduler->now)
+    {
+        return 1;
+    }
+    return due - scheduler->now > UINT32_MAX ? UINT32_MAX : (uint32_t)(due - scheduler->now);
+}
+
+void scheduler_advance(Scheduler *scheduler, uint32_t cycles)
+{
+    scheduler->now += cycles;
+    while (scheduler->count > 0 && scheduler->events[0].due <= scheduler->now)
+    {
+        Event event = take_first(scheduler);
+        event.handler(event.data, event.due);
+    }
+}
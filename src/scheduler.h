@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHEDULER_MAX_EVENTS 8
+
+// Called once the timeline reaches `due`. The CPU may have run a few
+// cycles past it, so a periodic event schedules its next one from `due`
+// rather than from the scheduler's `now`.
+typedef void (*EventHandler)(void *data, uint64_t due);
+
+typedef struct Event
+{
+    uint64_t due;
+    uint32_t order; // ties at the same cycle fire in the order scheduled
+    EventHandler handler;
+    void *data;
+} Event;
+
+// A machine's timeline in CPU cycles since power on, with the timed events
+// on it (interrupts, devices) kept in a binary heap on their due time. The
+// CPU runs a slice straight to the next event instead of checking the time
+// after each instruction.
+typedef struct Scheduler
+{
+    uint64_t now;
+    uint32_t scheduled; // events scheduled so far
+    int count;
+    Event events[SCHEDULER_MAX_EVENTS];
+} Scheduler;
+
+Scheduler *init_scheduler(void);
+// Returns false when SCHEDULER_MAX_EVENTS are already waiting.
+bool scheduler_add(Scheduler *scheduler, uint64_t due, EventHandler handler, void *data);
+// The budget for the next slice: cycles until the next event, at least 1.
+uint32_t scheduler_cycles_to_next(const Scheduler *scheduler);
+// Moves the timeline on by the `cycles` a slice ran and fires the events
+// that are now due, earliest first. Handlers may schedule more.
+void scheduler_advance(Scheduler *scheduler, uint32_t cycles);
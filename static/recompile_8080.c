@@ -0,0 +1,646 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/8080.h"
+
+// Static recompiler: reads a fixed 8080 ROM image and writes a C
+// translation unit with one function per reachable basic block, for
+// static/static_8080.c to dispatch through.
+//
+// usage: recompile_8080 [-e address]... output.c file@address...
+//
+// Code is found by following every direct jump, call, RST and return
+// address from the entry points (0x0000 and the RST vectors by default).
+// Targets only known at run time (PCHL, or code the traversal never
+// reaches) are left to the interpreter.
+
+#define MEMORY_SIZE 0x10000
+#define MAX_ENTRIES 64
+
+static uint8_t image[MEMORY_SIZE];
+static uint32_t image_end = 0;
+static bool is_leader[MEMORY_SIZE];
+static bool is_visited[MEMORY_SIZE];
+static uint32_t block_cycles[MEMORY_SIZE]; // 0 where no block starts
+
+static const char *const registers[8] = {
+    "state->b", "state->c", "state->d", "state->e",
+    "state->h", "state->l", "M", "state->a",
+};
+
+static const char *const pairs[4] = {"BC", "DE", "HL", "state->sp"};
+
+static const char *const conditions[8] = {
+    "!(psw & PSW_Z)", "(psw & PSW_Z)",
+    "!(psw & PSW_CY)", "(psw & PSW_CY)",
+    "!(psw & PSW_P)", "(psw & PSW_P)",
+    "!(psw & PSW_S)", "(psw & PSW_S)",
+};
+
+// Left to the interpreter, which reports them.
+static bool is_unimplemented(uint8_t opcode)
+{
+    return opcodes8080[opcode].op_class == OP_8080_UNIMPLEMENTED;
+}
+
+static bool ends_block(uint8_t opcode)
+{
+    OpClass8080 op_class = opcodes8080[opcode].op_class;
+    return op_class == OP_8080_JUMP || op_class == OP_8080_CALL || op_class == OP_8080_RETURN;
+}
+
+static bool fits(uint32_t address)
+{
+    return address < image_end && address + lengths8080[image[address]] <= image_end;
+}
+
+static uint16_t word_at(uint32_t address)
+{
+    return image[address + 1] | (image[address + 2] << 8);
+}
+
+// Marks `address` as a block start and walks the code reachable from it.
+static void discover(uint16_t entry)
+{
+    static uint16_t work[MEMORY_SIZE];
+    int count = 0;
+
+    work[count++] = entry;
+    is_leader[entry] = true;
+    while (count > 0)
+    {
+        uint32_t pc = work[--count];
+        while (fits(pc) && !is_visited[pc] && !is_unimplemented(image[pc]))
+        {
+            uint8_t opcode = image[pc];
+            uint32_t next = pc + lengths8080[opcode];
+            uint16_t targets[2];
+            int target_count = 0;
+
+            is_visited[pc] = true;
+            if (opcode == 0xc3 || (opcode & 0xc7) == 0xc2 ||
+                opcode == 0xcd || (opcode & 0xc7) == 0xc4)
+            {
+                targets[target_count++] = word_at(pc);
+            }
+            else if ((opcode & 0xc7) == 0xc7)
+            {
+                targets[target_count++] = opcode & 0x38;
+            }
+            // Conditional transfers and calls continue after themselves.
+            if ((opcode & 0xc7) == 0xc0 || (opcode & 0xc7) == 0xc2 ||
+                (opcode & 0xc7) == 0xc4 || (opcode & 0xc7) == 0xc7 || opcode == 0xcd)
+            {
+                targets[target_count++] = next;
+            }
+
+            for (int i = 0; i < target_count; i++)
+            {
+                if (!is_leader[targets[i]])
+                {
+                    is_leader[targets[i]] = true;
+                    work[count++] = targets[i];
+                }
+            }
+            if (ends_block(opcode))
+            {
+                break;
+            }
+            pc = next;
+        }
+    }
+}
+
+// Leaves the block for `target`, whose block static_8080_run runs next.
+static void emit_goto(FILE *out, const char *indent, uint16_t target)
+{
+    fprintf(out, "%sstate->pc = 0x%04x;\n", indent, target);
+    fprintf(out, "%sreturn psw;\n", indent);
+}
+
+static void emit_alu(FILE *out, int operation, const char *value)
+{
+    switch (operation)
+    {
+    case 0:
+        fprintf(out, "    state->a = st_add(&psw, state->a, %s, 0);\n", value);
+        break;
+    case 1:
+        fprintf(out, "    state->a = st_add(&psw, state->a, %s, psw & PSW_CY);\n", value);
+        break;
+    case 2:
+        fprintf(out, "    state->a = st_sub(&psw, state->a, %s, 0);\n", value);
+        break;
+    case 3:
+        fprintf(out, "    state->a = st_sub(&psw, state->a, %s, psw & PSW_CY);\n", value);
+        break;
+    case 4:
+        fprintf(out, "    state->a = st_ana(&psw, state->a, %s);\n", value);
+        break;
+    case 5:
+        fprintf(out, "    state->a = st_logic(&psw, state->a ^ %s);\n", value);
+        break;
+    case 6:
+        fprintf(out, "    state->a = st_logic(&psw, state->a | %s);\n", value);
+        break;
+    case 7:
+        fprintf(out, "    st_sub(&psw, state->a, %s, 0);\n", value);
+        break;
+    }
+}
+
+static const char *source(int reg)
+{
+    return reg == 6 ? "st_read(state, HL)" : registers[reg];
+}
+
+// Writes the C for one instruction, returns true when it ends the block.
+static bool emit_instruction(FILE *out, uint32_t pc)
+{
+    uint8_t opcode = image[pc];
+    uint8_t byte = image[pc + 1];
+    uint16_t word = word_at(pc);
+    uint16_t next = pc + lengths8080[opcode];
+    int dst = (opcode >> 3) & 7;
+    int src = opcode & 7;
+    int pair = (opcode >> 4) & 3;
+
+    if (opcode >= 0x40 && opcode < 0x80)
+    {
+        if (dst == 6)
+        {
+            fprintf(out, "    st_write(state, HL, %s);\n", registers[src]);
+        }
+        else if (src != dst)
+        {
+            fprintf(out, "    %s = %s;\n", registers[dst], source(src));
+        }
+        return false;
+    }
+    if (opcode >= 0x80 && opcode < 0xc0)
+    {
+        emit_alu(out, dst, source(src));
+        return false;
+    }
+    if ((opcode & 0xc7) == 0xc6)
+    {
+        char value[8];
+        snprintf(value, sizeof(value), "0x%02x", byte);
+        emit_alu(out, dst, value);
+        return false;
+    }
+    if ((opcode & 0xc7) == 0x04 || (opcode & 0xc7) == 0x05)
+    {
+        const char *function = (opcode & 1) ? "st_dcr" : "st_inr";
+        if (dst == 6)
+        {
+            fprintf(out, "    st_write(state, HL, %s(&psw, st_read(state, HL)));\n", function);
+        }
+        else
+        {
+            fprintf(out, "    %s = %s(&psw, %s);\n", registers[dst], function, registers[dst]);
+        }
+        return false;
+    }
+    if ((opcode & 0xc7) == 0x06)
+    {
+        if (dst == 6)
+        {
+            fprintf(out, "    st_write(state, HL, 0x%02x);\n", byte);
+        }
+        else
+        {
+            fprintf(out, "    %s = 0x%02x;\n", registers[dst], byte);
+        }
+        return false;
+    }
+    if ((opcode & 0xcf) == 0x01)
+    {
+        if (pair == 3)
+        {
+            fprintf(out, "    state->sp = 0x%04x;\n", word);
+        }
+        else
+        {
+            fprintf(out, "    %s = 0x%02x;\n", registers[pair * 2], word >> 8);
+            fprintf(out, "    %s = 0x%02x;\n", registers[pair * 2 + 1], word & 0xff);
+        }
+        return false;
+    }
+    if ((opcode & 0xc7) == 0x03)
+    {
+        const char *change = (opcode & 0x08) ? "- 1" : "+ 1";
+        if (pair == 3)
+        {
+            fprintf(out, "    state->sp = state->sp %s;\n", change);
+        }
+        else
+        {
+            fprintf(out, "    SET_PAIR(%s, %s, %s %s);\n", registers[pair * 2],
+                    registers[pair * 2 + 1], pairs[pair], change);
+        }
+        return false;
+    }
+    if ((opcode & 0xcf) == 0x09)
+    {
+        fprintf(out, "    {\n");
+        fprintf(out, "        uint32_t sum = HL + %s;\n", pairs[pair]);
+        fprintf(out, "        SET_PAIR(state->h, state->l, sum);\n");
+        fprintf(out, "        psw = (psw & ~PSW_CY) | (sum >> 16);\n");
+        fprintf(out, "    }\n");
+        return false;
+    }
+    if ((opcode & 0xcf) == 0xc1)
+    {
+        if (pair == 3)
+        {
+            fprintf(out, "    {\n");
+            fprintf(out, "        uint16_t value = st_pop(state);\n");
+            fprintf(out, "        state->a = value >> 8;\n");
+            fprintf(out, "        psw = (value & 0xd5) | 0x02;\n");
+            fprintf(out, "    }\n");
+        }
+        else
+        {
+            fprintf(out, "    {\n");
+            fprintf(out, "        uint16_t value = st_pop(state);\n");
+            fprintf(out, "        SET_PAIR(%s, %s, value);\n", registers[pair * 2], registers[pair * 2 + 1]);
+            fprintf(out, "    }\n");
+        }
+        return false;
+    }
+    if ((opcode & 0xcf) == 0xc5)
+    {
+        if (pair == 3)
+        {
+            fprintf(out, "    st_push(state, (state->a << 8) | psw);\n");
+        }
+        else
+        {
+            fprintf(out, "    st_push(state, %s);\n", pairs[pair]);
+        }
+        return false;
+    }
+    if ((opcode & 0xc7) == 0xc2)
+    {
+        fprintf(out, "    if (%s)\n", conditions[dst]);
+        fprintf(out, "    {\n");
+        emit_goto(out, "        ", word);
+        fprintf(out, "    }\n");
+        emit_goto(out, "    ", next);
+        return true;
+    }
+    if ((opcode & 0xc7) == 0xc4)
+    {
+        fprintf(out, "    if (%s)\n", conditions[dst]);
+        fprintf(out, "    {\n");
+        fprintf(out, "        st_push(state, 0x%04x);\n", next);
+        fprintf(out, "        TAKEN(%u);\n", taken_cycles8080[opcode] - cycles8080[opcode]);
+        emit_goto(out, "        ", word);
+        fprintf(out, "    }\n");
+        emit_goto(out, "    ", next);
+        return true;
+    }
+    if ((opcode & 0xc7) == 0xc0)
+    {
+        fprintf(out, "    if (%s)\n", conditions[dst]);
+        fprintf(out, "    {\n");
+        fprintf(out, "        TAKEN(%u);\n", taken_cycles8080[opcode] - cycles8080[opcode]);
+        fprintf(out, "        state->pc = st_pop(state);\n");
+        fprintf(out, "        return psw;\n");
+        fprintf(out, "    }\n");
+        emit_goto(out, "    ", next);
+        return true;
+    }
+    if ((opcode & 0xc7) == 0xc7)
+    {
+        fprintf(out, "    st_push(state, 0x%04x);\n", next);
+        emit_goto(out, "    ", opcode & 0x38);
+        return true;
+    }
+
+    switch (opcode)
+    {
+    case 0x00:
+        break;
+    case 0x02:
+    case 0x12:
+        fprintf(out, "    st_write(state, %s, state->a);\n", pairs[pair]);
+        break;
+    case 0x0a:
+    case 0x1a:
+        fprintf(out, "    state->a = st_read(state, %s);\n", pairs[pair]);
+        break;
+    case 0x07:
+        fprintf(out, "    psw = (psw & ~PSW_CY) | (state->a >> 7);\n");
+        fprintf(out, "    state->a = (state->a << 1) | (state->a >> 7);\n");
+        break;
+    case 0x0f:
+        fprintf(out, "    psw = (psw & ~PSW_CY) | (state->a & 1);\n");
+        fprintf(out, "    state->a = (state->a >> 1) | (state->a << 7);\n");
+        break;
+    case 0x17:
+        fprintf(out, "    {\n");
+        fprintf(out, "        uint8_t a = state->a;\n");
+        fprintf(out, "        state->a = (a << 1) | (psw & PSW_CY);\n");
+        fprintf(out, "        psw = (psw & ~PSW_CY) | (a >> 7);\n");
+        fprintf(out, "    }\n");
+        break;
+    case 0x1f:
+        fprintf(out, "    {\n");
+        fprintf(out, "        uint8_t a = state->a;\n");
+        fprintf(out, "        state->a = (a >> 1) | ((psw & PSW_CY) << 7);\n");
+        fprintf(out, "        psw = (psw & ~PSW_CY) | (a & 1);\n");
+        fprintf(out, "    }\n");
+        break;
+    case 0x22:
+        fprintf(out, "    st_write(state, 0x%04x, state->l);\n", word);
+        fprintf(out, "    st_write(state, 0x%04x, state->h);\n", (uint16_t)(word + 1));
+        break;
+    case 0x2a:
+        fprintf(out, "    state->l = st_read(state, 0x%04x);\n", word);
+        fprintf(out, "    state->h = st_read(state, 0x%04x);\n", (uint16_t)(word + 1));
+        break;
+    case 0x27:
+        fprintf(out, "    state->a = st_daa(&psw, state->a);\n");
+        break;
+    case 0x2f:
+        fprintf(out, "    state->a = ~state->a;\n");
+        break;
+    case 0x32:
+        fprintf(out, "    st_write(state, 0x%04x, state->a);\n", word);
+        break;
+    case 0x3a:
+        fprintf(out, "    state->a = st_read(state, 0x%04x);\n", word);
+        break;
+    case 0x37:
+        fprintf(out, "    psw |= PSW_CY;\n");
+        break;
+    case 0x3f:
+        fprintf(out, "    psw ^= PSW_CY;\n");
+        break;
+    case 0xc3:
+        emit_goto(out, "    ", word);
+        return true;
+    case 0xc9:
+        fprintf(out, "    state->pc = st_pop(state);\n");
+        fprintf(out, "    return psw;\n");
+        return true;
+    case 0xcd:
+        fprintf(out, "    st_push(state, 0x%04x);\n", next);
+        emit_goto(out, "    ", word);
+        return true;
+    case 0xd3:
+        fprintf(out, "    state->pc = 0x%04x;\n", next);
+        fprintf(out, "    st_out(state, psw, 0x%02x);\n", byte);
+        break;
+    case 0xdb:
+        fprintf(out, "    state->pc = 0x%04x;\n", next);
+        fprintf(out, "    state->a = st_in(state, psw, 0x%02x);\n", byte);
+        break;
+    case 0xe3:
+        fprintf(out, "    {\n");
+        fprintf(out, "        uint8_t l = state->l;\n");
+        fprintf(out, "        uint8_t h = state->h;\n");
+        fprintf(out, "        state->l = st_read(state, state->sp);\n");
+        fprintf(out, "        state->h = st_read(state, state->sp + 1);\n");
+        fprintf(out, "        st_write(state, state->sp, l);\n");
+        fprintf(out, "        st_write(state, state->sp + 1, h);\n");
+        fprintf(out, "    }\n");
+        break;
+    case 0xe9:
+        fprintf(out, "    state->pc = HL;\n");
+        fprintf(out, "    return psw;\n");
+        return true;
+    case 0xeb:
+        fprintf(out, "    {\n");
+        fprintf(out, "        uint8_t d = state->d;\n");
+        fprintf(out, "        uint8_t e = state->e;\n");
+        fprintf(out, "        state->d = state->h;\n");
+        fprintf(out, "        state->e = state->l;\n");
+        fprintf(out, "        state->h = d;\n");
+        fprintf(out, "        state->l = e;\n");
+        fprintf(out, "    }\n");
+        break;
+    case 0xf3:
+        fprintf(out, "    state->int_enable = 0;\n");
+        break;
+    case 0xfb:
+        fprintf(out, "    state->int_enable = 1;\n");
+        break;
+    case 0xf9:
+        fprintf(out, "    state->sp = HL;\n");
+        break;
+    }
+    return false;
+}
+
+static bool stops_before(uint32_t pc)
+{
+    return is_leader[pc] || !fits(pc) || is_unimplemented(image[pc]);
+}
+
+// Cycles of the block starting at `start`, 0 when its first instruction is
+// left to the interpreter.
+static uint32_t measure_block(uint32_t start)
+{
+    uint32_t cycles = 0;
+    uint32_t pc = start;
+
+    if (!fits(pc) || is_unimplemented(image[pc]))
+    {
+        return 0;
+    }
+    for (;;)
+    {
+        uint8_t opcode = image[pc];
+        cycles += cycles8080[opcode];
+        pc += lengths8080[opcode];
+        if (ends_block(opcode) || stops_before(pc))
+        {
+            return cycles;
+        }
+    }
+}
+
+static void emit_block(FILE *out, uint32_t start)
+{
+    uint32_t pc = start;
+    uint32_t cycles = 0;
+
+    fprintf(out, "static uint8_t block_%04x(State8080 *state, uint8_t psw, uint32_t *left)\n{\n", start);
+    for (;;)
+    {
+        uint8_t opcode = image[pc];
+        if (emit_instruction(out, pc))
+        {
+            break;
+        }
+        pc += lengths8080[opcode];
+        cycles += cycles8080[opcode];
+        if (opcode == 0xfb)
+        {
+            // EI with an interrupt held leaves the rest of the block for
+            // static_8080_run to let it in after the next instruction.
+            fprintf(out, "    if (state->held_interrupt != 0)\n");
+            fprintf(out, "    {\n");
+            fprintf(out, "        *left += %u;\n", block_cycles[start] - cycles);
+            emit_goto(out, "        ", pc);
+            fprintf(out, "    }\n");
+        }
+        // Stop where another block starts, or before what can't be
+        // translated.
+        if (stops_before(pc))
+        {
+            emit_goto(out, "    ", pc);
+            break;
+        }
+    }
+    fprintf(out, "}\n\n");
+}
+
+static void load(const char *argument)
+{
+    char filename[4096];
+    const char *at = strrchr(argument, '@');
+    if (at == NULL || (size_t)(at - argument) >= sizeof(filename))
+    {
+        fprintf(stderr, "error: expected file@address, got '%s'\n", argument);
+        exit(1);
+    }
+    memcpy(filename, argument, at - argument);
+    filename[at - argument] = '\0';
+    uint32_t address = strtoul(at + 1, NULL, 0);
+
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "error: can't open file '%s'.\n", filename);
+        exit(1);
+    }
+    size_t size = fread(&image[address], 1, MEMORY_SIZE - address, f);
+    fclose(f);
+    if (size == 0)
+    {
+        fprintf(stderr, "error: while reading file '%s'\n", filename);
+        exit(1);
+    }
+    if (address + size > image_end)
+    {
+        image_end = address + size;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t entries[MAX_ENTRIES];
+    int entry_count = 0;
+    int arg = 1;
+
+    while (arg + 1 < argc && strcmp(argv[arg], "-e") == 0)
+    {
+        if (entry_count == MAX_ENTRIES)
+        {
+            fprintf(stderr, "error: too many entry points\n");
+            return 1;
+        }
+        entries[entry_count++] = strtoul(argv[arg + 1], NULL, 0);
+        arg += 2;
+    }
+    if (argc - arg < 2)
+    {
+        fprintf(stderr, "usage: %s [-e address]... output.c file@address...\n", argv[0]);
+        return 1;
+    }
+    const char *output = argv[arg++];
+    for (; arg < argc; arg++)
+    {
+        load(argv[arg]);
+    }
+
+    if (entry_count == 0)
+    {
+        // Reset and the RST vectors, which is where interrupts land.
+        for (int i = 0; i < 8; i++)
+        {
+            entries[entry_count++] = i * 8;
+        }
+    }
+    for (int i = 0; i < entry_count; i++)
+    {
+        if (entries[i] < image_end)
+        {
+            discover(entries[i]);
+        }
+    }
+
+    FILE *out = fopen(output, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "error: can't write '%s'.\n", output);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by recompile_8080, do not edit.\n");
+    fprintf(out, "#include \"static_8080.h\"\n\n");
+    fprintf(out, "#define BC ((state->b << 8) | state->c)\n");
+    fprintf(out, "#define DE ((state->d << 8) | state->e)\n");
+    fprintf(out, "#define HL ((state->h << 8) | state->l)\n");
+    fprintf(out, "#define SET_PAIR(high, low, value) \\\n");
+    fprintf(out, "    do                             \\\n");
+    fprintf(out, "    {                              \\\n");
+    fprintf(out, "        uint16_t v = (value);      \\\n");
+    fprintf(out, "        high = v >> 8;             \\\n");
+    fprintf(out, "        low = v & 0xff;            \\\n");
+    fprintf(out, "    } while (0)\n");
+    fprintf(out, "// The extra cycles of a conditional CALL or RET that branches, past the\n");
+    fprintf(out, "// end of the slice when they don't fit.\n");
+    fprintf(out, "#define TAKEN(cycles)                                   \\\n");
+    fprintf(out, "    (*left >= (cycles) ? (void)(*left -= (cycles))      \\\n");
+    fprintf(out, "                       : (void)(state->cycle_count += (cycles) - *left, *left = 0))\n\n");
+
+    int block_count = 0;
+    for (uint32_t pc = 0; pc < image_end; pc++)
+    {
+        if (is_leader[pc])
+        {
+            block_cycles[pc] = measure_block(pc);
+        }
+        if (block_cycles[pc] != 0)
+        {
+            block_count++;
+        }
+    }
+    for (uint32_t pc = 0; pc < image_end; pc++)
+    {
+        if (block_cycles[pc] != 0)
+        {
+            emit_block(out, pc);
+        }
+    }
+
+    fprintf(out, "const StaticEntry8080 static_blocks_8080[0x%04x] = {\n", image_end);
+    for (uint32_t pc = 0; pc < image_end; pc++)
+    {
+        if (block_cycles[pc] != 0)
+        {
+            fprintf(out, "    [0x%04x] = {block_%04x, %u},\n", pc, pc, block_cycles[pc]);
+        }
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "const uint32_t static_code_end_8080 = 0x%04x;\n\n", image_end);
+
+    fprintf(out, "const uint8_t static_rom_8080[0x%04x] = {", image_end);
+    for (uint32_t i = 0; i < image_end; i++)
+    {
+        fprintf(out, "%s0x%02x,", (i % 16) ? " " : "\n    ", image[i]);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "const uint32_t static_rom_size_8080 = 0x%04x;\n", image_end);
+    fclose(out);
+
+    printf("%s: %d blocks\n", output, block_count);
+    return 0;
+}
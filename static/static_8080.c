@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "static_8080.h"
+
+#define STATIC_INTERPRET_CYCLES 64
+
+uint8_t static_zsp_8080[256];
+
+void init_static_8080(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        bool even = !__builtin_parity(i);
+        static_zsp_8080[i] = (i & PSW_S) | (i == 0 ? PSW_Z : 0) | (even ? PSW_P : 0) | 0x02;
+    }
+}
+
+// The translated block starting at `pc`, NULL for none.
+static const StaticEntry8080 *block_at(uint16_t pc)
+{
+    if (pc < static_code_end_8080 && static_blocks_8080[pc].run != NULL)
+    {
+        return &static_blocks_8080[pc];
+    }
+    return NULL;
+}
+
+uint32_t static_8080_run(State8080 *state, uint32_t cycle_budget)
+{
+    uint32_t start = state->cycle_count;
+    uint32_t used = 0;
+    uint8_t psw = get_psw_8080(state);
+
+    while (used < cycle_budget)
+    {
+        uint32_t left = cycle_budget - used;
+        const StaticEntry8080 *entry = block_at(state->pc);
+        // EI let a held interrupt in, after the instruction at the pc.
+        bool let_in = state->held_interrupt != 0 && state->int_enable;
+        if (entry != NULL && entry->cycles <= left && !let_in)
+        {
+            // One block after the other while they fit, and no interrupt
+            // is held for an EI to let in.
+            do
+            {
+                left -= entry->cycles;
+                psw = entry->run(state, psw, &left);
+                entry = block_at(state->pc);
+            } while (entry != NULL && entry->cycles <= left && state->held_interrupt == 0);
+            state->cycle_count += cycle_budget - used - left;
+        }
+        else
+        {
+            // Untranslated code, or a block that would overrun the slice.
+            // Short interpreter runs give translated blocks another chance
+            // soon, and end the slice after the same instruction as the
+            // interpreter would. After EI, the interpreter runs the one
+            // instruction and takes the interrupt.
+            uint32_t cycles = let_in ? 1 : left;
+            if (cycles > STATIC_INTERPRET_CYCLES)
+            {
+                cycles = STATIC_INTERPRET_CYCLES;
+            }
+            set_psw_8080(state, psw);
+            emulate_8080_run(state, cycles);
+            psw = get_psw_8080(state);
+        }
+        used = state->cycle_count - start;
+    }
+    set_psw_8080(state, psw);
+    return used;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../src/8080.h"
+#include "../src/bus_8080.h"
+
+// Runtime shared by the statically recompiled blocks (generated by
+// recompile_8080) and their dispatcher. Blocks keep the flags packed the
+// way PUSH PSW stores them: S Z 0 AC 0 P 1 CY.
+
+#define PSW_S 0x80
+#define PSW_Z 0x40
+#define PSW_AC 0x10
+#define PSW_P 0x04
+#define PSW_CY 0x01
+
+// Runs a block whose cycles the caller already took off `left`, stores the
+// next pc in `state->pc` and returns the new flags. Blocks never call each
+// other, static_8080_run runs the next one from a loop, so the host stack
+// stays flat however long the slice.
+typedef uint8_t (*StaticBlock8080)(State8080 *state, uint8_t psw, uint32_t *left);
+
+typedef struct StaticEntry8080
+{
+    StaticBlock8080 run;
+    uint32_t cycles;
+} StaticEntry8080;
+
+// Defined by the generated translation unit.
+extern const StaticEntry8080 static_blocks_8080[];
+extern const uint32_t static_code_end_8080; // static_blocks_8080 covers [0, end)
+extern const uint8_t static_rom_8080[];
+extern const uint32_t static_rom_size_8080;
+
+extern uint8_t static_zsp_8080[256];
+
+void init_static_8080(void);
+// Same contract as emulate_8080_run. Addresses without a translated block
+// (RAM, targets only reachable through PCHL) run on the interpreter.
+uint32_t static_8080_run(State8080 *state, uint32_t cycle_budget);
+
+static inline uint8_t st_read(State8080 *state, uint16_t address)
+{
+    return read_8080(state, address);
+}
+
+static inline void st_write(State8080 *state, uint16_t address, uint8_t value)
+{
+    write_8080(state, address, value);
+}
+
+static inline uint8_t st_add(uint8_t *psw, uint8_t a, uint8_t b, unsigned cin)
+{
+    unsigned result = a + b + cin;
+    *psw = static_zsp_8080[result & 0xff] | ((a ^ b ^ result) & PSW_AC) | (result >> 8);
+    return result;
+}
+
+// a + ~b + !borrow with the carry inverted, like the interpreter.
+static inline uint8_t st_sub(uint8_t *psw, uint8_t a, uint8_t b, unsigned borrow)
+{
+    uint8_t result = st_add(psw, a, ~b, !borrow);
+    *psw ^= PSW_CY;
+    return result;
+}
+
+static inline uint8_t st_ana(uint8_t *psw, uint8_t a, uint8_t b)
+{
+    uint8_t result = a & b;
+    *psw = static_zsp_8080[result] | (((a | b) << 1) & PSW_AC);
+    return result;
+}
+
+static inline uint8_t st_logic(uint8_t *psw, uint8_t result)
+{
+    *psw = static_zsp_8080[result];
+    return result;
+}
+
+static inline uint8_t st_inr(uint8_t *psw, uint8_t value)
+{
+    uint8_t result = value + 1;
+    *psw = static_zsp_8080[result] | ((result & 0xf) == 0 ? PSW_AC : 0) | (*psw & PSW_CY);
+    return result;
+}
+
+static inline uint8_t st_dcr(uint8_t *psw, uint8_t value)
+{
+    uint8_t result = value - 1;
+    *psw = static_zsp_8080[result] | ((result & 0xf) != 0xf ? PSW_AC : 0) | (*psw & PSW_CY);
+    return result;
+}
+
+static inline uint8_t st_daa(uint8_t *psw, uint8_t a)
+{
+    unsigned cy = *psw & PSW_CY;
+    uint8_t correction = 0;
+    uint8_t lsb = a & 0x0f;
+    uint8_t msb = a >> 4;
+
+    if ((*psw & PSW_AC) || lsb > 9)
+    {
+        correction += 0x06;
+    }
+    if (cy || msb > 9 || (msb >= 9 && lsb > 9))
+    {
+        correction += 0x60;
+        cy = 1;
+    }
+    uint8_t result = st_add(psw, a, correction, 0);
+    *psw = (*psw & ~PSW_CY) | cy;
+    return result;
+}
+
+static inline void st_push(State8080 *state, uint16_t value)
+{
+    st_write(state, state->sp - 1, value >> 8);
+    st_write(state, state->sp - 2, value & 0xff);
+    state->sp -= 2;
+}
+
+static inline uint16_t st_pop(State8080 *state)
+{
+    uint16_t value = st_read(state, state->sp) | (st_read(state, state->sp + 1) << 8);
+    state->sp += 2;
+    return value;
+}
+
+static inline uint8_t st_in(State8080 *state, uint8_t psw, uint8_t port)
+{
+    if (BUS_SEES_REGISTERS)
+    {
+        set_psw_8080(state, psw);
+    }
+    return bus_in_8080(state, port);
+}
+
+static inline void st_out(State8080 *state, uint8_t psw, uint8_t port)
+{
+    if (BUS_SEES_REGISTERS)
+    {
+        set_psw_8080(state, psw);
+    }
+    bus_out_8080(state, port, state->a);
+}
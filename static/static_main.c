@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL.h>
+#include "../src/machine.h"
+#include "../src/machine_bus.h"
+#include "static_8080.h"
+
+// Headless batch runner for the statically recompiled ROM: runs a number
+// of frames with no input and prints timing plus a checksum of RAM, which
+// must match between the recompiled and interpreted cores.
+// `--clock X` runs the CPU X times as fast against the same interrupts.
+// `--any-rom` runs a ROM other than the original dump, see load_machine_rom.
+
+#define DEFAULT_FRAMES 3600
+
+static double seconds_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Of the machine's RAM, read through its memory map.
+static uint32_t ram_checksum(const Machine *machine)
+{
+    uint8_t ram[0x2000];
+    machine_read(machine, 0x2000, sizeof(ram), ram);
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < sizeof(ram); i++)
+    {
+        hash = (hash ^ ram[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Every machine runs from the same copy of the ROM.
+static MachineRom *rom;
+
+static Machine *new_machine(void)
+{
+    Machine *machine = init_machine(rom);
+    analyze_8080_flags(machine->cpu, 0, static_rom_size_8080);
+    machine->cpu->write_byte = machine_write_byte;
+    machine->cpu->port_input = machine_in;
+    machine->cpu->port_output = machine_out;
+    machine->cpu->user_data = machine;
+    return machine;
+}
+
+// Runs the machine up to its `frames`th vblank, returns the cycles it took.
+static uint64_t run_to_frame(Machine *machine, uint64_t frames, bool interpreted)
+{
+    uint64_t cycles = 0;
+    while (machine->frames < frames)
+    {
+        // Slices run to the machine's next event, as in main.c, so the
+        // interrupts land after the same instruction with either core.
+        uint32_t budget = scheduler_cycles_to_next(machine->scheduler);
+        uint32_t ran = interpreted ? emulate_8080_run(machine->cpu, budget)
+                                   : static_8080_run(machine->cpu, budget);
+        cycles += ran;
+        scheduler_advance(machine->scheduler, ran);
+    }
+    return cycles;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = DEFAULT_FRAMES;
+    bool interpreted = false;
+    bool skip_idle = false;
+    double clock = 1.0;
+    bool any_rom = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--interpreter") == 0)
+        {
+            interpreted = true;
+        }
+        else if (strcmp(argv[i], "--skip-idle") == 0)
+        {
+            skip_idle = true;
+        }
+        else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc)
+        {
+            clock = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--any-rom") == 0)
+        {
+            any_rom = true;
+        }
+        else
+        {
+            frames = strtoul(argv[i], NULL, 10);
+        }
+    }
+
+    rom = init_machine_rom(static_rom_8080, static_rom_size_8080, any_rom);
+    init_static_8080();
+
+    Machine *machine = new_machine();
+    machine->cpu->skip_idle = skip_idle;
+    clock = machine_set_clock(machine, clock);
+
+    State8080 *cpu = machine->cpu;
+    double start = seconds_now();
+    uint64_t cycles = run_to_frame(machine, frames, interpreted);
+    double elapsed = seconds_now() - start;
+
+    printf("core: %s\n", interpreted ? "interpreter" : "static");
+    printf("%u frames, %llu cycles in %.3f s (%.1fx real time)\n", frames,
+           (unsigned long long)cycles, elapsed, frames / MACHINE_FPS / elapsed);
+    if (clock != 1.0)
+    {
+        printf("clock x%g: %.3f ms per frame, %.1f%% of the frame time\n", clock,
+               1000.0 * elapsed / frames, 100.0 * elapsed * MACHINE_FPS / frames);
+    }
+    printf("ram checksum: %08x\n", ram_checksum(machine));
+    if (skip_idle)
+    {
+        printf("idle loops skipped %.1f%% of guest cycles\n", 100.0 * cpu->idle_cycles / cycles);
+    }
+#ifdef SUPERINSTRUCTIONS
+    printf("superinstructions saved %.1f dispatches per frame\n",
+           (double)cpu->fused_dispatches / frames);
+#endif
+#ifdef LOOP_IDIOMS
+    printf("loop idioms ran %.1f passes per frame\n", (double)cpu->idiom_passes / frames);
+#endif
+#ifdef PROFILE_PAIRS
+    report_opcode_pairs_8080(20);
+#endif
+
+    return 0;
+}
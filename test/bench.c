@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/8080.h"
+#include "../src/jit_8080.h"
+#include "../src/lanes_8080.h"
+
+#define MEMORY_SIZE 0x10000
+#define BENCH_SLICE_CYCLES 100000
+#define LANES_BENCH_SLICES 2000
+#define BENCH_ROM "./test/test_files/8080EXM.COM"
+
+#ifdef THREADED_DISPATCH
+#define DISPATCH_NAME "threaded"
+#else
+#define DISPATCH_NAME "switch"
+#endif
+
+#if defined(FLAG_TABLES)
+#define FLAGS_NAME "table"
+#elif defined(LAZY_FLAGS)
+#define FLAGS_NAME "lazy"
+#else
+#define FLAGS_NAME "eager"
+#endif
+
+#if defined(FLAG_LIVENESS)
+#define DECODE_NAME "cache+liveness"
+#elif defined(DECODE_CACHE)
+#define DECODE_NAME "cache"
+#else
+#define DECODE_NAME "direct"
+#endif
+
+#ifdef BUS_NULL
+#define BUS_NAME "null"
+#else
+#define BUS_NAME "generic"
+#endif
+
+static void write_byte(void *userdata, uint16_t address, uint8_t value)
+{
+    State8080 *const cpu = (State8080 *)userdata;
+    cpu->memory[address] = value;
+    invalidate_8080_decoded(cpu, address);
+}
+
+static uint8_t port_in(void *userdata, uint8_t port)
+{
+    (void)userdata;
+    (void)port;
+    return 0x00;
+}
+
+// The exerciser's console output is dropped, and the end of the run is
+// told by the pc, so a core built with BUS_NULL runs the same program.
+static void port_out(void *userdata, uint8_t port, uint8_t value)
+{
+    (void)userdata;
+    (void)port;
+    (void)value;
+}
+
+// Once the exerciser jumps to 0, the stub spins on "out 0,a; jmp 0".
+static bool bench_finished(const State8080 *cpu)
+{
+    return cpu->pc < 0x0005;
+}
+
+static State8080 *load_bench(void)
+{
+    FILE *f = fopen(BENCH_ROM, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "error: can't open file '%s'.\n", BENCH_ROM);
+        exit(1);
+    }
+
+    State8080 *cpu = init_8080();
+    cpu->user_data = cpu;
+    cpu->write_byte = write_byte;
+    cpu->port_input = port_in;
+    cpu->port_output = port_out;
+    memset(cpu->memory, 0, MEMORY_SIZE);
+
+    size_t file_size = fread(&cpu->memory[0x100], 1, MEMORY_SIZE - 0x100, f);
+    fclose(f);
+    if (file_size == 0)
+    {
+        fprintf(stderr, "error: while reading file '%s'\n", BENCH_ROM);
+        exit(1);
+    }
+
+    cpu->pc = 0x100;
+    // Same CP/M stubs as test.c: "out 0,a; jmp 0" ends the run and
+    // "out 1,a; ret" is the console call.
+    cpu->memory[0x0000] = 0xD3;
+    cpu->memory[0x0001] = 0x00;
+    cpu->memory[0x0002] = 0xC3;
+    cpu->memory[0x0003] = 0x00;
+    cpu->memory[0x0004] = 0x00;
+    cpu->memory[0x0005] = 0xD3;
+    cpu->memory[0x0006] = 0x01;
+    cpu->memory[0x0007] = 0xC9;
+    analyze_8080_flags(cpu, 0, 0x100 + file_size);
+
+    return cpu;
+}
+
+static double seconds_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// LANES_8080 copies of the exerciser run the same instructions, so they
+// stay in lockstep: the same slices on each copy on the interpreter, one
+// after the other, then on all of them on the lane engine. Returns whether
+// both ways ended with the same CPUs.
+static bool bench_lanes(void)
+{
+    State8080 *scalar[LANES_8080];
+    State8080 *lanes[LANES_8080];
+    for (int i = 0; i < LANES_8080; i++)
+    {
+        scalar[i] = load_bench();
+        lanes[i] = load_bench();
+    }
+
+    double start = seconds_now();
+    for (int i = 0; i < LANES_8080; i++)
+    {
+        for (int slice = 0; slice < LANES_BENCH_SLICES; slice++)
+        {
+            emulate_8080_run(scalar[i], BENCH_SLICE_CYCLES);
+        }
+    }
+    double scalar_elapsed = seconds_now() - start;
+
+    Lanes8080 *engine = init_lanes_8080(lanes, LANES_8080);
+    start = seconds_now();
+    for (int slice = 0; slice < LANES_BENCH_SLICES; slice++)
+    {
+        lanes_8080_run(engine, BENCH_SLICE_CYCLES);
+    }
+    double lanes_elapsed = seconds_now() - start;
+
+    // Both run the same instructions, only the lane engine counts them.
+    const Lanes8080Stats *stats = lanes_8080_stats(engine);
+    uint64_t instructions = stats->vector_instructions + stats->scalar_instructions;
+    bool same = true;
+    for (int i = 0; i < LANES_8080; i++)
+    {
+        same = same && scalar[i]->pc == lanes[i]->pc && scalar[i]->sp == lanes[i]->sp &&
+               scalar[i]->a == lanes[i]->a && get_psw_8080(scalar[i]) == get_psw_8080(lanes[i]) &&
+               scalar[i]->cycle_count == lanes[i]->cycle_count &&
+               memcmp(scalar[i]->memory, lanes[i]->memory, MEMORY_SIZE) == 0;
+        free_8080(scalar[i]);
+        free_8080(lanes[i]);
+    }
+
+    printf("lanes: %d copies, %llu instructions\n", LANES_8080, (unsigned long long)instructions);
+    printf("interpreter: %.2f million instructions/s\n", instructions / scalar_elapsed / 1e6);
+    printf("lanes: %.2f million instructions/s, %.1f%% of them across lanes, %.1f lanes a step\n",
+           instructions / lanes_elapsed / 1e6,
+           100.0 * stats->vector_instructions / instructions,
+           (double)stats->vector_instructions / stats->vector_steps);
+    printf("same CPUs both ways: %s\n", same ? "yes" : "no");
+    free_lanes_8080(engine);
+    return same;
+}
+
+int main(void)
+{
+    // The run is deterministic, so the instruction count comes from an
+    // untimed single stepping pass and the timed pass uses emulate_8080_run.
+    State8080 *cpu = load_bench();
+    uint64_t instructions = 0;
+    while (!bench_finished(cpu))
+    {
+        emulate_8080_op(cpu);
+        instructions++;
+    }
+    free_8080(cpu);
+
+    cpu = load_bench();
+    uint64_t cycles = 0;
+    double start = seconds_now();
+    while (!bench_finished(cpu))
+    {
+        cycles += emulate_8080_run(cpu, BENCH_SLICE_CYCLES);
+    }
+    double elapsed = seconds_now() - start;
+
+    printf("core: %s/%s/%s, %s bus\n", DISPATCH_NAME, FLAGS_NAME, DECODE_NAME, BUS_NAME);
+    printf("8080EXM: %llu instructions, %llu cycles in %.3f s\n",
+           (unsigned long long)instructions, (unsigned long long)cycles, elapsed);
+    printf("%.2f million instructions/s, %.2f MHz\n",
+           instructions / elapsed / 1e6, cycles / elapsed / 1e6);
+#ifdef SUPERINSTRUCTIONS
+    printf("superinstructions saved %llu dispatches, %.2f%% of the instructions\n",
+           (unsigned long long)cpu->fused_dispatches, 100.0 * cpu->fused_dispatches / instructions);
+#endif
+    free_8080(cpu);
+
+    cpu = load_bench();
+    Jit8080 *jit = init_jit_8080(cpu);
+    if (jit != NULL)
+    {
+        cycles = 0;
+        start = seconds_now();
+        while (!bench_finished(cpu))
+        {
+            cycles += jit_8080_run(jit, BENCH_SLICE_CYCLES);
+        }
+        elapsed = seconds_now() - start;
+        free_jit_8080(jit);
+
+        printf("jit: %llu cycles in %.3f s\n", (unsigned long long)cycles, elapsed);
+        printf("%.2f million instructions/s, %.2f MHz\n",
+               instructions / elapsed / 1e6, cycles / elapsed / 1e6);
+    }
+    free_8080(cpu);
+
+    return bench_lanes() ? 0 : 1;
+}
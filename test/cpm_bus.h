@@ -0,0 +1,55 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../src/8080.h"
+
+// The CP/M stand-in the CPU tests run on: "out 0" at 0x0000 ends the test
+// and "out 1" at 0x0005 is the BDOS console call. Inline so a core built
+// with BUS_CPM can take them in (see src/bus_8080.h). `bus` is user_data.
+
+typedef struct CpmBus
+{
+    State8080 *cpu;
+    bool finished; // the test ran "out 0"
+} CpmBus;
+
+static inline void cpm_bus_write(CpmBus *bus, uint16_t address, uint8_t value)
+{
+    bus->cpu->memory[address] = value;
+    invalidate_8080_decoded(bus->cpu, address);
+}
+
+static inline uint8_t cpm_bus_in(CpmBus *bus, uint8_t port)
+{
+    (void)bus;
+    (void)port;
+    return 0x00;
+}
+
+static inline void cpm_bus_out(CpmBus *bus, uint8_t port, uint8_t value)
+{
+    (void)value;
+    State8080 *cpu = bus->cpu;
+    if (port == 0)
+    {
+        bus->finished = true;
+    }
+    else if (port == 1)
+    {
+        uint8_t operation = cpu->c;
+
+        if (operation == 2)
+        { // print a character stored in E
+            printf("%c", cpu->e);
+        }
+        else if (operation == 9)
+        { // print from memory at (DE) until '$' char
+            uint16_t addr = (cpu->d << 8) | cpu->e;
+            do
+            {
+                printf("%c", cpu->memory[addr++]);
+            } while (cpu->memory[addr] != '$');
+        }
+    }
+}
@@ -0,0 +1,655 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/machine.h"
+#include "../src/jit_8080.h"
+#include "../src/lanes_8080.h"
+#include "../src/rewind.h"
+
+// Checks of what runs whole machines (src/machine.h) rather than the CPU
+// alone, on a small program of their own instead of the game's ROM: it
+// counts the interrupts, mixes port 1 into RAM at every vblank and keeps
+// refilling most of RAM from what it got, so the machines' RAM depends on
+// their input and timing. Each check prints what it measured and PASS or
+// FAIL, main fails unless all pass. `machine_test N` forks N machines
+// instead of DEFAULT_FORKS, the fork benchmark.
+
+// The program's routines, placed by `program` in an otherwise empty ROM.
+static const uint8_t reset[] = {
+    0x31, 0x00, 0x21, // LXI SP,0x2100
+    0xfb,             // EI
+    0xc3, 0x40, 0x00, // JMP 0x0040
+};
+static const uint8_t mid_screen_vector[] = {0xc3, 0x80, 0x00}; // JMP 0x0080
+static const uint8_t vblank_vector[] = {0xc3, 0xa0, 0x00};     // JMP 0x00a0
+// Fills 0x2100-0x3fff from the byte at 0x2002, inverted when odd, stores
+// it at a mirror of 0x2004 and starts again.
+static const uint8_t fill[] = {
+    0x3a, 0x02, 0x20, // 0x0040: LDA 0x2002
+    0x47,             // MOV B,A
+    0x0f,             // RRC
+    0xd2, 0x4c, 0x00, // JNC 0x004c
+    0x78,             // MOV A,B
+    0x2f,             // CMA
+    0x47,             // MOV B,A
+    0x00,             // NOP
+    0x21, 0x00, 0x21, // 0x004c: LXI H,0x2100
+    0x78,             // 0x004f: MOV A,B
+    0x85,             // ADD L
+    0xac,             // XRA H
+    0x77,             // MOV M,A
+    0x23,             // INX H
+    0x7c,             // MOV A,H
+    0xfe, 0x40,       // CPI 0x40
+    0xc2, 0x4f, 0x00, // JNZ 0x004f
+    0x78,             // MOV A,B
+    0x32, 0x04, 0x40, // STA 0x4004
+    0xc3, 0x40, 0x00, // JMP 0x0040
+};
+// Counts mid-screens at 0x2000.
+static const uint8_t mid_screen[] = {
+    0xf5,             // PUSH PSW
+    0xe5,             // PUSH H
+    0x2a, 0x00, 0x20, // LHLD 0x2000
+    0x23,             // INX H
+    0x22, 0x00, 0x20, // SHLD 0x2000
+    0xe1,             // POP H
+    0xf1,             // POP PSW
+    0xfb,             // EI
+    0xc9,             // RET
+};
+// Mixes port 1 into 0x2002, puts it and the input through the shift
+// register into 0x2003 and feeds the watchdog.
+static const uint8_t vblank[] = {
+    0xf5,             // PUSH PSW
+    0xc5,             // PUSH B
+    0xdb, 0x01,       // IN 1
+    0x47,             // MOV B,A
+    0x3a, 0x02, 0x20, // LDA 0x2002
+    0x80,             // ADD B
+    0x07,             // RLC
+    0x32, 0x02, 0x20, // STA 0x2002
+    0xd3, 0x04,       // OUT 4
+    0x78,             // MOV A,B
+    0xd3, 0x04,       // OUT 4
+    0x3e, 0x03,       // MVI A,3
+    0xd3, 0x02,       // OUT 2
+    0xdb, 0x03,       // IN 3
+    0x32, 0x03, 0x20, // STA 0x2003
+    0xd3, 0x06,       // OUT 6
+    0xc1,             // POP B
+    0xf1,             // POP PSW
+    0xfb,             // EI
+    0xc9,             // RET
+};
+static const struct
+{
+    uint16_t address;
+    const uint8_t *code;
+    size_t size;
+} program[] = {
+    {0x0000, reset, sizeof(reset)},
+    {0x0008, mid_screen_vector, sizeof(mid_screen_vector)},
+    {0x0010, vblank_vector, sizeof(vblank_vector)},
+    {0x0040, fill, sizeof(fill)},
+    {0x0080, mid_screen, sizeof(mid_screen)},
+    {0x00a0, vblank, sizeof(vblank)},
+};
+#define PROGRAM_END 0x0100
+
+// Snapshots and restores timed for the average.
+#define SNAPSHOT_ROUNDS 1000
+// Inputs the forks take turns with.
+#define FORK_INPUTS 8
+// Forks made off one machine and run a frame each.
+#define DEFAULT_FORKS 10000
+// Machines made for measuring their memory, and what each may take.
+#define MEMORY_MACHINES 1000
+#define MACHINE_MEMORY_LIMIT_KIB 10
+// Machines on JITs sharing their translations, and what each JIT may take.
+#define JIT_MACHINES 100
+#define JIT_MEMORY_LIMIT_KIB 8
+
+// Every machine runs from the same copy of the ROM.
+static MachineRom *rom;
+static int failures;
+
+static double seconds_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void report(const char *name, bool passed)
+{
+    printf("%s: %s\n", name, passed ? "PASS" : "FAIL");
+    failures += !passed;
+}
+
+// A machine on `image`, with the code up to `code_end` analyzed.
+static Machine *machine_on(const MachineRom *image, uint16_t code_end)
+{
+    Machine *machine = init_machine(image);
+    analyze_8080_flags(machine->cpu, 0, code_end);
+    machine->cpu->write_byte = machine_write_byte;
+    machine->cpu->port_input = machine_in;
+    machine->cpu->port_output = machine_out;
+    machine->cpu->user_data = machine;
+    return machine;
+}
+
+static Machine *new_machine(void)
+{
+    return machine_on(rom, PROGRAM_END);
+}
+
+// Runs the machine up to its `frames`th vblank, returns the cycles it took.
+static uint64_t run_to_frame(Machine *machine, uint64_t frames)
+{
+    uint64_t cycles = 0;
+    while (machine->frames < frames)
+    {
+        uint32_t ran = emulate_8080_run(machine->cpu, scheduler_cycles_to_next(machine->scheduler));
+        cycles += ran;
+        scheduler_advance(machine->scheduler, ran);
+    }
+    return cycles;
+}
+
+// FNV-1a of the machine's RAM.
+static uint32_t ram_checksum(const Machine *machine)
+{
+    uint8_t ram[0x2000];
+    machine_read(machine, 0x2000, sizeof(ram), ram);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(ram); i++)
+    {
+        hash = (hash ^ ram[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Bytes of host memory the process has resident, 0 without /proc.
+static size_t resident_bytes(void)
+{
+    unsigned long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f != NULL)
+    {
+        if (fscanf(f, "%*u %lu", &pages) != 1)
+        {
+            pages = 0;
+        }
+        fclose(f);
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+// Port 1 for machine `lane` on `frame`, changing on a rhythm of its own.
+static uint8_t scripted_input(uint32_t lane, uint64_t frame)
+{
+    return 0x08 | (uint8_t)(lane * 0x25 + frame / (3 + lane % 5));
+}
+
+// The same machines and frames on the interpreter, one after the other,
+// or on the lane engine. Returns the seconds taken, adds each machine's
+// RAM checksum to `checksums`.
+static double run_machines(int count, uint32_t frames, bool lanes, uint32_t *checksums,
+                           Lanes8080Stats *stats)
+{
+    Machine *machines[LANES_8080];
+    State8080 *cpus[LANES_8080];
+    for (int i = 0; i < count; i++)
+    {
+        machines[i] = new_machine();
+        cpus[i] = machines[i]->cpu;
+    }
+    Lanes8080 *engine = lanes ? init_lanes_8080(cpus, count) : NULL;
+
+    // Each slice runs every machine to the earliest event on their
+    // timelines, both ways, so they stop after the same instructions.
+    double start = seconds_now();
+    for (;;)
+    {
+        uint32_t budget = UINT32_MAX;
+        uint32_t before[LANES_8080];
+        bool done = true;
+        for (int i = 0; i < count; i++)
+        {
+            machines[i]->in_port_1 = scripted_input(i, machines[i]->frames);
+            uint32_t next = scheduler_cycles_to_next(machines[i]->scheduler);
+            budget = next < budget ? next : budget;
+            before[i] = cpus[i]->cycle_count;
+            done = done && machines[i]->frames >= frames;
+        }
+        if (done)
+        {
+            break;
+        }
+        if (engine != NULL)
+        {
+            lanes_8080_run(engine, budget);
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (engine == NULL)
+            {
+                emulate_8080_run(cpus[i], budget);
+            }
+            scheduler_advance(machines[i]->scheduler, cpus[i]->cycle_count - before[i]);
+        }
+    }
+    double elapsed = seconds_now() - start;
+
+    if (engine != NULL)
+    {
+        *stats = *lanes_8080_stats(engine);
+        free_lanes_8080(engine);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        checksums[i] = ram_checksum(machines[i]);
+        free_machine(machines[i]);
+    }
+    return elapsed;
+}
+
+// `count` machines with inputs of their own, once one after the other on
+// the interpreter and once on the lane engine, must end with the same RAM.
+static void test_lanes(int count, uint32_t frames)
+{
+    printf("\n*** TEST (machine): %d machines on lanes, %u frames\n", count, frames);
+    uint32_t scalar_sums[LANES_8080];
+    uint32_t lane_sums[LANES_8080];
+    Lanes8080Stats stats;
+    double scalar = run_machines(count, frames, false, scalar_sums, NULL);
+    double lanes = run_machines(count, frames, true, lane_sums, &stats);
+
+    // Both run the same instructions, only the lane engine counts them.
+    uint64_t instructions = stats.vector_instructions + stats.scalar_instructions;
+    int mismatches = 0;
+    for (int i = 0; i < count; i++)
+    {
+        mismatches += scalar_sums[i] != lane_sums[i];
+    }
+    printf("interpreter: %.2f million instructions/s, lanes: %.2f million instructions/s\n",
+           instructions / scalar / 1e6, instructions / lanes / 1e6);
+    printf("%.1f%% of instructions ran across lanes, %.1f%% lane occupancy\n",
+           100.0 * stats.vector_instructions / instructions,
+           stats.vector_steps ? 100.0 * stats.vector_instructions / (stats.vector_steps * count) : 0.0);
+    printf("%d of %d machines ended with different RAM\n", mismatches, count);
+    report("lanes", mismatches == 0);
+}
+
+// Runs `frames` frames with a snapshot halfway, then the second half again
+// from it, restored from memory and then from disk. All three runs of the
+// second half must take the same cycles to the same RAM.
+static void test_snapshots(uint32_t frames)
+{
+    printf("\n*** TEST (machine): snapshots, %u frames\n", frames);
+    static MachineSnapshot snapshot, scratch;
+    Machine *machine = new_machine();
+    run_to_frame(machine, frames / 2);
+    if (!machine_snapshot(machine, &snapshot))
+    {
+        printf("the machine has events a snapshot can't hold\n");
+        report("snapshots", false);
+        free_machine(machine);
+        return;
+    }
+    uint64_t cycles = run_to_frame(machine, frames);
+    uint32_t straight = ram_checksum(machine);
+
+    double start = seconds_now();
+    for (int i = 0; i < SNAPSHOT_ROUNDS; i++)
+    {
+        machine_snapshot(machine, &scratch);
+    }
+    double snapshot_time = (seconds_now() - start) / SNAPSHOT_ROUNDS;
+    start = seconds_now();
+    for (int i = 0; i < SNAPSHOT_ROUNDS; i++)
+    {
+        machine_restore(machine, &scratch);
+    }
+    double restore_time = (seconds_now() - start) / SNAPSHOT_ROUNDS;
+    printf("snapshot: %.2f us, restore: %.2f us, %zu bytes\n", snapshot_time * 1e6,
+           restore_time * 1e6, sizeof(MachineSnapshot));
+
+    bool same = machine_restore(machine, &snapshot) && run_to_frame(machine, frames) == cycles;
+    uint32_t from_memory = ram_checksum(machine);
+
+    char path[] = "/tmp/invaders_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    const MachineSnapshot *mapped = NULL;
+    if (fd >= 0)
+    {
+        close(fd);
+        if (machine_save_snapshot(&snapshot, path))
+        {
+            mapped = machine_map_snapshot(path);
+        }
+        unlink(path);
+    }
+    uint32_t from_disk = 0;
+    if (mapped != NULL && machine_restore(machine, mapped))
+    {
+        same = same && run_to_frame(machine, frames) == cycles;
+        from_disk = ram_checksum(machine);
+    }
+    else
+    {
+        printf("the snapshot didn't load back from disk\n");
+        same = false;
+    }
+    if (mapped != NULL)
+    {
+        machine_unmap_snapshot(mapped);
+    }
+    free_machine(machine);
+
+    printf("ram checksum: %08x straight, %08x from memory, %08x from disk\n", straight,
+           from_memory, from_disk);
+    printf("second half: %llu cycles, %s\n", (unsigned long long)cycles,
+           same ? "the same each time" : "differs");
+    report("snapshots", same && from_memory == straight && from_disk == straight);
+}
+
+// Runs `frames` frames, recording each one for rewinding, then steps back
+// through all the frames still held. Prints their size and what recording
+// and stepping back cost. Every frame stepped back to must have the RAM it
+// had when it ran.
+static void test_rewind(uint32_t frames)
+{
+    printf("\n*** TEST (machine): rewind, %u frames\n", frames);
+    Machine *machine = new_machine();
+    Rewind *rewind = init_rewind(REWIND_DEFAULT_BYTES);
+    uint32_t *checksums = malloc((frames + 1) * sizeof(uint32_t));
+    double recording = 0;
+    for (uint32_t frame = 1; frame <= frames; frame++)
+    {
+        run_to_frame(machine, frame);
+        double start = seconds_now();
+        rewind_push(rewind, machine);
+        recording += seconds_now() - start;
+        checksums[frame] = ram_checksum(machine);
+    }
+    uint32_t held = rewind->count;
+    printf("%u of %u frames held in %.1f KiB, %.0f bytes per frame, recording %.2f us per frame\n",
+           held, frames, rewind->used / 1024.0, (double)rewind->used / held,
+           1e6 * recording / frames);
+
+    uint32_t steps = 0;
+    uint32_t matched = 0;
+    double start = seconds_now();
+    while (rewind_step_back(rewind, machine))
+    {
+        steps++;
+        matched += ram_checksum(machine) == checksums[machine->frames];
+    }
+    double stepping = seconds_now() - start;
+    printf("stepping back: %.2f us per frame, %u of %u frames matched, back to frame %llu\n",
+           1e6 * stepping / steps, matched, steps, (unsigned long long)machine->frames);
+    free(checksums);
+    free_rewind(rewind);
+    free_machine(machine);
+    report("rewind", steps == held - 1 && matched == steps);
+}
+
+// Port 1 for fork `i`, one of FORK_INPUTS.
+static uint8_t fork_input(int i)
+{
+    return 0x08 | (uint8_t)(i % FORK_INPUTS * 0x31);
+}
+
+// Runs `frames` frames, forks `count` machines off the last one and runs
+// each fork a frame further with its own input. Prints how fast forking is
+// and the memory the forks took. Every fork must end the same as a machine
+// restored from a snapshot of the parent and run with that input, with the
+// parent left as it was.
+static void test_forks(uint32_t frames, int count)
+{
+    printf("\n*** TEST (machine): %d forks off frame %u\n", count, frames);
+    static MachineSnapshot start, expected[FORK_INPUTS], scratch;
+    Machine *parent = new_machine();
+    run_to_frame(parent, frames);
+    machine_snapshot(parent, &start);
+    for (int i = 0; i < FORK_INPUTS; i++)
+    {
+        Machine *machine = new_machine();
+        machine_restore(machine, &start);
+        machine->in_port_1 = fork_input(i);
+        run_to_frame(machine, frames + 1);
+        machine_snapshot(machine, &expected[i]);
+        free_machine(machine);
+    }
+
+    Machine **forks = malloc(count * sizeof(Machine *));
+    size_t resident = resident_bytes();
+    double start_time = seconds_now();
+    for (int i = 0; i < count; i++)
+    {
+        forks[i] = machine_fork(parent);
+    }
+    double forking = seconds_now() - start_time;
+    size_t forked = resident_bytes();
+    start_time = seconds_now();
+    for (int i = 0; i < count; i++)
+    {
+        forks[i]->in_port_1 = fork_input(i);
+        run_to_frame(forks[i], frames + 1);
+    }
+    double running = seconds_now() - start_time;
+    size_t ran = resident_bytes();
+
+    uint32_t copied = 0;
+    int matched = 0;
+    for (int i = 0; i < count; i++)
+    {
+        for (int page = 0; page < MACHINE_RAM_PAGES; page++)
+        {
+            copied += forks[i]->ram[page] != parent->ram[page];
+        }
+        memset(&scratch, 0, sizeof(scratch));
+        machine_snapshot(forks[i], &scratch);
+        matched += memcmp(&scratch, &expected[i % FORK_INPUTS], sizeof(scratch)) == 0;
+        free_machine(forks[i]);
+    }
+    free(forks);
+    memset(&scratch, 0, sizeof(scratch));
+    machine_snapshot(parent, &scratch);
+    bool unchanged = memcmp(&scratch, &start, sizeof(scratch)) == 0;
+    free_machine(parent);
+
+    printf("fork: %d machines in %.2f ms, %.0f forks per second, %.1f KiB resident each\n", count,
+           1e3 * forking, count / forking, (double)(forked - resident) / count / 1024);
+    printf("one frame each: %.3f ms per fork, %.1f of %d RAM pages copied, %.1f KiB more "
+           "resident each\n",
+           1e3 * running / count, (double)copied / count, MACHINE_RAM_PAGES,
+           (double)(ran - forked) / count / 1024);
+    printf("%d of %d forks matched a restored machine, the parent %s\n", matched, count,
+           unchanged ? "unchanged" : "changed");
+    report("forks", matched == count && unchanged);
+}
+
+// Makes `count` machines and runs each a frame, which stores to all of its
+// RAM. Prints the memory each took, which must stay near the 8K of RAM
+// (DECODE_CACHE adds its decoded instructions on top, see init_machine).
+static void test_machine_memory(int count)
+{
+    printf("\n*** TEST (machine): %d new machines\n", count);
+    Machine **machines = malloc(count * sizeof(Machine *));
+    size_t resident = resident_bytes();
+    for (int i = 0; i < count; i++)
+    {
+        machines[i] = new_machine();
+        run_to_frame(machines[i], 1);
+    }
+    double each = (double)(resident_bytes() - resident) / count / 1024;
+    for (int i = 0; i < count; i++)
+    {
+        free_machine(machines[i]);
+    }
+    free(machines);
+    printf("%.1f KiB resident each, of which 8.0 KiB RAM\n", each);
+#ifdef DECODE_CACHE
+    report("machine memory", true);
+#else
+    report("machine memory", each < MACHINE_MEMORY_LIMIT_KIB);
+#endif
+}
+
+// Makes `count` machines, runs each a frame on the interpreter, then up to
+// `frames` on JITs sharing their translations, each with its own input.
+// Prints the memory each JIT after the first took, which translates
+// nothing of its own. Every machine must end as on the interpreter alone.
+static void test_jit_sharing(int count, uint32_t frames)
+{
+    printf("\n*** TEST (machine): %d machines on shared JIT translations\n", count);
+    Machine **machines = malloc(count * sizeof(Machine *));
+    Jit8080 **jits = malloc(count * sizeof(Jit8080 *));
+    for (int i = 0; i < count; i++)
+    {
+        machines[i] = new_machine();
+        machines[i]->in_port_1 = scripted_input(i, 0);
+        run_to_frame(machines[i], 1);
+    }
+    size_t resident = 0;
+    for (int i = 0; i < count; i++)
+    {
+        jits[i] = init_jit_8080_sharing(machines[i]->cpu, i > 0 ? jits[0] : NULL);
+        if (jits[i] == NULL)
+        {
+            // Only the first can fail, the others reuse its code.
+            printf("no JIT on this host\n");
+            report("JIT sharing", true);
+            for (int j = 0; j < count; j++)
+            {
+                free_machine(machines[j]);
+            }
+            free(jits);
+            free(machines);
+            return;
+        }
+        while (machines[i]->frames < frames)
+        {
+            uint32_t ran = jit_8080_run(jits[i], scheduler_cycles_to_next(machines[i]->scheduler));
+            scheduler_advance(machines[i]->scheduler, ran);
+        }
+        resident = i == 0 ? resident_bytes() : resident;
+    }
+    double each = (double)(resident_bytes() - resident) / (count - 1) / 1024;
+
+    int matched = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Machine *machine = new_machine();
+        machine->in_port_1 = scripted_input(i, 0);
+        run_to_frame(machine, frames);
+        matched += ram_checksum(machine) == ram_checksum(machines[i]);
+        free_machine(machine);
+        free_jit_8080(jits[i]);
+        free_machine(machines[i]);
+    }
+    free(jits);
+    free(machines);
+    printf("%.1f KiB resident each JIT after the first\n", each);
+    printf("%d of %d machines matched the interpreter\n", matched, count);
+    report("JIT sharing", matched == count && each < JIT_MEMORY_LIMIT_KIB);
+}
+
+// Runs `frames` frames, each followed by `ahead` more that are undone
+// again, as the game's run-ahead does. Prints what that costs per frame.
+// The machine must still end as without running ahead.
+static void test_run_ahead(uint32_t frames, int ahead)
+{
+    printf("\n*** TEST (machine): run-ahead %d, %u frames\n", ahead, frames);
+    static MachineSnapshot snapshot;
+    Machine *straight = new_machine();
+    uint64_t cycles = run_to_frame(straight, frames);
+
+    Machine *machine = new_machine();
+    uint64_t ran = 0;
+    double running = 0;
+    double running_ahead = 0;
+    for (uint32_t frame = 1; frame <= frames; frame++)
+    {
+        double start = seconds_now();
+        ran += run_to_frame(machine, frame);
+        double saved = seconds_now();
+        machine_snapshot(machine, &snapshot);
+        run_to_frame(machine, frame + ahead);
+        machine_restore(machine, &snapshot);
+        running += saved - start;
+        running_ahead += seconds_now() - saved;
+    }
+    uint32_t expected = ram_checksum(straight);
+    uint32_t got = ram_checksum(machine);
+    printf("%.3f ms per frame with it against %.3f ms without\n",
+           1e3 * (running + running_ahead) / frames, 1e3 * running / frames);
+    printf("ram checksum: %08x, %08x without running ahead, %s cycles\n", got, expected,
+           ran == cycles ? "the same" : "different");
+    free_machine(machine);
+    free_machine(straight);
+    report("run-ahead", got == expected && ran == cycles);
+}
+
+// An interrupt held until EI comes in after the instruction that follows
+// it, and must see the flags of an ALU instruction before the EI even when
+// an instruction after it overwrites them.
+static void test_flags_at_ei(void)
+{
+    printf("\n*** TEST (machine): flags seen by an interrupt let in by EI\n");
+    static const uint8_t code[] = {
+        0x31, 0x00, 0x24, // LXI SP,0x2400
+        0x3e, 0xff,       // MVI A,0xff
+        0x06, 0x01,       // MVI B,1
+        0x80,             // ADD B
+        0xfb,             // EI
+        0x00,             // NOP
+        0xb7,             // ORA A
+        0xc3, 0x0b, 0x00, // JMP 0x000b
+        0x00, 0x00, 0x00,
+        0xf5,             // 0x0010: RST 2, PUSH PSW
+        0xc3, 0x11, 0x00, // JMP 0x0011
+    };
+    static uint8_t image[0x2000];
+    memcpy(image, code, sizeof(code));
+    Machine *machine = machine_on(init_machine_rom(image, sizeof(image), true), sizeof(code));
+    request_interrupt_8080(machine->cpu, 2);
+    emulate_8080_run(machine->cpu, 100);
+    emulate_8080_run(machine->cpu, 100);
+    uint8_t psw;
+    machine_read(machine, 0x23fc, 1, &psw);
+    printf("the interrupt pushed flags %02x, %02x expected\n", psw, 0x57);
+    report("flags at EI", psw == 0x57);
+    free_machine(machine);
+}
+
+int main(int argc, char **argv)
+{
+    int forks = argc > 1 ? atoi(argv[1]) : DEFAULT_FORKS;
+    static uint8_t image[0x2000];
+    for (size_t i = 0; i < sizeof(program) / sizeof(program[0]); i++)
+    {
+        memcpy(&image[program[i].address], program[i].code, program[i].size);
+    }
+    rom = init_machine_rom(image, sizeof(image), true);
+
+    test_lanes(8, 300);
+    test_snapshots(600);
+    test_rewind(600);
+    test_machine_memory(MEMORY_MACHINES);
+    test_forks(120, forks);
+    test_jit_sharing(JIT_MACHINES, 60);
+    test_run_ahead(300, 2);
+    test_flags_at_ei();
+
+    printf("\n%d machine checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
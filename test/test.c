@@ -5,47 +5,35 @@
 #include <string.h>
 #include <unistd.h>
 #include "../src/8080.h"
+#include "../src/jit_8080.h"
+#include "../src/lanes_8080.h"
+#include "cpm_bus.h"
 
 #define MEMORY_SIZE 0x10000
-
-static bool test_finished = 0;
+#define TEST_SLICE_CYCLES 10000
 
 static void write_byte(void *userdata, uint16_t address, uint8_t value)
 {
-    State8080 *const cpu = (State8080 *)userdata;
-    cpu->memory[address] = value;
+    cpm_bus_write(userdata, address, value);
 }
 
 static uint8_t port_in(void *userdata, uint8_t port)
 {
-    return 0x00;
+    return cpm_bus_in(userdata, port);
 }
 
 static void port_out(void *userdata, uint8_t port, uint8_t value)
 {
-    State8080 *const cpu = (State8080 *)userdata;
-
-    if (port == 0)
-    {
-        test_finished = 1;
-    }
-    else if (port == 1)
-    {
-        uint8_t operation = cpu->c;
+    cpm_bus_out(userdata, port, value);
+}
 
-        if (operation == 2)
-        { // print a character stored in E
-            printf("%c", cpu->e);
-        }
-        else if (operation == 9)
-        { // print from memory at (DE) until '$' char
-            uint16_t addr = (cpu->d << 8) | cpu->e;
-            do
-            {
-                printf("%c", cpu->memory[addr++]);
-            } while (cpu->memory[addr] != '$');
-        }
-    }
+// Counts its calls and ends the slice on every thousandth one, the way a
+// breakpoint would. The instruction runs on the call after.
+static bool counting_probe(State8080 *cpu, void *data)
+{
+    (void)cpu;
+    uint64_t *calls = (uint64_t *)data;
+    return ++*calls % 1000 != 0;
 }
 
 static inline int load_file(const char *filename, State8080 *cpu, uint16_t addr)
@@ -78,10 +66,22 @@ static inline int load_file(const char *filename, State8080 *cpu, uint16_t addr)
     return 0;
 }
 
-static inline void run_test(const char *filename)
+// Frees a CPU from load_test, with its bus.
+static void free_test(State8080 *cpu)
+{
+    free(cpu->user_data);
+    free_8080(cpu);
+}
+
+// A CPU with `filename` loaded at 0x100 and the CP/M stand-in around it,
+// NULL if the file can't be loaded.
+static State8080 *load_test(const char *filename)
 {
     State8080 *cpu = init_8080();
-    cpu->user_data = cpu;
+    CpmBus *bus = malloc(sizeof(CpmBus));
+    bus->cpu = cpu;
+    bus->finished = false;
+    cpu->user_data = bus;
     cpu->write_byte = write_byte;
     cpu->port_input = port_in;
     cpu->port_output = port_out;
@@ -89,35 +89,152 @@ static inline void run_test(const char *filename)
 
     if (load_file(filename, cpu, 0x100) != 0)
     {
-        return;
+        free_test(cpu);
+        return NULL;
     }
-    printf("\n");
-    printf("*** TEST: %s\n", filename);
-
     cpu->pc = 0x100;
 
-    // inject "out 0,a" at 0x0000 (signal to stop the test)
+    // inject "out 0,a" at 0x0000 (signal to stop the test), followed by
+    // "jmp 0x0000" so the rest of a slice spins there harmlessly
     cpu->memory[0x0000] = 0xD3;
     cpu->memory[0x0001] = 0x00;
+    cpu->memory[0x0002] = 0xC3;
+    cpu->memory[0x0003] = 0x00;
+    cpu->memory[0x0004] = 0x00;
 
     // inject "out 1,a" at 0x0005 (signal to output some characters)
     cpu->memory[0x0005] = 0xD3;
     cpu->memory[0x0006] = 0x01;
     cpu->memory[0x0007] = 0xC9;
+    analyze_8080_flags(cpu, 0, MEMORY_SIZE);
+    return cpu;
+}
+
+// Returns false, running nothing, when the recompiler isn't available.
+static inline bool run_test(const char *filename, bool use_jit, bool probed)
+{
+    State8080 *cpu = load_test(filename);
+    if (cpu == NULL)
+    {
+        return true;
+    }
+    Jit8080 *jit = use_jit ? init_jit_8080(cpu) : NULL;
+    if (use_jit && jit == NULL)
+    {
+        free_test(cpu);
+        return false;
+    }
+    printf("\n");
+    printf("*** TEST%s: %s\n", use_jit ? " (jit)" : probed ? " (instrumented)" : "", filename);
+
+    uint64_t probe_calls = 0;
+    if (probed)
+    {
+        cpu->probe = counting_probe;
+        cpu->probe_data = &probe_calls;
+    }
+
+    const CpmBus *bus = cpu->user_data;
+    while (!bus->finished)
+    {
+        if (jit != NULL)
+        {
+            jit_8080_run(jit, TEST_SLICE_CYCLES);
+        }
+        else
+        {
+            emulate_8080_run(cpu, TEST_SLICE_CYCLES);
+        }
+    }
+    if (jit != NULL)
+    {
+        free_jit_8080(jit);
+    }
+    if (probed)
+    {
+        printf("\n%llu probe calls\n", (unsigned long long)probe_calls);
+    }
+    free_test(cpu);
+    return true;
+}
+
+// Runs two of each ROM side by side on the lane engine: the copies run
+// across lanes, the ROMs between them part and meet the way diverging
+// machines do. Their output interleaves.
+static void run_lanes_test(const char *const *filenames, int count)
+{
+    State8080 *cpus[LANES_8080];
+    int lanes_used = 0;
+    printf("\n*** TEST (lanes):");
+    for (int i = 0; i < count; i++)
+    {
+        printf(" %s", filenames[i]);
+        for (int copy = 0; copy < 2; copy++)
+        {
+            State8080 *cpu = load_test(filenames[i]);
+            if (cpu == NULL)
+            {
+                return;
+            }
+            cpus[lanes_used++] = cpu;
+        }
+    }
+    printf(", two of each\n");
 
-    test_finished = 0;
-    while (!test_finished)
+    Lanes8080 *lanes = init_lanes_8080(cpus, lanes_used);
+    bool finished = false;
+    while (!finished)
+    {
+        lanes_8080_run(lanes, TEST_SLICE_CYCLES);
+        finished = true;
+        for (int i = 0; i < lanes_used; i++)
+        {
+            finished = finished && ((const CpmBus *)cpus[i]->user_data)->finished;
+        }
+    }
+    const Lanes8080Stats *stats = lanes_8080_stats(lanes);
+    printf("\n%llu instructions across lanes, %llu on their own\n",
+           (unsigned long long)stats->vector_instructions,
+           (unsigned long long)stats->scalar_instructions);
+    free_lanes_8080(lanes);
+    for (int i = 0; i < lanes_used; i++)
     {
-        emulate_8080_op(cpu);
+        free_test(cpus[i]);
     }
 }
 
-int main(int argc, char **argv)
+int main(void)
 {
-    run_test("./test/test_files/TST8080.COM");
-    run_test("./test/test_files/CPUTEST.COM");
-    run_test("./test/test_files/8080PRE.COM");
-    run_test("./test/test_files/8080EXM.COM");
+    static const char *const roms[] = {
+        "./test/test_files/TST8080.COM",
+        "./test/test_files/CPUTEST.COM",
+        "./test/test_files/8080PRE.COM",
+        "./test/test_files/8080EXM.COM",
+    };
+
+    for (size_t i = 0; i < sizeof(roms) / sizeof(roms[0]); i++)
+    {
+        run_test(roms[i], false, false);
+    }
+
+    // The instrumented core, on all but the long exerciser.
+    for (size_t i = 0; i < sizeof(roms) / sizeof(roms[0]) - 1; i++)
+    {
+        run_test(roms[i], false, true);
+    }
+
+    // The lane engine, on the two short ROMs.
+    const char *const lanes_roms[] = {roms[0], roms[2]};
+    run_lanes_test(lanes_roms, sizeof(lanes_roms) / sizeof(lanes_roms[0]));
+
+    // The same ROMs through the recompiler, where the host supports it.
+    for (size_t i = 0; i < sizeof(roms) / sizeof(roms[0]); i++)
+    {
+        if (!run_test(roms[i], true, false))
+        {
+            break;
+        }
+    }
 
     return 0;
 }